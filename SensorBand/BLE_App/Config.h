@@ -20,6 +20,9 @@ typedef struct Settings_tag {
 	uint32_t cyclesBattery;	// Battery charge/discharge cycles
 	uint32_t cyclesReset;	// Power-on or controlled reset counter
 	uint32_t cyclesErase;	// Number of completed erase operations
+	// FW2.0
+	uint16_t syncBlock;		// Acknowledged sync cursor, block number
+	uint16_t syncOffset;	// Acknowledged sync cursor, epochs in block already collected
 } Settings_t;
 
 // Current device status
@@ -37,6 +40,17 @@ typedef struct Status_tag {
 	// FW1.6
 	uint16_t accelRate;
 	uint8_t accelRange;
+	// FW2.0
+	uint16_t burstIndex;	// Burst read next block index
+	uint16_t burstCount;	// Burst read blocks remaining
+	uint16_t burstCredits;	// Burst read blocks the client will accept
+	uint16_t syncReadBlock;	// New epoch read, next block number
+	uint16_t syncReadOffset;// New epoch read, next epoch in block
+	uint8_t syncReadActive;	// New epoch read in progress
+	uint8_t transferEncoding;// Block read frame encoding
+	uint8_t streamFormat;	// Raw stream packet format
+	uint32_t burstStartTicks;// Burst read start, rtc counter
+	uint32_t burstStartEvents;// Burst read start, link radio events
 } Status_t;
 
 typedef enum {
@@ -102,7 +116,29 @@ extern uint32_t m_dfu_timeout;
 //		1.8 goal function disabled by default
 //		1.9 Adding rate/range changes
 //		1.10 Adding alternate serial command and name extension
-#define DIS_FIRMWARE_REVISION		"1.10" 
+//		2.0 Adding binary framed block read, burst read, sync cursor and packed transfer encoding
+//			 Block CRC-16/CCITT replaces checksum (block format flag 0x8000)
+//			 Binary framed raw stream "IB", delta packed "IP"
+//			 Automatic connection interval policy
+//			 Command replies are sent ahead of bulk data
+//			 Link statistics "K"
+//			 Burst end frame reports the elapsed rtc ticks and radio events
+//			 Append only epoch store, pages erased ahead of the write position
+//			 Epochs written to NVM as they are added, open blocks completed at start up
+//			 Newest block found by binary search at start up
+//			 Packed epoch block format v3, blocks close when full, each epoch padded to a flash word so a reset loses none
+//			 Protocol change: "R" hex and "RB" raw reads return blocks as stored, clients of 1.10 and earlier cannot
+//			 decode v3 blocks (block format 2) - clients check the block format and decode v3 records with EpochCodec
+//			 Time indexed block read position "RT"
+//			 Block summary in the meta data, summary read "RS"
+//			 Daily rollup ring in its own NVM pages, daily read "RD"
+//			 Stored epochs compacted to 15 minute bins in the background, compact block read "RC"
+//			 NVM layout change: epoch data 50KB, erase journal, compact and daily pages in the old 64KB epoch region
+//			 The first start after an update from 1.x finds the old fixed sample blocks and erases the data (download first)
+//			 Erase "E" is logical and immediate, the logger keeps running and pages are erased as it reaches them (compact and daily stores use marker blocks)
+//			 Settings saved as a journal of changed words, a full page is re-written to a second settings page (A/B copies)
+//			 Active epoch block and epoch in progress kept in no-init RAM, a warm reset carries on without a gap
+#define DIS_FIRMWARE_REVISION		"2.0" 
 
 #define DIS_SOFTWARE_REVISION		"\0"
 #define DIS_SERIAL_NUMBER			settings.serialNumber	// Device address as 12 ascii hex chars
@@ -115,6 +151,14 @@ extern uint32_t m_dfu_timeout;
 #define BLE_CONN_INT_RANGE_PERCENT	25	// +/- 25% used for connection interval range
 #define BLE_CONN_INTERVAL_DISCONN	0xFFFF
 
+// Automatic connection interval policy, fast while data is waiting and low power when idle
+#define CONN_POLICY_ENABLE					// Comment out to only change the interval by command
+#define CONN_POLICY_BUSY_LEVEL		80		// Bytes waiting to be sent for the link to be busy
+#define CONN_POLICY_IDLE_TIME		30		// Seconds not busy before the low power interval
+#define CONN_POLICY_HOLDOFF			5		// Minimum seconds between requests
+#define CONN_POLICY_CONNECT_HOLDOFF	15		// Seconds after connection, allows initial negotiation
+#define CONN_POLICY_MANUAL_HOLDOFF	60		// Seconds after an interval command before automatic changes
+
 #define BATTERY_LOW_THRESHOLD		5	// Percentage. Stop logger after battery is depleted @ 5%
 #define BATTERY_LOW_THRESHOLD_START	10	// Percentage. Restart logger after battery is recharged @ 10%
 #define LOW_BATT_THRESHOLD_COUNT	5	// Battery must be low for 5 seconds before app state change
@@ -142,6 +186,24 @@ extern uint32_t m_dfu_timeout;
 // Serial in/out service settings
 #define BLE_SERIAL_IN_QUEUE_LEN		64
 #define BLE_SERIAL_OUT_QUEUE_LEN	1200
+#define BLE_SERIAL_OUT_REGIONS		4		// Regions sent from memory without copying into the out queue
+#define BLE_SERIAL_CONTROL_QUEUE_LEN	128		// Command replies, sent before bulk data at frame/line boundaries
+#define BLE_SERIAL_OUT_BOUNDARIES	8		// Bulk data frame/line start positions where replies may be sent
+
+// Burst read, blocks sent before the client must grant more credits
+#define BURST_CREDITS_DEFAULT		2
+
+// Block summary read, most block headers in one frame
+#define BLOCK_SUMMARY_FRAME_MAX		16
+
+// Block read frame encodings
+#define TRANSFER_ENCODING_RAW		0	// Raw block frames
+#define TRANSFER_ENCODING_PACKED	1	// Packed block frames, delta encoded samples
+
+// Raw accelerometer stream packet formats
+#define STREAM_FORMAT_HEX			0	// Ascii hex text lines
+#define STREAM_FORMAT_BINARY		1	// Binary frames with sequence numbers
+#define STREAM_FORMAT_PACKED		2	// Binary frames with delta packed samples
 
 // Hardware task rate Hz
 #define HARDWARE_TASK_RATE			8
@@ -156,7 +218,13 @@ extern void ClrWdt(void);
 
 // Epoch logging settings
 #define EPOCH_LENGTH_DEFAULT		(60ul * 1)		// 1 minute epoch interval
-#define EPOCH_NVM_SIZE_TOTAL		(64ul * 1024)	// Size of program flash used for data 
+#ifndef EPOCH_NVM_SIZE_TOTAL
+#define EPOCH_NVM_SIZE_TOTAL		(50ul * 1024)	// Size of program flash used for data, ~7 days of padded minute epochs
+#endif
+#define EPOCH_ERASE_NVM_SIZE		(1ul * 1024)	// Size of program flash used for the erase boundary journal
+#define EPOCH_COMPACT_NVM_SIZE		(12ul * 1024)	// Size of program flash used for compacted older epochs, ~9 days (outlasts the epoch data)
+#define EPOCH_COMPACT_PERIOD		(15ul * 60)		// Compacted epoch bin length
+#define DAILY_NVM_SIZE_TOTAL		(2ul * 1024)	// Size of program flash used for daily totals
 
 // Accelerometer
 // Default device settings
@@ -167,6 +235,7 @@ extern void ClrWdt(void);
 
 // Epoch and pedometer energy calculation settings
 #define EE_LPF_SHIFT			6										/* Average 2^6 or 64 samples for DC subtraction */
+//#define EE_SQRT_BITWISE												/* Original bit by bit square root for the SVM, the table method gives the same results */
 #define PED_ONE_G_VALUE			4096lu									/*Required to scale pedometer calculations - 8g value */
 #define PED_MIN_ACTIVITY_LEVEL	((int)(0.25F * PED_ONE_G_VALUE))		/*Min amplitude of peak to peak activity 0.25g */
 #define PED_MIN_STEP_INTERVAL	((int)(0.3F * ACCEL_DEFAULT_RATE))		/*In samples, 300ms */
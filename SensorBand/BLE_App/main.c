@@ -21,6 +21,7 @@
  * This application uses the @ref srvlib_conn_params module.
  */
 
+#include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 #include "nordic_common.h"
@@ -51,6 +52,11 @@
 #include "ble_serial.h"
 #include "acc_tasks.h"
 #include "AsciiHex.h"
+#include "EpochCodec.h"
+#include "DailyRollup.h"
+#include "EpochCompact.h"
+#include "Crc16.h"
+#include "SerialRead.h"
 #include "HardwareProfile.h"
 
 // Flash variable address checking variable parameter
@@ -61,9 +67,12 @@ const uint32_t __attribute__((section(".nvm_settings_data"), aligned(0x400)))sta
 void ble_stack_off(void);
 void conn_params_error_handler(uint32_t nrf_error);
 void conn_param_update_interval(uint16_t newIntervalMillisec);
+uint32_t conn_param_request_interval(uint16_t newIntervalMillisec);
+void conn_param_policy_tasks(void);
 void on_conn_params_evt(ble_conn_params_evt_t * p_evt);
 uint32_t device_manager_evt_handler(dm_handle_t const *p_handle, dm_event_t const *p_event, ret_code_t event_result);
 void DebugSerialDump(uint8_t* buffer, uint16_t bufferLen, uint8_t* source, uint16_t length);
+void SerialSyncTasks(void);
 
 // Global constants and settings
 // The User Information and Control Registers (UICR)
@@ -143,6 +152,8 @@ static ble_bas_t m_bas;
 static uint16_t m_conn_handle = BLE_CONN_HANDLE_INVALID;
 // The connection interval of the client connection
 uint16_t m_conn_interval = BLE_CONN_INTERVAL_DISCONN;
+// Automatic connection interval policy, idle time and seconds until the next request is allowed
+uint16_t conn_policy_idle = 0, conn_policy_holdoff = 0;
 // Instance of the device manager for connection bonding
 static dm_application_instance_t m_app_handle;	
 // RTC time epoch - persistent section
@@ -155,11 +166,30 @@ pstorage_handle_t	settings_pstorage_handle;
 Settings_t			settings = {0};
 Status_t			status = {0};
 
+// Settings pages, a base copy of the settings then a journal of the words changed by each save. Records are appended
+// to the erased flash. When the page is full a new base is written to the other page, which is erased first, and
+// the new page is used once its header is written. The page with the newer sequence number is read at start up
+#define SETTINGS_WORDS				(sizeof(Settings_t) / sizeof(uint32_t))			// Settings size in flash words
+#define SETTINGS_PAGE_WORDS			(PSTORAGE_FLASH_PAGE_SIZE / sizeof(uint32_t))	// Settings page size in flash words
+#define SETTINGS_PAGES				2												// Pages used in turn for the base copy
+#define SETTINGS_JOURNAL_START		(2 + SETTINGS_WORDS)							// First record, after the base header, sequence and copy
+#define SETTINGS_JOURNAL_MAGIC		0x4A53											// Base header low half, the check of the sequence and copy is the high half
+static uint32_t		settingsStored[SETTINGS_WORDS];				// Settings as they are in the NVM
+static uint16_t		settingsJournalEnd = SETTINGS_PAGE_WORDS;	// Next record position, full until the page is read
+static uint8_t		settingsPage;								// Page of the newest base copy and its journal
+static uint32_t		settingsSequence;							// Sequence number of the newest base copy
+static uint32_t		settingsStage[2][2 + SETTINGS_WORDS];		// Records being written, the source must not change until written
+static volatile bool settingsStageBusy[2];						// Stage queued, free once its last write completes
+static uint8_t		settingsStageNext;
+static bool			settingsSaveDeferred;						// A save waited for a free stage, tried again from the main loop
+
 // Prototypes for settings function routines
 bool SettingsInitialise(void);
 bool SettingsPstorageSave(void);
 bool SettingsDefaults(void);
 void SettingsPstorageHandler(pstorage_handle_t * p_handle, uint8_t op_code, uint32_t result, uint8_t* p_data, uint32_t data_len);
+uint16_t SettingsJournalCheck(uint32_t header, const uint32_t* data);
+bool SettingsJournalRead(void);
 
 // FL:1.9
 void StopStreamingAndRestartLogger(void);
@@ -190,7 +220,7 @@ bool SettingsInitialise(void)
 
 	// Initialise the pstorage module
 	param.block_size  = PSTORAGE_FLASH_PAGE_SIZE;
-	param.block_count = 1;
+	param.block_count = SETTINGS_PAGES;
 	param.cb		  = SettingsPstorageHandler;
 	// Register with the pstorage module
 	err_code = pstorage_register(&param, &settings_pstorage_handle);	
@@ -202,13 +232,22 @@ bool SettingsInitialise(void)
 		return false;
 	}	
 
-	// Set module ID (may not be needed) to read saved settings
-	block_handle.module_id = settings_pstorage_handle.module_id;
-	// Request to read from indexed block (at offset of zero)
-	pstorage_block_identifier_get(&settings_pstorage_handle, 0, &block_handle);	
-	// Ensure data was read into destination pointer variable and check if address is valid
-	if(pstorage_load((uint8_t*)&settings, &block_handle, sizeof(Settings_t), 0) != NRF_SUCCESS)
-		app_error_fault_handler(0xDEADBEEF + __LINE__, 0, (uint32_t)NULL);
+	// Newest base copy and journal, otherwise a plain copy (earlier firmware) re-written as a journal on the next save
+	if(!SettingsJournalRead())
+	{
+		// Set module ID (may not be needed) to read saved settings
+		block_handle.module_id = settings_pstorage_handle.module_id;
+		// The plain copy is in the last page, the settings page of earlier firmware
+		pstorage_block_identifier_get(&settings_pstorage_handle, SETTINGS_PAGES - 1, &block_handle);	
+		// Ensure data was read into destination pointer variable and check if address is valid
+		if(pstorage_load((uint8_t*)&settings, &block_handle, sizeof(Settings_t), 0) != NRF_SUCCESS)
+			app_error_fault_handler(0xDEADBEEF + __LINE__, 0, (uint32_t)NULL);
+		memcpy(settingsStored, &settings, sizeof(Settings_t));
+		// The next save writes a base to the first page, the plain copy is kept until it is complete
+		settingsJournalEnd = SETTINGS_PAGE_WORDS;
+		settingsPage = SETTINGS_PAGES - 1;
+		settingsSequence = 0;
+	}
 	// Should only occur on newly programmed device
 	if(memcmp((void*)NRF_FICR->DEVICEADDR, settings.address, 6) != 0)
 	{
@@ -228,19 +267,119 @@ bool SettingsInitialise(void)
 
 bool SettingsPstorageSave(void)
 {
-	uint32_t err_code;
+	const uint32_t* words = (const uint32_t*)&settings;
 	pstorage_handle_t block_handle;
+	uint32_t* stage;
+	uint16_t first, last, count;
+	uint8_t page;
+	settingsSaveDeferred = false;
+	// Words changed since the last save, nothing is written if there are none
+	for(first = 0; (first < SETTINGS_WORDS) && (words[first] == settingsStored[first]); first++);
+	if(first >= SETTINGS_WORDS)
+		return true;
+	for(last = SETTINGS_WORDS - 1; words[last] == settingsStored[last]; last--);
+	count = last - first + 1;
+	// Written from a copy, alternate copies in case settings are saved again while one is queued. A copy still
+	// queued is not reused, the changed words are saved from the main loop once it is written
+	if(settingsStageBusy[settingsStageNext])
+	{
+		settingsSaveDeferred = true;
+		return true;
+	}
+	stage = settingsStage[settingsStageNext];
+	settingsStageBusy[settingsStageNext] = true;
+	settingsStageNext ^= 1;
 	// Set module ID (may not be needed)
 	block_handle.module_id = settings_pstorage_handle.module_id;
-	// Request to read from indexed block (at offset of zero)
-	pstorage_block_identifier_get(&settings_pstorage_handle, 0, &block_handle);	
-	// Save settings
-	err_code = pstorage_update(&block_handle, (uint8_t*)&settings, sizeof(Settings_t), 0);	
-	if(err_code != NRF_SUCCESS)
+	// Request to read from the page in use (at offset of zero)
+	pstorage_block_identifier_get(&settings_pstorage_handle, settingsPage, &block_handle);	
+	// Append a record of the changed words: first word, count and check, then the words
+	if((settingsJournalEnd + 1 + count) <= SETTINGS_PAGE_WORDS)
 	{
-		app_error_fault_handler(0xDEADBEEF + __LINE__, 0, (uint32_t)NULL);
-		return false;		
-	}	
+		memcpy(&stage[1], &words[first], count * sizeof(uint32_t));
+		stage[0] = first | ((uint32_t)count << 8);
+		stage[0] |= (uint32_t)SettingsJournalCheck(stage[0], &stage[1]) << 16;
+		if(pstorage_store(&block_handle, (uint8_t*)stage, (1 + count) * sizeof(uint32_t), settingsJournalEnd * sizeof(uint32_t)) != NRF_SUCCESS)
+		{
+			app_error_fault_handler(0xDEADBEEF + __LINE__, 0, (uint32_t)NULL);
+			return false;		
+		}	
+		settingsJournalEnd += 1 + count;
+	}
+	else
+	{
+		// Full, erase the other page and write a new base. The header is written last, a reset before it keeps the old page
+		page = (settingsPage + 1) % SETTINGS_PAGES;
+		pstorage_block_identifier_get(&settings_pstorage_handle, page, &block_handle);	
+		stage[1] = settingsSequence + 1;
+		memcpy(&stage[2], words, sizeof(Settings_t));
+		stage[0] = SETTINGS_JOURNAL_MAGIC | ((uint32_t)Crc16Ccitt(&stage[1], sizeof(uint32_t) + sizeof(Settings_t), CRC16_CCITT_INIT) << 16);
+		if(	(pstorage_clear(&block_handle, PSTORAGE_FLASH_PAGE_SIZE) != NRF_SUCCESS) ||
+			(pstorage_store(&block_handle, (uint8_t*)&stage[1], sizeof(uint32_t) + sizeof(Settings_t), sizeof(uint32_t)) != NRF_SUCCESS) ||
+			(pstorage_store(&block_handle, (uint8_t*)&stage[0], sizeof(uint32_t), 0) != NRF_SUCCESS) )
+		{
+			app_error_fault_handler(0xDEADBEEF + __LINE__, 0, (uint32_t)NULL);
+			return false;		
+		}	
+		// Records follow in the new page, queued after its header
+		settingsPage = page;
+		settingsSequence++;
+		settingsJournalEnd = SETTINGS_JOURNAL_START;
+	}
+	memcpy(settingsStored, words, sizeof(Settings_t));
+	return true;
+}
+
+// Check of a journal record, the first word and count of the header then the words
+uint16_t SettingsJournalCheck(uint32_t header, const uint32_t* data)
+{
+	uint16_t check;
+	check = Crc16Ccitt(&header, sizeof(uint16_t), CRC16_CCITT_INIT);
+	return Crc16Ccitt(data, ((header >> 8) & 0xFF) * sizeof(uint32_t), check);
+}
+
+// Load the newest base copy and replay its journal records, false if neither page is a journal
+bool SettingsJournalRead(void)
+{
+	pstorage_handle_t block_handle;
+	const uint32_t *page = NULL, *candidate;
+	uint16_t end, first, count;
+	uint8_t index;
+	// Base header, sequence and copy, the newer of the valid pages
+	block_handle.module_id = settings_pstorage_handle.module_id;
+	for(index = 0; index < SETTINGS_PAGES; index++)
+	{
+		if(pstorage_block_identifier_get(&settings_pstorage_handle, index, &block_handle) != NRF_SUCCESS)
+			continue;
+		candidate = (const uint32_t*)block_handle.block_id;
+		if(	((candidate[0] & 0xFFFF) != SETTINGS_JOURNAL_MAGIC) ||
+			((candidate[0] >> 16) != Crc16Ccitt(&candidate[1], sizeof(uint32_t) + sizeof(Settings_t), CRC16_CCITT_INIT)) )
+			continue;
+		if((page == NULL) || ((int32_t)(candidate[1] - settingsSequence) > 0))
+		{
+			page = candidate;
+			settingsPage = index;
+			settingsSequence = candidate[1];
+		}
+	}
+	if(page == NULL)
+		return false;
+	memcpy(&settings, &page[2], sizeof(Settings_t));
+	// Records up to the erased flash. One cut short by a reset ends the journal, the page is re-written on the next save
+	for(end = SETTINGS_JOURNAL_START; (end < SETTINGS_PAGE_WORDS) && (page[end] != 0xFFFFFFFF); end += 1 + count)
+	{
+		first = page[end] & 0xFF;
+		count = (page[end] >> 8) & 0xFF;
+		if(	(count == 0) || ((first + count) > SETTINGS_WORDS) || ((end + 1 + count) > SETTINGS_PAGE_WORDS) ||
+			((page[end] >> 16) != SettingsJournalCheck(page[end], &page[end + 1])) )
+		{
+			end = SETTINGS_PAGE_WORDS;
+			break;
+		}
+		memcpy(((uint32_t*)&settings) + first, &page[end + 1], count * sizeof(uint32_t));
+	}
+	settingsJournalEnd = end;
+	memcpy(settingsStored, &settings, sizeof(Settings_t));
 	return true;
 }
 
@@ -277,6 +416,9 @@ bool SettingsDefaults(void)
 	settings.cyclesBattery	= 0;							// Zero battery charge/discharge cycles
 	settings.cyclesReset	= 0;							// Zero power-on or controlled reset counter
 	settings.cyclesErase	= 0;							// Reset number of completed erase operations
+	// Nothing collected yet
+	settings.syncBlock		= EPOCH_BLOCK_INDEX_INVALID;	// Sync cursor block, invalid is the oldest block
+	settings.syncOffset		= 0;							// Sync cursor epoch offset in block
 	// Default to authenticated on reset to defaults
 	status.authenticated = true;
 	// Write back to NVM as well - callback triggered
@@ -288,14 +430,19 @@ void SettingsPstorageHandler(pstorage_handle_t * p_handle, uint8_t op_code, uint
 	switch(op_code)
 	{
 		case PSTORAGE_UPDATE_OP_CODE:
-			// After update (NVM write), check result
+		case PSTORAGE_STORE_OP_CODE:
+		case PSTORAGE_CLEAR_OP_CODE:
+			// After a journal record or page erase (NVM write), check result
 			if(result != NRF_SUCCESS)
 			{
 				app_error_fault_handler(0xDEADBEEF + __LINE__, 0, (uint32_t)NULL);
 			}			
+			// The last write from a stage is from its start (a record, or the header of a base), the stage is free
+			if(p_data == (uint8_t*)settingsStage[0])
+				settingsStageBusy[0] = false;
+			else if(p_data == (uint8_t*)settingsStage[1])
+				settingsStageBusy[1] = false;
 			break;
-		case PSTORAGE_CLEAR_OP_CODE:
-		case PSTORAGE_STORE_OP_CODE:
 		case PSTORAGE_LOAD_OP_CODE:			
 		default:
 			// Unhandled and un-needed events
@@ -371,19 +518,60 @@ static void gap_params_init(void)
 void conn_param_update_interval(uint16_t newIntervalMillisec)
 {
 	uint32_t retVal;
+	// Manual changes pause the automatic policy
+	conn_policy_holdoff = CONN_POLICY_MANUAL_HOLDOFF;
+	retVal = conn_param_request_interval(newIntervalMillisec);	
+	if(retVal != NRF_SUCCESS)
+	{
+		// No update scheduled - error
+		app_error_fault_handler(0xDEADBEEF + __LINE__, 0, (uint32_t)NULL);
+	}
+	return;
+}
+// Request the connection interval from the client - returns the request result
+uint32_t conn_param_request_interval(uint16_t newIntervalMillisec)
+{
 	ble_gap_conn_params_t ble_gap_conn_params_new;
 	memcpy(&ble_gap_conn_params_new, &ble_gap_conn_params_default, sizeof(ble_gap_conn_params_t));
 
 	ble_gap_conn_params_new.min_conn_interval	= ((((uint32_t)newIntervalMillisec) * (1000ul - (10* BLE_CONN_INT_RANGE_PERCENT ))) / (UNIT_1_25_MS));
 	ble_gap_conn_params_new.max_conn_interval	= ((((uint32_t)newIntervalMillisec) * (1000ul + (10* BLE_CONN_INT_RANGE_PERCENT ))) / (UNIT_1_25_MS));
 	
-	retVal = ble_conn_params_change_conn_params(&ble_gap_conn_params_new);	
-	if(retVal != NRF_SUCCESS)
+	return ble_conn_params_change_conn_params(&ble_gap_conn_params_new);	
+}
+// Automatic connection interval, call once per second - fast while data is waiting, low power after a period idle
+void conn_param_policy_tasks(void)
+{
+	uint32_t interval;
+	bool busy;
+	// Only while connected
+	if(m_conn_handle == BLE_CONN_HANDLE_INVALID)
+		return;
+	// Busy while streaming, reading or with data waiting to be sent. A burst waiting for credits is idle, the client may not ask for more
+	busy =	(status.streamMode != 0) || ((status.burstCount > 0) && (status.burstCredits > 0)) || (status.syncReadActive) ||
+			(ble_serial_out_pending() >= CONN_POLICY_BUSY_LEVEL);
+	// Idle time must build up before slowing down, any busy second resets it
+	if(busy)
+		conn_policy_idle = 0;
+	else if(conn_policy_idle < 0xFFFF)
+		conn_policy_idle++;
+	// Rate limit the requests
+	if(conn_policy_holdoff > 0)
 	{
-		// No update scheduled - error
-		app_error_fault_handler(0xDEADBEEF + __LINE__, 0, (uint32_t)NULL);
+		conn_policy_holdoff--;
+		return;
 	}
-	return;
+	// Current interval in ms, the upper limit of the range requested
+	interval = ((uint32_t)m_conn_interval * UNIT_1_25_MS) / 1000;
+	// Request the fast interval when busy unless already fast, the slow interval when idle unless already slow
+	if(busy && (interval > (BLE_CON_INT_HIGH_SPEED + (BLE_CON_INT_HIGH_SPEED / 4))))
+		conn_param_request_interval(BLE_CON_INT_HIGH_SPEED);
+	else if(!busy && (conn_policy_idle >= CONN_POLICY_IDLE_TIME) && (interval < (BLE_CON_INT_LOW_POWER - (BLE_CON_INT_LOW_POWER / 4))))
+		conn_param_request_interval(BLE_CON_INT_LOW_POWER);
+	else
+		return;
+	// Failed requests are also retried after the hold off
+	conn_policy_holdoff = CONN_POLICY_HOLDOFF;
 }
 // Data handler for remote->local data flow and reply
 void serial_tasks(void)
@@ -534,6 +722,9 @@ void serial_tasks(void)
 				memcpy(settings.securityKey, settings.masterKey, 6);
 				// Increment erase count
 				settings.cyclesErase++;
+				// Erased data can not be collected, reset the sync cursor
+				settings.syncBlock = EPOCH_BLOCK_INDEX_INVALID;
+				settings.syncOffset = 0;
 
 				// If the command was for factory reset
 				if(buffer[1] == '!')
@@ -553,21 +744,13 @@ void serial_tasks(void)
 					reply = "Erase data\r\n";
 				}
 
-				// If logging state - restart logger
-				if(status.appState == APP_STATE_LOGGING)
-				{
-					if(!AccelEpochLoggerStop())
-						app_error_fault_handler(0xDEADBEEF + __LINE__, 0, (uint32_t)NULL);
-				}
-				// Set reply chars based on results of erase and settings save
+				// Erase is logical, the logger keeps running and pages are erased as it reaches them
 				if(!AccelEpochBlockClearAll()) 
 					app_error_fault_handler(0xDEADBEEF + __LINE__, 0, (uint32_t)NULL);
-				// If logging state - restart logger
-				if(status.appState == APP_STATE_LOGGING)
-				{
-					status.appState = APP_STATE_READY;		
-					status.appCounter = 5; // Re-start logger in a few seconds				
-				}
+				if(!EpochCompactClearAll()) 
+					app_error_fault_handler(0xDEADBEEF + __LINE__, 0, (uint32_t)NULL);
+				if(!DailyRollupClearAll()) 
+					app_error_fault_handler(0xDEADBEEF + __LINE__, 0, (uint32_t)NULL);
 				// Erased device is now clear, default password set, authenticated
 			}			
 			// Set reply length
@@ -704,6 +887,9 @@ void serial_tasks(void)
 				if(ReadHexToBinary((uint8_t*)&newTime, &buffer[1], (2 * sizeof(uint32_t))) > 0)
 				{
 					SysTimeSetEpoch(newTime);
+					// Flag the change in the open block summary
+					AccelEpochTimeChanged();
+					DailyRollupTimeChanged();
 					// Fix scheduled tasks like epoch and cueing
 					status.cueingCount = 0;
 					AccelCalcEpochWindow();
@@ -983,26 +1169,42 @@ void serial_tasks(void)
 			}
 
 #else
-// Logger query info string - 3x13=39 chars max x 2
-			length = sprintf(buffer, "T:%lu\r\nB:%lu\r\nN:%lu\r\n",
-				(unsigned long)rtcEpochTriplicate[0],
-				(unsigned long)activeEpochBlock.info.block_number,
-				(unsigned long)activeEpochBlock.info.data_length);
-			QueuePush(&serial_out_queue, buffer, length);
-
-			length = sprintf(buffer, "E:%lu\r\nC:%lu\r\nI:%lu",
-				(unsigned long)activeEpochBlock.info.time_stamp,	
-				(unsigned long)epockBlockCount,
-				(unsigned long)status.epochReadIndex);
-			QueuePush(&serial_out_queue, buffer, length);
-
-			// Terminate packet to send the queue contents
-			reply = "\r\n";
-			length = strlen(reply);
+// Logger query info string, one reply so it is all or nothing - 2x14 + 4x9 = 64 chars max, fits the buffer and control queue
+			length = SerialReadQuery(buffer);
+			reply = buffer;
 #endif
 			break; 
 		}	
 
+		// Link statistics, "K" sends a binary frame of the counters, "K!" also clears them
+		case 'K': 
+		case 'k':
+		{
+			BleSerialStats_t snapshot;
+			// If not authenticated, do not handle. Reply "!"
+			if(status.authenticated != true)
+			{
+				reply = "!\r\n";
+				length = strlen(reply);
+				break;
+			}
+			// Copy and clear together, the counters change in the transmit interrupt
+			CRITICAL_REGION_ENTER();
+			memcpy(&snapshot, &ble_serial_stats, sizeof(BleSerialStats_t));
+			if((result > 1) && (buffer[1] == '!'))
+				memset(&ble_serial_stats, 0, sizeof(BleSerialStats_t));
+			CRITICAL_REGION_EXIT();
+			// Send as a frame with the bulk data, reply if there is no space
+			if(ble_serial_frame_header(BLE_FRAME_TYPE_LINK_STATS, sizeof(BleSerialStats_t)) != 0)
+				ble_serial_out_push(&snapshot, sizeof(BleSerialStats_t));
+			else
+			{
+				reply = "K?\r\n";
+				length = strlen(reply);
+			}
+			break;
+		}
+
 		// Synchronise the eepoch logger timing with a +/- offset
 		case 'S': 
 		case 's':
@@ -1040,11 +1242,10 @@ void serial_tasks(void)
 			length = strlen(reply);
 			break;
 		}	
-		// Epoch block read command for indexed block	
+		// Epoch block read command for indexed block. "R" ascii hex, "RB" binary frame
 		case 'R': 
 		case 'r':
 		{
-			uint8_t *queueBuffer;
 			// If not authenticated, do not handle. Reply "!"
 			if(status.authenticated != true)
 			{
@@ -1052,48 +1253,118 @@ void serial_tasks(void)
 				length = strlen(reply);
 				break;
 			}
-			// Check the queue has enough room to accommodate the full block
-			if(QueueFree(&serial_out_queue) >= (2 + 2*EPOCH_NVM_BLOCK_SIZE))
+			// Sync cursor commit command, "RA<block><offset>", client has collected all epochs before the position
+			if((result > 1) && ((buffer[1] == 'A') || (buffer[1] == 'a')))
 			{
-				uint16_t index = 0;
-				// Fix block number if invalid or wrapped (set to start of NVM)
-				if(status.epochReadIndex >= EPOCH_NVM_BLOCK_COUNT) 
+				uint16_t position[2] = {status.syncReadBlock, status.syncReadOffset};
+				// Read the optional position (hex, little endian), default is the end of the last new epoch read
+				if(result >= 10) ReadHexToBinary((uint8_t*)position, &buffer[2], (2 * sizeof(position)));
+				// Only save if changed, limits NVM writes
+				if((position[0] != settings.syncBlock) || (position[1] != settings.syncOffset))
 				{
-					status.epochReadIndex = activeIndex;
-					if(status.epochReadIndex != 0) 
-						status.epochReadIndex--;
+					settings.syncBlock = position[0];
+					settings.syncOffset = position[1];
+					// Check save result - on application NVM save failure - better to reset
+					if(!SettingsPstorageSave())
+						app_error_fault_handler(0xDEADBEEF + __LINE__, 0, (uint32_t)NULL);
 				}
-				// Write out the encoded block in short sections to the queue
-				while(index < EPOCH_NVM_BLOCK_SIZE)
+				// Reply with the committed position
+				length = sprintf(buffer,"RA:%04X,%04X\r\n", settings.syncBlock, settings.syncOffset);
+				reply = buffer;
+				break;
+			}
+			// New epoch read command, "RN", all epochs after the sync cursor are sent as frames
+			if((result > 1) && ((buffer[1] == 'N') || (buffer[1] == 'n')))
+			{
+				// Start from the committed position, frames are added as the queue empties
+				status.syncReadBlock = settings.syncBlock;
+				status.syncReadOffset = settings.syncOffset;
+				status.syncReadActive = true;
+				SerialSyncTasks();
+				break;
+			}
+			// Time index command, "RT<time>", sets the read index to the block covering the time (hex, little endian)
+			// Following "R", "RB" or "RM" (no index) reads start at this block
+			if((result > 1) && ((buffer[1] == 'T') || (buffer[1] == 't')))
+			{
+				uint32_t time = 0;
+				uint16_t index = EPOCH_BLOCK_INDEX_INVALID, block_number = EPOCH_BLOCK_INDEX_INVALID;
+				if(ReadHexToBinary((uint8_t*)&time, &buffer[2], (2 * sizeof(uint32_t))) > 0)
+					index = AccelEpochBlockFindTime(time);
+				// Reply with the index and block number, unchanged if there is no block
+				if(index < EPOCH_NVM_BLOCK_COUNT)
 				{
-					// Early exit on read data fail
-					if( !AccelEpochBlockRead((buffer + WRITE_SEGMENT_SIZE), index, WRITE_SEGMENT_SIZE, status.epochReadIndex) )
-						break;
-					// Encode into ascii hex in place. Early out if encoded is not expected length
-					if( (WriteBinaryToHex(buffer, (buffer + WRITE_SEGMENT_SIZE), WRITE_SEGMENT_SIZE, false)) !=  (2 * WRITE_SEGMENT_SIZE) )
-						break;
-					// Add the segment to the queue. Early exit if push fails to write all output
-					if( (QueuePush(&serial_out_queue, buffer, (2 * WRITE_SEGMENT_SIZE))) != (2 * WRITE_SEGMENT_SIZE) )
-						break;
-					// Increment the write offset
-					index += WRITE_SEGMENT_SIZE;
+					status.epochReadIndex = index;
+					block_number = AccelEpochBlockNumber(index);
 				}
-				// Check whole block was added
-				if(index < EPOCH_NVM_BLOCK_SIZE)
+				length = sprintf(buffer,"RT:%04X,%04X\r\n", index, block_number);
+				reply = buffer;
+				break;
+			}
+			// Block summary command, "RS<index><count>", a frame of the block headers (info and summary meta data) only
+			if((result > 1) && ((buffer[1] == 'S') || (buffer[1] == 's')))
+			{
+				uint16_t index = status.epochReadIndex, count = 1;
+				// Read the optional start index and block count (hex, little endian)
+				if(result >= 6) ReadHexToBinary((uint8_t*)&index, &buffer[2], (2 * sizeof(uint16_t)));
+				if(result >= 10) ReadHexToBinary((uint8_t*)&count, &buffer[6], (2 * sizeof(uint16_t)));
+				if(index >= EPOCH_NVM_BLOCK_COUNT)
+					index = 0;
+				if(count > BLOCK_SUMMARY_FRAME_MAX)
+					count = BLOCK_SUMMARY_FRAME_MAX;
+				// Add the whole frame if there is room, otherwise reply
+				if((count == 0) || (ble_serial_frame_header(BLE_FRAME_TYPE_BLOCK_SUMMARY, count * (sizeof(uint16_t) + offsetof(Epoch_block_t, epoch_data))) == 0))
 				{
-					// Adding data to queue failed. Not fully sent - error in debug, user read too fast
-#ifdef __DEBUG
-					app_error_fault_handler(0xDEADBEEF + __LINE__, 0, (uint32_t)NULL);
-#endif
+					length = sprintf(buffer,"RS?\r\n");
+					reply = buffer;
+					break;
 				}
-				// Increment the block index pointer on successful read
-				if(++status.epochReadIndex >= epockBlockCount)
-					status.epochReadIndex = 0;
-
-				// Terminate packet to send the queue contents
-				reply = "\r\n";
-				length = strlen(reply);
+				for(; count > 0; count--)
+				{
+					ble_serial_out_push(&index, sizeof(uint16_t));
+					if(!AccelEpochBlockRead(buffer, 0, offsetof(Epoch_block_t, epoch_data), index))
+						memset(buffer, 0xFF, offsetof(Epoch_block_t, epoch_data));
+					ble_serial_out_push(buffer, offsetof(Epoch_block_t, epoch_data));
+					if(++index >= epockBlockCount)
+						index = 0;
+				}
+				// Following reads continue after these blocks
+				status.epochReadIndex = index;
+				break;
+			}
+			// Daily rollup command, "RD", a frame of the current day followed by the whole stored ring (index order)
+			if((result > 1) && ((buffer[1] == 'D') || (buffer[1] == 'd')))
+			{
+				DailyRecord_t current;
+				const DailyRecord_t* ring = DailyRollupRing();
+				DailyRollupCurrent(&current);
+				// Ring is sent from the NVM, records have a CRC in case a page is erased while sending
+				if((ring == NULL) || (ble_serial_frame_region(BLE_FRAME_TYPE_DAILY_ROLLUP, &current, sizeof(DailyRecord_t), (const uint8_t*)ring, DAILY_NVM_SIZE_TOTAL) == 0))
+				{
+					length = sprintf(buffer,"RD?\r\n");
+					reply = buffer;
+				}
+				break;
+			}
+			// Compact block read command, "RC<index>", the block is sent as a frame: header, block index, raw compact block
+			if((result > 1) && ((buffer[1] == 'C') || (buffer[1] == 'c')))
+			{
+				uint16_t index = 0;
+				const EpochCompactBlock_t* block;
+				if(result >= 6) ReadHexToBinary((uint8_t*)&index, &buffer[2], (2 * sizeof(uint16_t)));
+				block = EpochCompactBlockPointer(index);
+				// Sent from the NVM, an open block has an erased first word and the bins written so far
+				if((block == NULL) || (ble_serial_frame_region(BLE_FRAME_TYPE_COMPACT_BLOCK, &index, sizeof(uint16_t), (const uint8_t*)block, EPOCH_COMPACT_BLOCK_SIZE) == 0))
+				{
+					length = sprintf(buffer,"RC?\r\n");
+					reply = buffer;
+				}
+				break;
 			}
+			// Block reads "R", "RB", "RM", "RG" and the transfer encoding "RE"
+			length = SerialReadCommand(buffer, result);
+			if(length > 0)
+				reply = buffer;
 			break; 
 		}	
 		// Stream IMU data command
@@ -1113,12 +1384,25 @@ void serial_tasks(void)
 			// Set output mode - stream
 			if((buffer[0] == 'I') || (buffer[0] == 'i'))
 			{
+				uint8_t arg = 1;
 				status.streamMode = 1;
+				// Check for binary stream packet format, "IB", or delta packed "IP"
+				status.streamFormat = STREAM_FORMAT_HEX;
+				if((result > 1) && ((buffer[1] == 'B') || (buffer[1] == 'b')))
+				{
+					status.streamFormat = STREAM_FORMAT_BINARY;
+					arg++;
+				}
+				else if((result > 1) && ((buffer[1] == 'P') || (buffer[1] == 'p')))
+				{
+					status.streamFormat = STREAM_FORMAT_PACKED;
+					arg++;
+				}
 				// Now check for extra rate range settings
-				if((result > 1) && (buffer[1] == ' ' ))
+				if((result > arg) && (buffer[arg] == ' ' ))
 				{
 					uint32_t i;
-					char* ptr = &buffer[2];
+					char* ptr = &buffer[arg + 1];
 					// Terminate for possible full input packet
 					buffer[result] = '\0';
 					status.accelRate = atoi(ptr);
@@ -1290,7 +1574,7 @@ void serial_tasks(void)
 	// Send reply output
 	if(reply != NULL)
 	{
-		result = ble_serial_service_send(reply, length);
+		result = ble_serial_control_send(reply, length);
 		if(result != length)
 		{
 			// Not sent - error (ignore if in release - don't reset)
@@ -1307,6 +1591,8 @@ void DebugSerialDump(uint8_t* buffer, uint16_t bufferLen, uint8_t* source, uint1
 	if(QueueFree(&serial_out_queue) >= (2 + (2 * length)))
 	{
 		uint32_t offset = 0;
+		// The dump is one line of bulk data
+		ble_serial_out_boundary();
 		// Write out the encoded data in short sections to the queue
 		while(offset < length)
 		{
@@ -1318,17 +1604,97 @@ void DebugSerialDump(uint8_t* buffer, uint16_t bufferLen, uint8_t* source, uint1
 			// Encode into ascii hex in place. Early out if encoded is not expected length
 			written = WriteBinaryToHex(buffer, source + offset, toWrite, false);
 			// Add the segment to the queue. Early exit if push fails to write all output
-			if(QueuePush(&serial_out_queue, buffer, written) != written) break;
+			if(ble_serial_out_push(buffer, written) != written) break;
 			// Increment offset
 			offset += toWrite;
 
 		}
 		// Terminate packet to send the queue contents
-        QueuePush(&serial_out_queue, "\r\n", 2);
+        ble_serial_out_push("\r\n", 2);
 	}
 }
 
 
+// New epoch read tasks, called as the out queue empties to add frames of epochs after the read position
+void SerialSyncTasks(void)
+{
+	Epoch_sample_t samples[8];
+	struct {
+		uint16_t block_number;
+		uint16_t offset;
+		uint16_t count;
+		uint16_t period;
+		uint32_t time_stamp;
+	} info;
+	uint16_t index, written, toWrite;
+	// Nothing to send
+	if(!status.syncReadActive)
+		return;
+	// Add frames while there is room, one frame per block
+	for(;;)
+	{
+		EpochBlockInfo_t block_info;
+		// Find the stored block, or the oldest block after it if overwritten
+		index = AccelEpochBlockFind(status.syncReadBlock);
+		if( !AccelEpochBlockRead((uint8_t*)&block_info, 0, sizeof(EpochBlockInfo_t), index) ||
+			!AccelEpochBlockRead((uint8_t*)&info.period, offsetof(Epoch_block_t, blockEpochPeriod), sizeof(uint16_t), index) )
+			break;
+		// Block number changes if the read position was lost
+		if(block_info.block_number != status.syncReadBlock)
+		{
+			status.syncReadBlock = block_info.block_number;
+			status.syncReadOffset = 0;
+		}
+		block_info.data_length = AccelEpochBlockSamples(index);
+		// All the epochs in this block are sent
+		if(status.syncReadOffset >= block_info.data_length)
+		{
+			// The active block is the newest, finished
+			if(index == activeIndex)
+				break;
+			// Next block
+			status.syncReadBlock++;
+			status.syncReadOffset = 0;
+			continue;
+		}
+		// Frame of the unsent epochs in this block
+		info.block_number = status.syncReadBlock;
+		info.offset = status.syncReadOffset;
+		info.count = block_info.data_length - status.syncReadOffset;
+		info.time_stamp = block_info.time_stamp;
+		// Packed blocks may hold many epochs, sent in several frames
+		if(info.count > EPOCH_BLOCK_DATA_COUNT)
+			info.count = EPOCH_BLOCK_DATA_COUNT;
+		// Wait for queue space for the frame and the end frame
+		if(QueueFree(&serial_out_queue) < (2 * (BLE_FRAME_HEADER_LEN + sizeof(info))) + (info.count * sizeof(Epoch_sample_t)))
+			return;
+		if(ble_serial_frame_header(BLE_FRAME_TYPE_NEW_EPOCHS, sizeof(info) + (info.count * sizeof(Epoch_sample_t))) == 0)
+			return;
+		ble_serial_out_push(&info, sizeof(info));
+		// Write out the epochs in short sections to the queue
+		for(written = 0; written < info.count; written += toWrite)
+		{
+			toWrite = info.count - written;
+			if(toWrite > (sizeof(samples) / sizeof(Epoch_sample_t)))
+				toWrite = sizeof(samples) / sizeof(Epoch_sample_t);
+			if(!AccelEpochSampleRead(samples, info.offset + written, toWrite, index))
+				memset(samples, 0xFF, toWrite * sizeof(Epoch_sample_t));
+			ble_serial_out_push(samples, toWrite * sizeof(Epoch_sample_t));
+		}
+		// Read position follows the sent epochs
+		status.syncReadOffset += info.count;
+	}
+	// Caught up (or read failed), add the end frame - an empty frame at the next read position
+	info.block_number = status.syncReadBlock;
+	info.offset = status.syncReadOffset;
+	info.count = 0;
+	info.period = 0;
+	info.time_stamp = 0;
+	if(ble_serial_frame_header(BLE_FRAME_TYPE_NEW_EPOCHS, sizeof(info)) != 0)
+		ble_serial_out_push(&info, sizeof(info));
+	status.syncReadActive = false;
+}
+
 static void battery_level_update(void)
 {
 	uint32_t err_code;
@@ -1451,10 +1817,19 @@ static void on_ble_evt(ble_evt_t * p_ble_evt)
 				StopStreamingAndRestartLogger();
 			}
 
+			// No burst or new epoch read in progress, new epoch reads start at the sync cursor
+			status.burstCount = 0;
+			status.syncReadActive = false;
+			status.syncReadBlock = settings.syncBlock;
+			status.syncReadOffset = settings.syncOffset;
+			status.transferEncoding = TRANSFER_ENCODING_RAW;
 			// Update connection handle for new connection
 			m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
 			// Connection interval
 			m_conn_interval = p_ble_evt->evt.gap_evt.params.connected.conn_params.max_conn_interval;
+			// Automatic interval changes wait for the initial negotiation
+			conn_policy_idle = 0;
+			conn_policy_holdoff = CONN_POLICY_CONNECT_HOLDOFF;
 			break;
 			
 		case BLE_GAP_EVT_DISCONNECTED:
@@ -1466,6 +1841,9 @@ static void on_ble_evt(ble_evt_t * p_ble_evt)
 				StopStreamingAndRestartLogger();
 			}
 			
+			// Cancel any burst or new epoch read in progress
+			status.burstCount = 0;
+			status.syncReadActive = false;
 			// Reset gap parameters for next connection
 			gap_params_init();
 			conn_params_init();
@@ -1746,6 +2124,10 @@ void HardwareTasks(void* unused)
 			hw_ctrl.Motor = HW_SET_MODE(1,1,8);
 		}
 
+#ifdef CONN_POLICY_ENABLE
+		// Automatic connection interval
+		conn_param_policy_tasks();
+#endif
 		// Step goal check and reset timing
 		if((status.goalComplete == false) && (pedState.total > settings.goalStepCount))
 		{
@@ -2053,6 +2435,14 @@ int main(void)
 	if(!AccelEpochLoggerInit()) 
 		app_error_fault_handler(0xDEADBEEF + __LINE__, 0, (uint32_t)NULL);
 
+	// Compact epoch store - uses the pstorage pages after the epoch data, compacts the stored epoch blocks
+	if(!EpochCompactInit()) 
+		app_error_fault_handler(0xDEADBEEF + __LINE__, 0, (uint32_t)NULL);
+
+	// Daily totals ring - uses the pstorage pages after the compact epochs
+	if(!DailyRollupInit()) 
+		app_error_fault_handler(0xDEADBEEF + __LINE__, 0, (uint32_t)NULL);
+
 	// Initialize settings - uses pstorage second last page
 	if(SettingsInitialise())
 	{
@@ -2062,6 +2452,9 @@ int main(void)
 		SettingsPstorageSave();
 	}
 
+	// Today's totals so far from the stored epochs, the day start needs the settings
+	DailyRollupRestore();
+
 	// Setup remaining BLE systems
 	gap_params_init();
 	services_init();			// Starts up serial service internally
@@ -2157,6 +2550,18 @@ int main(void)
 				// If characters are received
 				if(serial_in_queue_flag)
 					serial_tasks();
+				// If the out queue is emptying, continue any burst read
+				if(serial_out_queue_flag)
+				{
+					serial_out_queue_flag = false;
+					SerialBurstTasks();
+					SerialSyncTasks();
+				}
+				// Compact the stored epoch blocks in the background, a little each pass
+				EpochCompactTasks();
+				// A settings save that waited for a free stage
+				if(settingsSaveDeferred)
+					SettingsPstorageSave();
 				// Logging state - counter is used to pause logger
 				if(status.appState == APP_STATE_LOGGING) 
 				{
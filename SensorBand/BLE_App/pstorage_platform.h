@@ -16,13 +16,16 @@
  *  This header contains defines with respect persistent storage that are specific to
  *  persistent storage implementation and application use case.
  Arrangement:
- Code... 0x0 -> (0x3C000 - (0x400 * 3+N))
- Data blocks x N (64) - 0x2B400
- Settings block x 1
+ Code... 0x0 -> (0x3C000 - (0x400 * 4+N))
+ Data blocks x N (50) - 0x2AC00
+ Erase journal x 1
+ Compact blocks x C (12)
+ Daily records x D (2)
+ Settings blocks x 2
  Device manager x 1
  Scratch x 1
  Bootloader... 0x3C000
- Page count = 3 + (EPOCH_NVM_SIZE_TOTAL/0x400)
+ Page count = 4 + ((EPOCH_NVM_SIZE_TOTAL + EPOCH_ERASE_NVM_SIZE + EPOCH_COMPACT_NVM_SIZE + DAILY_NVM_SIZE_TOTAL)/0x400)
  */
 #ifndef PSTORAGE_PL_H__
 #define PSTORAGE_PL_H__
@@ -36,23 +39,23 @@
 
 #define PSTORAGE_FLASH_PAGE_END	 (BOOTLOADER_REGION_START / PSTORAGE_FLASH_PAGE_SIZE)	//KL: Fixed location of last flash page before bootloader region
 
-#define PSTORAGE_NUM_OF_PAGES	   (3 + (EPOCH_NVM_SIZE_TOTAL/PSTORAGE_FLASH_PAGE_SIZE))	/**< Number of flash pages allocated for the pstorage module INCLUDING the swap page, configurable based on system requirements. */
+#define PSTORAGE_NUM_OF_PAGES	   (4 + ((EPOCH_NVM_SIZE_TOTAL + EPOCH_ERASE_NVM_SIZE + EPOCH_COMPACT_NVM_SIZE + DAILY_NVM_SIZE_TOTAL)/PSTORAGE_FLASH_PAGE_SIZE))	/**< Number of flash pages allocated for the pstorage module INCLUDING the swap page, configurable based on system requirements. */
 
-#define PSTORAGE_MAX_APPLICATIONS   3									/**< Maximum number of applications that can be registered with the module, configurable based on system requirements. */
+#define PSTORAGE_MAX_APPLICATIONS   6									/**< Maximum number of applications that can be registered with the module, configurable based on system requirements. */
 
 #define PSTORAGE_MIN_BLOCK_SIZE	 0x0010													  /**< Minimum size of block that can be registered with the module. Should be configured based on system requirements, recommendation is not have this value to be at least size of word. */
 
 #define PSTORAGE_DATA_START_ADDR	((PSTORAGE_FLASH_PAGE_END - PSTORAGE_NUM_OF_PAGES) \
 									* PSTORAGE_FLASH_PAGE_SIZE)									/**< Start address for persistent data, configurable according to system requirements. */
 
-#define PSTORAGE_SETTINGS_START_ADDR	((PSTORAGE_FLASH_PAGE_END - 3) * PSTORAGE_FLASH_PAGE_SIZE)	/**< Start address for persistent settings data. */
+#define PSTORAGE_SETTINGS_START_ADDR	((PSTORAGE_FLASH_PAGE_END - 4) * PSTORAGE_FLASH_PAGE_SIZE)	/**< Start address for persistent settings data (two pages). */
 
 #define PSTORAGE_DATA_END_ADDR	  ((PSTORAGE_FLASH_PAGE_END - 1) * PSTORAGE_FLASH_PAGE_SIZE)  /**< End address for persistent data, configurable according to system requirements. */
 
 #define PSTORAGE_SWAP_ADDR		  PSTORAGE_DATA_END_ADDR									  /**< Top-most page is used as swap area for clear and update. */
 
 #define PSTORAGE_MAX_BLOCK_SIZE	 PSTORAGE_FLASH_PAGE_SIZE									/**< Maximum size of block that can be registered with the module. Should be configured based on system requirements. And should be greater than or equal to the minimum size. */
-#define PSTORAGE_CMD_QUEUE_SIZE	 10														  /**< Maximum number of flash access commands that can be maintained by the module for all applications. Configurable. */
+#define PSTORAGE_CMD_QUEUE_SIZE	 16														  /**< Maximum number of flash access commands that can be maintained by the module for all applications. Configurable. */
 
 
 /** Abstracts persistently memory block identifier. */
@@ -0,0 +1,15 @@
+// CRC-16/CCITT (polynomial 0x1021, MSB first, no reflection), table driven
+#ifndef _CRC16_H_
+#define _CRC16_H_
+// Include
+#include <stdint.h>
+
+// Definitions
+#define CRC16_CCITT_INIT	0xFFFF		// Initial value, same result as the SDK crc16_compute()
+
+// Functions
+// Continue a CRC over the data, start with CRC16_CCITT_INIT
+uint16_t Crc16Ccitt(const void* data, uint16_t length, uint16_t crc);
+
+#endif
+//EOF
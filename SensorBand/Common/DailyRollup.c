@@ -0,0 +1,350 @@
+// Daily rollup, a ring of per day epoch totals in its own NVM region, days aligned to the goal period
+// Records are written whole to erased flash, the next page is erased ahead when the ring enters it
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stddef.h>
+#include "nordic_common.h"
+#include "app_error.h"
+#include "pstorage.h"
+#include "Crc16.h"
+#include "DailyRollup.h"
+
+// Definitions
+#define DAILY_PAGE_RECORDS			(PSTORAGE_FLASH_PAGE_SIZE / DAILY_RECORD_SIZE)	// Records per flash page, erased together
+#define DAILY_PERIOD_DEFAULT		(24ul * 60ul * 60ul)							// Day length if the goal period is not set
+#define DAILY_START_INVALID			(0xFFFFFFFFul)									// No day stored
+#define DAILY_RETRY_MAX				3												// Failed writes or erases in a row before a fault
+
+// Globals
+static pstorage_handle_t	daily_pstorage_handle;				// Persistent storage handle for the daily records
+static uint16_t				dailyIndex = DAILY_RECORD_COUNT;	// Position of the next record in NVM, invalid until initialised
+static DailyRecord_t		dailyCurrent;						// Current day, epochs is zero until the first epoch
+static uint32_t				dailyWearSeconds;					// Current day worn time
+static DailyRecord_t		dailyStage[2];						// Records being written, the source must not change until written
+static uint8_t				dailyStageNext;
+static uint32_t				dailyStoredStart = DAILY_START_INVALID;	// Start of the newest stored day
+static uint8_t				dailyRetries;						// Failed NVM operations in a row
+
+// Prototypes
+static uint32_t DailyRollupDayStart(uint32_t time);
+static void DailyRollupStore(void);
+static void DailyRollupWrite(DailyRecord_t* record);
+static bool DailyRollupEraseAhead(void);
+static bool DailyRollupErased(uint16_t index, uint16_t count);
+static void DailyPstorageEventHandler(pstorage_handle_t * p_handle, uint8_t op_code, uint32_t result, uint8_t* p_data, uint32_t data_len);
+
+// Source
+bool DailyRollupInit(void)
+{
+	pstorage_module_param_t param;
+	pstorage_handle_t block_handle;
+	const DailyRecord_t* ring;
+	uint16_t index, head, number;
+
+	// Verify the record is the expected size - should be 32 bytes
+	if(sizeof(DailyRecord_t) != DAILY_RECORD_SIZE)
+		return false;
+
+	// Register with the pstorage module, follows the epoch data pages
+	param.block_size  = DAILY_RECORD_SIZE;
+	param.block_count = DAILY_RECORD_COUNT;
+	param.cb		  = DailyPstorageEventHandler;
+	if(pstorage_register(&param, &daily_pstorage_handle) != NRF_SUCCESS)
+		return false;
+
+	// Epoch blocks of the layout before 2.0 are left in the region, it is erased and the ring starts again
+	memset(&dailyCurrent, 0, sizeof(DailyRecord_t));
+	dailyWearSeconds = 0;
+	dailyStoredStart = DAILY_START_INVALID;
+	if(AccelEpochLayoutUpdated())
+	{
+		dailyIndex = 0;
+		block_handle.module_id = daily_pstorage_handle.module_id;
+		return	(pstorage_block_identifier_get(&daily_pstorage_handle, 0, &block_handle) == NRF_SUCCESS) &&
+				(pstorage_clear(&block_handle, DAILY_NVM_SIZE_TOTAL) == NRF_SUCCESS);
+	}
+
+	// Newest valid record, there are few enough to read them all
+	ring = DailyRollupRing();
+	head = DAILY_RECORD_COUNT;
+	number = 0;
+	for(index = 0; index < DAILY_RECORD_COUNT; index++)
+	{
+		if((ring[index].number > DAILY_NUMBER_LAST) ||
+			(ring[index].check != Crc16Ccitt(&ring[index], offsetof(DailyRecord_t, check), CRC16_CCITT_INIT)))
+			continue;
+		if((head >= DAILY_RECORD_COUNT) || ((uint16_t)(ring[index].number - number) < 0x8000))
+		{
+			head = index;
+			number = ring[index].number;
+		}
+	}
+
+	// Next record follows the newest
+	if(head < DAILY_RECORD_COUNT)
+	{
+		dailyIndex = (head + 1) % DAILY_RECORD_COUNT;
+		dailyCurrent.number = (number >= DAILY_NUMBER_LAST) ? 0 : number + 1;
+		if(!(ring[head].flags & DAILY_FLAG_CLEARED))
+			dailyStoredStart = ring[head].dayStart;
+	}
+	else
+		dailyIndex = 0;
+
+	// Records are only written to erased flash, a record left part written by a reset is skipped with its page
+	if(!DailyRollupErased(dailyIndex, 1))
+		dailyIndex = (dailyIndex - (dailyIndex % DAILY_PAGE_RECORDS) + DAILY_PAGE_RECORDS) % DAILY_RECORD_COUNT;
+	if(!DailyRollupErased(dailyIndex, DAILY_PAGE_RECORDS - (dailyIndex % DAILY_PAGE_RECORDS)))
+	{
+		// Page start, erase it now. Otherwise the page holds other records, move to the next
+		if((dailyIndex % DAILY_PAGE_RECORDS) != 0)
+			dailyIndex = (dailyIndex - (dailyIndex % DAILY_PAGE_RECORDS) + DAILY_PAGE_RECORDS) % DAILY_RECORD_COUNT;
+		DailyRollupEraseAhead();
+	}
+	return true;
+}
+
+void DailyRollupRestore(void)
+{
+	Epoch_sample_t epoch;
+	uint32_t start, end, period, time, dayStart;
+	uint16_t index, count, sample;
+	// Once, before the first epoch is added
+	if((dailyIndex >= DAILY_RECORD_COUNT) || (activeIndex >= EPOCH_NVM_BLOCK_COUNT) || (dailyCurrent.epochs != 0))
+		return;
+	// The day of the newest stored epoch, in the active block or the one before it
+	index = activeIndex;
+	if(AccelEpochBlockSamples(index) == 0)
+		index = AccelEpochBlockFind(activeEpochBlock.info.block_number - 1);
+	count = AccelEpochBlockSamples(index);
+	if((count == 0) || !AccelEpochBlockTimes(index, &start, &end))
+		return;
+	// Block times are of the first epoch close, an epoch is in the day of its start
+	period = (end - start) / count;
+	dayStart = DailyRollupDayStart(end - (2 * period));
+	// The day was stored before the reset, the next epoch starts a new day
+	if(dayStart == dailyStoredStart)
+		return;
+	// Add the stored epochs of the day again, from the block holding the day start to the active block
+	for(index = AccelEpochBlockFindTime(dayStart); index < EPOCH_NVM_BLOCK_COUNT; index = (index + 1) % EPOCH_NVM_BLOCK_COUNT)
+	{
+		count = AccelEpochBlockSamples(index);
+		if((count > 0) && AccelEpochBlockTimes(index, &start, &end))
+		{
+			period = (end - start) / count;
+			for(sample = 0; sample < count; sample++)
+			{
+				time = start + ((uint32_t)sample * period) - period;
+				// Only the last run of the day counts, the clock may have been changed
+				if(DailyRollupDayStart(time) != dayStart)
+				{
+					dailyCurrent.epochs = 0;
+					continue;
+				}
+				if(!AccelEpochSampleRead(&epoch, sample, 1, index))
+					break;
+				// Steps have two more bits in the top of the orientation
+				DailyRollupAddEpoch(time, &epoch, (uint8_t)epoch.part.steps | (((uint16_t)(uint8_t)epoch.part.accel & 0xC0) << 2));
+			}
+		}
+		if(index == activeIndex)
+			break;
+	}
+}
+
+void DailyRollupAddEpoch(uint32_t time, const Epoch_sample_t* epoch, uint16_t steps)
+{
+	uint32_t dayStart, energy;
+	dayStart = DailyRollupDayStart(time);
+	// An epoch in another day ends the current day
+	if((dailyCurrent.epochs != 0) && (dayStart != dailyCurrent.dayStart))
+		DailyRollupStore();
+	// First epoch of the day
+	if(dailyCurrent.epochs == 0)
+	{
+		uint16_t number = dailyCurrent.number;
+		memset(&dailyCurrent, 0, sizeof(DailyRecord_t));
+		dailyCurrent.number = number;
+		dailyCurrent.dayStart = dayStart;
+		dailyCurrent.tempMin = INT8_MAX;
+		dailyCurrent.tempMax = INT8_MIN;
+		memset(dailyCurrent.reserved, 0xFF, sizeof(dailyCurrent.reserved));
+		dailyWearSeconds = 0;
+		// Not the first epoch window of the day
+		if(time > dayStart)
+			dailyCurrent.flags |= DAILY_FLAG_PARTIAL;
+	}
+	// Energy is stored little endian, not aligned
+	energy =	((uint32_t)(uint8_t)epoch->part.epoch[0]) | ((uint32_t)(uint8_t)epoch->part.epoch[1] << 8) |
+				((uint32_t)(uint8_t)epoch->part.epoch[2] << 16) | ((uint32_t)(uint8_t)epoch->part.epoch[3] << 24);
+	// Add the epoch to the day
+	dailyCurrent.epochs++;
+	dailyCurrent.steps += steps;
+	dailyCurrent.energy += energy;
+	if((steps != 0) || (energy >= DAILY_WEAR_ENERGY_MIN))
+	{
+		dailyWearSeconds += settings.epochPeriod;
+		dailyCurrent.wearMinutes = (dailyWearSeconds / 60ul > 0xFFFF) ? 0xFFFF : (uint16_t)(dailyWearSeconds / 60ul);
+	}
+	dailyCurrent.epochPeriod = settings.epochPeriod;
+	if(epoch->part.temp < dailyCurrent.tempMin)
+		dailyCurrent.tempMin = epoch->part.temp;
+	if(epoch->part.temp > dailyCurrent.tempMax)
+		dailyCurrent.tempMax = epoch->part.temp;
+	dailyCurrent.battEnd = epoch->part.batt;
+}
+
+void DailyRollupTimeChanged(void)
+{
+	// Only for a day with epochs, the next epoch may start a new day
+	if(dailyCurrent.epochs != 0)
+		dailyCurrent.flags |= DAILY_FLAG_TIME_CHANGED;
+}
+
+void DailyRollupCurrent(DailyRecord_t* record)
+{
+	memcpy(record, &dailyCurrent, sizeof(DailyRecord_t));
+	record->flags |= DAILY_FLAG_OPEN;
+	record->check = Crc16Ccitt(record, offsetof(DailyRecord_t, check), CRC16_CCITT_INIT);
+}
+
+const DailyRecord_t* DailyRollupRing(void)
+{
+	pstorage_handle_t block_handle;
+	// The block identifier is the flash address
+	block_handle.module_id = daily_pstorage_handle.module_id;
+	if(pstorage_block_identifier_get(&daily_pstorage_handle, 0, &block_handle) != NRF_SUCCESS)
+		return NULL;
+	return (const DailyRecord_t*)block_handle.block_id;
+}
+
+bool DailyRollupClearAll(void)
+{
+	uint16_t number;
+	// Nothing is erased, a marker record hides the older records until the ring overwrites them
+	if(dailyIndex >= DAILY_RECORD_COUNT)
+	{
+		app_error_fault_handler(0xDA11DA11 + __LINE__, 0, (uint32_t)NULL);
+		return false;
+	}
+	number = dailyCurrent.number;
+	memset(&dailyCurrent, 0, sizeof(DailyRecord_t));
+	dailyCurrent.number = number;
+	dailyCurrent.flags = DAILY_FLAG_CLEARED;
+	memset(dailyCurrent.reserved, 0xFF, sizeof(dailyCurrent.reserved));
+	DailyRollupStore();
+	// Start a new day after the marker
+	number = dailyCurrent.number;
+	memset(&dailyCurrent, 0, sizeof(DailyRecord_t));
+	dailyCurrent.number = number;
+	dailyWearSeconds = 0;
+	return true;
+}
+
+// Days start where the goal count is reset
+static uint32_t DailyRollupDayStart(uint32_t time)
+{
+	uint32_t period = (settings.goalPeriod != 0) ? settings.goalPeriod : DAILY_PERIOD_DEFAULT;
+	return time - ((time + settings.goalTimeOffset) % period);
+}
+
+// Write the current day to the next record and start a new day
+static void DailyRollupStore(void)
+{
+	DailyRecord_t* stage;
+	if(dailyIndex >= DAILY_RECORD_COUNT)
+		return;
+	// Written from a copy, alternate copies in case the clock is set while one is queued
+	stage = &dailyStage[dailyStageNext];
+	dailyStageNext ^= 1;
+	memcpy(stage, &dailyCurrent, sizeof(DailyRecord_t));
+	stage->check = Crc16Ccitt(stage, offsetof(DailyRecord_t, check), CRC16_CCITT_INIT);
+	if(!(stage->flags & DAILY_FLAG_CLEARED))
+		dailyStoredStart = stage->dayStart;
+	DailyRollupWrite(stage);
+	// Next number, the day is empty until the next epoch
+	dailyCurrent.number = (dailyCurrent.number >= DAILY_NUMBER_LAST) ? 0 : dailyCurrent.number + 1;
+	dailyCurrent.epochs = 0;
+}
+
+// Queue a record to the next position, the source must not change until it is written
+static void DailyRollupWrite(DailyRecord_t* record)
+{
+	pstorage_handle_t block_handle;
+	block_handle.module_id = daily_pstorage_handle.module_id;
+	if(	(pstorage_block_identifier_get(&daily_pstorage_handle, dailyIndex, &block_handle) != NRF_SUCCESS) ||
+		(pstorage_store(&block_handle, (uint8_t*)record, DAILY_RECORD_SIZE, 0) != NRF_SUCCESS) )
+	{
+		app_error_fault_handler(0xDA11DA11 + __LINE__, 0, (uint32_t)NULL);
+		return;
+	}
+	dailyIndex = (dailyIndex + 1) % DAILY_RECORD_COUNT;
+	// Entering a new page, erase it ahead of the next record (the oldest days)
+	if((dailyIndex % DAILY_PAGE_RECORDS) == 0)
+		DailyRollupEraseAhead();
+}
+
+static bool DailyRollupEraseAhead(void)
+{
+	pstorage_handle_t block_handle;
+	// Erase the whole page at the next record
+	block_handle.module_id = daily_pstorage_handle.module_id;
+	if(	(pstorage_block_identifier_get(&daily_pstorage_handle, dailyIndex - (dailyIndex % DAILY_PAGE_RECORDS), &block_handle) != NRF_SUCCESS) ||
+		(pstorage_clear(&block_handle, PSTORAGE_FLASH_PAGE_SIZE) != NRF_SUCCESS) )
+	{
+		app_error_fault_handler(0xDA11DA11 + __LINE__, 0, (uint32_t)NULL);
+		return false;
+	}
+	// Queued, completes before the next store
+	return true;
+}
+
+static bool DailyRollupErased(uint16_t index, uint16_t count)
+{
+	const uint32_t* word = (const uint32_t*)&DailyRollupRing()[index];
+	uint32_t remaining;
+	// Every word must be erased
+	for(remaining = (count * DAILY_RECORD_SIZE) / sizeof(uint32_t); remaining > 0; remaining--)
+	{
+		if(*word++ != 0xFFFFFFFF)
+			return false;
+	}
+	return true;
+}
+
+// Called from the pstorage background module on events
+static void DailyPstorageEventHandler(pstorage_handle_t * p_handle, uint8_t op_code, uint32_t result, uint8_t* p_data, uint32_t data_len)
+{
+	pstorage_handle_t block_handle;
+	// Done, or a record that reached the flash before the operation timed out
+	if(	(result == NRF_SUCCESS) ||
+		((op_code == PSTORAGE_STORE_OP_CODE) && (memcmp((const void*)p_handle->block_id, p_data, DAILY_RECORD_SIZE) == 0)) )
+	{
+		dailyRetries = 0;
+		return;
+	}
+	// The flash keeps failing
+	if(++dailyRetries > DAILY_RETRY_MAX)
+	{
+		app_error_fault_handler(0xDA11DA11 + __LINE__, 0, (uint32_t)NULL);
+		return;
+	}
+	switch(op_code)
+	{
+		case PSTORAGE_STORE_OP_CODE:
+			// The record may be part written (skipped by a reader's check), write the stage again at the next record
+			DailyRollupWrite((DailyRecord_t*)p_data);
+			break;
+		case PSTORAGE_CLEAR_OP_CODE:
+			// Erase the page again, the next record is a day away
+			memcpy(&block_handle, p_handle, sizeof(pstorage_handle_t));
+			if(pstorage_clear(&block_handle, PSTORAGE_FLASH_PAGE_SIZE) != NRF_SUCCESS)
+				app_error_fault_handler(0xDA11DA11 + __LINE__, 0, (uint32_t)NULL);
+			break;
+		default:
+			break;
+	}
+}
+//EOF
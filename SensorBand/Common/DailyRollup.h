@@ -0,0 +1,61 @@
+// Daily rollup, a ring of per day epoch totals in its own NVM region, days aligned to the goal period
+#ifndef _DAILY_ROLLUP_H_
+#define _DAILY_ROLLUP_H_
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+#include "acc_tasks.h"
+#include "Config.h"
+
+// Definitions
+#ifndef DAILY_WEAR_ENERGY_MIN
+#define DAILY_WEAR_ENERGY_MIN		2048ul			// Epoch energy (sum per second) counted as worn, ~10mg at the default rate
+#endif
+
+#define DAILY_RECORD_SIZE			(32ul)											// Size of a daily record
+#define DAILY_RECORD_COUNT			(DAILY_NVM_SIZE_TOTAL / DAILY_RECORD_SIZE)		// Number of records in the ring
+#define DAILY_NUMBER_LAST			(0xFFFE)										// Valid records numbered within this range, wraps arround
+
+// Daily record flags
+#define DAILY_FLAG_PARTIAL			0x01	// Epochs missing at the start of the day (logger started, reset or erase)
+#define DAILY_FLAG_TIME_CHANGED		0x02	// The clock was set during the day
+#define DAILY_FLAG_CLEARED			0x04	// Clear marker with no epochs, records numbered before it were cleared
+#define DAILY_FLAG_OPEN				0x80	// The current day, not yet stored (only in reads)
+
+// Types
+// Totals for one day, written once to erased flash when the day ends
+typedef struct DailyRecord_tag {
+	uint16_t number;		// Record sequence number, erased if 0xFFFF
+	uint16_t epochs;		// Epochs added
+	uint32_t dayStart;		// Time of the day start
+	uint32_t steps;			// Total steps
+	uint32_t energy;		// Sum of the epoch energy
+	uint16_t wearMinutes;	// Time of the epochs counted as worn
+	uint16_t epochPeriod;	// Epoch period of the last epoch
+	int8_t tempMin;			// Lowest temperature
+	int8_t tempMax;			// Highest temperature
+	int8_t battEnd;			// Battery of the last epoch
+	uint8_t flags;			// Daily record flags
+	uint8_t reserved[6];
+	uint16_t check;			// CRC-16/CCITT of the first 30 bytes
+} DailyRecord_t;
+
+// Functions
+// Register the NVM region (after the epoch logger) and find the write position
+bool DailyRollupInit(void);
+// Today's totals from the stored epochs after a reset, call once the logger and settings are initialised
+void DailyRollupRestore(void);
+// Add a logged epoch starting at the time, the day is stored when an epoch is in the next day
+void DailyRollupAddEpoch(uint32_t time, const Epoch_sample_t* epoch, uint16_t steps);
+// Note a clock change in the current day
+void DailyRollupTimeChanged(void);
+// Copy of the current day, flagged open
+void DailyRollupCurrent(DailyRecord_t* record);
+// Stored records in memory mapped NVM, DAILY_RECORD_COUNT in index order (erased records are all 0xFF)
+// Records numbered before the newest clear marker are cleared and must be ignored by the reader
+const DailyRecord_t* DailyRollupRing(void);
+// Logical clear, writes a clear marker record and starts a new day
+bool DailyRollupClearAll(void);
+
+#endif
+//EOF
@@ -28,12 +28,57 @@ void EpochInit(accel_t* current)
 	eepoch_sum = 0;
 }
 
-/** Integer sqrt+round: stackoverflow.com/questions/1100090/looking-for-an-efficient-integer-square-root-algorithm-for-arm-thumb2
+// Square root of the top 8 bits of a 16 bit value, isqrt(index << 8)
+static const uint8_t sqrtTable[256] = {
+	  0,  16,  22,  27,  32,  35,  39,  42,  45,  48,  50,  53,  55,  57,  59,  61,
+	 64,  65,  67,  69,  71,  73,  75,  76,  78,  80,  81,  83,  84,  86,  87,  89,
+	 90,  91,  93,  94,  96,  97,  98,  99, 101, 102, 103, 104, 106, 107, 108, 109,
+	110, 112, 113, 114, 115, 116, 117, 118, 119, 120, 121, 122, 123, 124, 125, 126,
+	128, 128, 129, 130, 131, 132, 133, 134, 135, 136, 137, 138, 139, 140, 141, 142,
+	143, 144, 144, 145, 146, 147, 148, 149, 150, 150, 151, 152, 153, 154, 155, 155,
+	156, 157, 158, 159, 160, 160, 161, 162, 163, 163, 164, 165, 166, 167, 167, 168,
+	169, 170, 170, 171, 172, 173, 173, 174, 175, 176, 176, 177, 178, 178, 179, 180,
+	181, 181, 182, 183, 183, 184, 185, 185, 186, 187, 187, 188, 189, 189, 190, 191,
+	192, 192, 193, 193, 194, 195, 195, 196, 197, 197, 198, 199, 199, 200, 201, 201,
+	202, 203, 203, 204, 204, 205, 206, 206, 207, 208, 208, 209, 209, 210, 211, 211,
+	212, 212, 213, 214, 214, 215, 215, 216, 217, 217, 218, 218, 219, 219, 220, 221,
+	221, 222, 222, 223, 224, 224, 225, 225, 226, 226, 227, 227, 228, 229, 229, 230,
+	230, 231, 231, 232, 232, 233, 234, 234, 235, 235, 236, 236, 237, 237, 238, 238,
+	239, 240, 240, 241, 241, 242, 242, 243, 243, 244, 244, 245, 245, 246, 246, 247,
+	247, 248, 248, 249, 249, 250, 250, 251, 251, 252, 252, 253, 253, 254, 254, 255
+};
+
+/** Integer sqrt+round, exact (no error) for all 32 bit inputs
  *	   - SquareRootRounded(6) --> 2
  *	   - SquareRootRounded(7) --> 3
+ *	The input is shifted down by 2k bits to 16 bits, the table gives the top of the root to within 2^(k+1) and
+ *	the rest is found with at most 9 multiply and compare steps (the M0 has no divide or leading zero count)
  */
 uint32_t SquareRootRounded(uint32_t a_nInput)
 {
+#ifndef EE_SQRT_BITWISE
+	uint32_t y = a_nInput;
+	uint32_t res, trial, bit;
+	uint8_t k = 0;
+	// Even shift down to 16 bits
+	if(y >= 0x01000000ul) { y >>= 8; k += 4; }
+	if(y >= 0x00100000ul) { y >>= 4; k += 2; }
+	if(y >= 0x00040000ul) { y >>= 2; k += 1; }
+	if(y >= 0x00010000ul) { y >>= 2; k += 1; }
+	// Root of the top bits, low by less than 2^(k+1), or by up to 16 for small unshifted values
+	res = (uint32_t)sqrtTable[y >> 8] << k;
+	// Add the remaining bits that keep the square within the input (the root is at most 16 bits)
+	for(bit = (k != 0) ? (1ul << k) : 16; bit != 0; bit >>= 1)
+	{
+		trial = res + bit;
+		if((trial <= 0xFFFF) && ((trial * trial) <= a_nInput))
+			res = trial;
+	}
+	/* Do arithmetic rounding to nearest integer */
+	if((a_nInput - (res * res)) > res){res++;}
+	return res;
+#else
+	// Original bit by bit method: stackoverflow.com/questions/1100090/looking-for-an-efficient-integer-square-root-algorithm-for-arm-thumb2
 	uint32_t op  = a_nInput;
 	uint32_t res = 0;
 	uint32_t one = 1uL << 30; // The second-to-top bit is set: use 1u << 14 for uint16_t type; use 1uL<<30 for uint32_t type
@@ -52,22 +97,24 @@ uint32_t SquareRootRounded(uint32_t a_nInput)
 	/* Do arithmetic rounding to nearest integer */
 	if(op > res){res++;}
 	return res;
+#endif
 }
 
-uint32_t CalcSvm(accel_t* data)
+// Filter and vector magnitude of one sample, the filter state is passed in so a batch can keep it in registers
+static inline uint32_t SvmStep(int32_t* xdc, int32_t* ydc, int32_t* zdc, const accel_t* data)
 {
 	// Calc vector magnitude 
 	int32_t x_sqr, y_sqr, z_sqr;
 	uint32_t temp;
 	// Update DC value accumulators for HPF
-	x_dc = x_dc - (x_dc >> EE_LPF_SHIFT) + data->x;
-	y_dc = y_dc - (y_dc >> EE_LPF_SHIFT) + data->y;
-	z_dc = z_dc - (z_dc >> EE_LPF_SHIFT) + data->z;
+	*xdc = *xdc - (*xdc >> EE_LPF_SHIFT) + data->x;
+	*ydc = *ydc - (*ydc >> EE_LPF_SHIFT) + data->y;
+	*zdc = *zdc - (*zdc >> EE_LPF_SHIFT) + data->z;
 // KL: Fixed...
 	// Apply high pass filter
-    x_sqr = data->x - (x_dc >> EE_LPF_SHIFT);
-    y_sqr = data->y - (y_dc >> EE_LPF_SHIFT);
-    z_sqr = data->z - (z_dc >> EE_LPF_SHIFT);
+    x_sqr = data->x - (*xdc >> EE_LPF_SHIFT);
+    y_sqr = data->y - (*ydc >> EE_LPF_SHIFT);
+    z_sqr = data->z - (*zdc >> EE_LPF_SHIFT);
 	// Square vals
 	x_sqr *= x_sqr;
 	y_sqr *= y_sqr;
@@ -88,81 +135,119 @@ uint32_t CalcSvm(accel_t* data)
 	return (SquareRootRounded(temp));
 }
 
-uint32_t EpochAdd(accel_t* data)
-{
-	uint32_t svm;
-	// Get sample svm
-	svm = CalcSvm(data);
-	// Accumulate and add to sample count
-	eepoch_sum += svm;
-	sample_count++;
-	// Apply pedometer calculation (w'clamp)
-	if(svm > 0x00007FFF)
-		svm = 0x7FFF;
-	PedTask(svm);
-	// Return size of epoch
-	return sample_count;
-}
-
-// Initialize variables
-void PedInit(int16_t initialiser)
+uint32_t CalcSvm(accel_t* data)
 {
-	// Clear pedometer status
-	memset(&pedState, 0, sizeof(PedState_t));
-	pedState.min = pedState.max = initialiser;
+	return SvmStep(&x_dc, &y_dc, &z_dc, data);
 }
 
-// Tasks required per sample
-void PedTask(int16_t amplitude)
+// Tasks required per sample, on the state passed in so a batch can keep it local
+static inline void PedStep(PedState_t* ped, int16_t amplitude)
 {
 	// Track Max/Min (fast attack and slow decay tracking)
-	pedState.max = pedState.max - (1 + pedState.level >> 3);
-	pedState.min = pedState.min + (1 + pedState.level >> 3);
-	if (pedState.max <= amplitude)	pedState.max = amplitude;	
-	if (pedState.min >= amplitude)	pedState.min = amplitude;
+	ped->max = ped->max - (1 + ped->level >> 3);
+	ped->min = ped->min + (1 + ped->level >> 3);
+	if (ped->max <= amplitude)	ped->max = amplitude;	
+	if (ped->min >= amplitude)	ped->min = amplitude;
 
 	// Calculate peak-to-peak activity level
-	pedState.level = pedState.max - pedState.min;
+	ped->level = ped->max - ped->min;
 
 	// Pedometer state machine to track step thresholds
-	if(pedState.level > PED_MIN_ACTIVITY_LEVEL)
+	if(ped->level > PED_MIN_ACTIVITY_LEVEL)
 	{
 		// Bottom level threshold calculate and check, 25% of range
-		pedState.Tmin = pedState.min + (pedState.level >> 2);		
+		ped->Tmin = ped->min + (ped->level >> 2);		
 		// While level is below the low threshold
-		if(amplitude < pedState.Tmin)
+		if(amplitude < ped->Tmin)
 		{
 			// Set low-detected state
-			pedState.phase = PED_LOW_DETECTED;
+			ped->phase = PED_LOW_DETECTED;
 		}
-		else if(pedState.phase == PED_LOW_DETECTED)
+		else if(ped->phase == PED_LOW_DETECTED)
 		{
 			// After low detected, calculate and check for upper threshold, 75% of range
-			pedState.Tmax = pedState.max - (pedState.level >> 2);	
-			if(amplitude > pedState.Tmax)
+			ped->Tmax = ped->max - (ped->level >> 2);	
+			if(amplitude > ped->Tmax)
 			{
 				// Low/High detected, check step interval
-				if(pedState.interval > PED_MIN_STEP_INTERVAL)
+				if(ped->interval > PED_MIN_STEP_INTERVAL)
 				{
-					pedState.phase = PED_STEP_DETECTED;
+					ped->phase = PED_STEP_DETECTED;
 					// Reset state machine variables
-					pedState.interval = 0;
-					pedState.phase = PED_NO_STATE;
-					pedState.total++;
-					pedState.steps++;
+					ped->interval = 0;
+					ped->phase = PED_NO_STATE;
+					ped->total++;
+					ped->steps++;
 				}
 			}
 		}
 		// Pedometer state machine to measure and validate step intervals
-		if(++pedState.interval > PED_MAX_STEP_INTERVAL)
+		if(++ped->interval > PED_MAX_STEP_INTERVAL)
 		{
-			pedState.interval = PED_MIN_STEP_INTERVAL;
+			ped->interval = PED_MIN_STEP_INTERVAL;
 			// Begin looking for low level state again
-			pedState.phase = PED_NO_STATE;
+			ped->phase = PED_NO_STATE;
 		}
 	}
 }
 
+void PedTask(int16_t amplitude)
+{
+	PedStep(&pedState, amplitude);
+}
+
+uint32_t EpochAdd(accel_t* data)
+{
+	uint32_t svm;
+	// Get sample svm
+	svm = CalcSvm(data);
+	// Accumulate and add to sample count
+	eepoch_sum += svm;
+	sample_count++;
+	// Apply pedometer calculation (w'clamp)
+	if(svm > 0x00007FFF)
+		svm = 0x7FFF;
+	PedTask(svm);
+	// Return size of epoch
+	return sample_count;
+}
+
+// Add a batch of samples, same results as adding each. The filter and pedometer state are kept local for the batch
+// and the energy is summed in 32 bits, then added to the epoch once. The SVM is the rounded root of a 32 bit sum so
+// at most 2^16, the largest count (65535) sums to at most 0xFFFF0000 and cannot overflow. The logger adds one FIFO read at a time
+uint32_t EpochAddBatch(const accel_t* data, uint16_t count)
+{
+	int32_t xdc = x_dc, ydc = y_dc, zdc = z_dc;
+	PedState_t ped = pedState;
+	uint32_t svm, sum = 0;
+	uint16_t index;
+	for(index = 0; index < count; index++)
+	{
+		svm = SvmStep(&xdc, &ydc, &zdc, &data[index]);
+		sum += svm;
+		// Apply pedometer calculation (w'clamp)
+		if(svm > 0x00007FFF)
+			svm = 0x7FFF;
+		PedStep(&ped, svm);
+	}
+	// Write back the state once
+	x_dc = xdc;
+	y_dc = ydc;
+	z_dc = zdc;
+	pedState = ped;
+	eepoch_sum += sum;
+	sample_count += count;
+	return sample_count;
+}
+
+// Initialize variables
+void PedInit(int16_t initialiser)
+{
+	// Clear pedometer status
+	memset(&pedState, 0, sizeof(PedState_t));
+	pedState.min = pedState.max = initialiser;
+}
+
 uint16_t PedResetSteps(void)
 {
 	uint16_t steps = pedState.steps;
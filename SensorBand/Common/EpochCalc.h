@@ -44,6 +44,8 @@ uint32_t CalcSvm(accel_t* data);
 
 uint32_t EpochAdd(accel_t* data);
 
+uint32_t EpochAddBatch(const accel_t* data, uint16_t count);
+
 void PedInit(int16_t initialiser);
 
 void PedTask(int16_t amplitude);
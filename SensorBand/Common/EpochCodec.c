@@ -0,0 +1,187 @@
+// Packed epoch sample encoding for transfer, delta/zigzag/varint per field with runs of repeated samples
+// No hardware dependencies, the same source is used by the host decoder
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "EpochCodec.h"
+
+// Definitions
+// Sample byte offsets
+#define SAMPLE_BATT			0
+#define SAMPLE_TEMP			1
+#define SAMPLE_ACCEL		2
+#define SAMPLE_STEPS		3
+#define SAMPLE_ENERGY		4
+
+// Prototypes
+static uint8_t EpochCodecPutVarint(uint8_t* destination, int32_t value);
+static bool EpochCodecGetVarint(const uint8_t** source, const uint8_t* end, int32_t* value);
+static uint32_t EpochCodecEnergy(const uint8_t* sample);
+
+// Source
+void EpochCodecInit(EpochCodec_t* codec)
+{
+	memset(codec, 0, sizeof(EpochCodec_t));
+}
+
+uint8_t EpochCodecEncode(EpochCodec_t* codec, const uint8_t* sample, uint8_t* destination)
+{
+	uint8_t length;
+	// Repeated samples are counted and written as one record
+	if(memcmp(sample, codec->prev, EPOCH_CODEC_SAMPLE_LEN) == 0)
+	{
+		// Write out a full run first, then start the next run
+		length = (codec->run >= EPOCH_CODEC_RUN_MAX) ? EpochCodecFlush(codec, destination) : 0;
+		codec->run++;
+		return length;
+	}
+	// Changed sample, write out any run before it
+	length = EpochCodecFlush(codec, destination);
+	return length + EpochCodecRecord(codec, sample, destination + length);
+}
+
+uint8_t EpochCodecRecord(EpochCodec_t* codec, const uint8_t* sample, uint8_t* destination)
+{
+	uint8_t control, *record = destination;
+	uint32_t energy;
+	// Control byte of changed fields, zero for a repeated sample
+	control = 0;
+	if(sample[SAMPLE_BATT] != codec->prev[SAMPLE_BATT])		control |= EPOCH_CODEC_BATT;
+	if(sample[SAMPLE_TEMP] != codec->prev[SAMPLE_TEMP])		control |= EPOCH_CODEC_TEMP;
+	if(sample[SAMPLE_ACCEL] != codec->prev[SAMPLE_ACCEL])	control |= EPOCH_CODEC_ACCEL;
+	if(sample[SAMPLE_STEPS] != codec->prev[SAMPLE_STEPS])	control |= EPOCH_CODEC_STEPS;
+	energy = EpochCodecEnergy(sample) - EpochCodecEnergy(codec->prev);
+	if(energy != 0)											control |= EPOCH_CODEC_ENERGY;
+	*record++ = control;
+	// Slowly changing values as the 8 bit difference
+	if(control & EPOCH_CODEC_BATT)
+		record += EpochCodecPutVarint(record, (int8_t)(sample[SAMPLE_BATT] - codec->prev[SAMPLE_BATT]));
+	if(control & EPOCH_CODEC_TEMP)
+		record += EpochCodecPutVarint(record, (int8_t)(sample[SAMPLE_TEMP] - codec->prev[SAMPLE_TEMP]));
+	// Bit fields, not numeric
+	if(control & EPOCH_CODEC_ACCEL)
+		*record++ = sample[SAMPLE_ACCEL];
+	if(control & EPOCH_CODEC_STEPS)
+		*record++ = sample[SAMPLE_STEPS];
+	// Energy as the 32 bit difference
+	if(control & EPOCH_CODEC_ENERGY)
+		record += EpochCodecPutVarint(record, (int32_t)energy);
+	// Keep the sample for the next difference
+	memcpy(codec->prev, sample, EPOCH_CODEC_SAMPLE_LEN);
+	return (uint8_t)(record - destination);
+}
+
+uint8_t EpochCodecFlush(EpochCodec_t* codec, uint8_t* destination)
+{
+	// Nothing pending
+	if(codec->run == 0)
+		return 0;
+	// Run record, repeats of the previous sample
+	destination[0] = EPOCH_CODEC_RUN | (codec->run - 1);
+	codec->run = 0;
+	return 1;
+}
+
+bool EpochCodecDecode(EpochCodec_t* codec, const uint8_t** source, const uint8_t* end, uint8_t* sample)
+{
+	uint8_t control;
+	int32_t value;
+	uint32_t energy;
+	// Remaining repeats of a run already read
+	if(codec->run > 0)
+	{
+		codec->run--;
+		memcpy(sample, codec->prev, EPOCH_CODEC_SAMPLE_LEN);
+		return true;
+	}
+	// Read the control byte, padding is skipped, unused bits are invalid (erased 0xFF included)
+	do {
+		if(*source >= end)
+			return false;
+		control = *(*source)++;
+	} while(control == EPOCH_CODEC_PAD);
+	if(control & EPOCH_CODEC_RUN)
+	{
+		if(control == 0xFF)
+			return false;
+		codec->run = control & ~EPOCH_CODEC_RUN;
+		memcpy(sample, codec->prev, EPOCH_CODEC_SAMPLE_LEN);
+		return true;
+	}
+	if(control & ~(EPOCH_CODEC_BATT | EPOCH_CODEC_TEMP | EPOCH_CODEC_ACCEL | EPOCH_CODEC_STEPS | EPOCH_CODEC_ENERGY))
+		return false;
+	// Apply the changed fields to the previous sample
+	memcpy(sample, codec->prev, EPOCH_CODEC_SAMPLE_LEN);
+	if(control & EPOCH_CODEC_BATT)
+	{
+		if(!EpochCodecGetVarint(source, end, &value)) return false;
+		sample[SAMPLE_BATT] += (uint8_t)value;
+	}
+	if(control & EPOCH_CODEC_TEMP)
+	{
+		if(!EpochCodecGetVarint(source, end, &value)) return false;
+		sample[SAMPLE_TEMP] += (uint8_t)value;
+	}
+	if(control & (EPOCH_CODEC_ACCEL | EPOCH_CODEC_STEPS))
+	{
+		if((end - *source) < (((control & EPOCH_CODEC_ACCEL) ? 1 : 0) + ((control & EPOCH_CODEC_STEPS) ? 1 : 0)))
+			return false;
+		if(control & EPOCH_CODEC_ACCEL)	sample[SAMPLE_ACCEL] = *(*source)++;
+		if(control & EPOCH_CODEC_STEPS)	sample[SAMPLE_STEPS] = *(*source)++;
+	}
+	if(control & EPOCH_CODEC_ENERGY)
+	{
+		if(!EpochCodecGetVarint(source, end, &value)) return false;
+		energy = EpochCodecEnergy(codec->prev) + (uint32_t)value;
+		sample[SAMPLE_ENERGY + 0] = (uint8_t)(energy);
+		sample[SAMPLE_ENERGY + 1] = (uint8_t)(energy >> 8);
+		sample[SAMPLE_ENERGY + 2] = (uint8_t)(energy >> 16);
+		sample[SAMPLE_ENERGY + 3] = (uint8_t)(energy >> 24);
+	}
+	memcpy(codec->prev, sample, EPOCH_CODEC_SAMPLE_LEN);
+	return true;
+}
+
+// Zigzag then little endian base 128, 7 bits per byte with the top bit set on all but the last byte
+static uint8_t EpochCodecPutVarint(uint8_t* destination, int32_t value)
+{
+	uint32_t zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+	uint8_t length = 0;
+	while(zigzag >= 0x80)
+	{
+		destination[length++] = (uint8_t)(zigzag | 0x80);
+		zigzag >>= 7;
+	}
+	destination[length++] = (uint8_t)zigzag;
+	return length;
+}
+
+static bool EpochCodecGetVarint(const uint8_t** source, const uint8_t* end, int32_t* value)
+{
+	uint32_t zigzag = 0;
+	uint8_t shift;
+	// At most 5 bytes for 32 bits
+	for(shift = 0; shift < 35; shift += 7)
+	{
+		if(*source >= end)
+			return false;
+		zigzag |= (uint32_t)(**source & 0x7F) << shift;
+		if((*(*source)++ & 0x80) == 0)
+		{
+			*value = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+			return true;
+		}
+	}
+	return false;
+}
+
+// Energy sum is stored little endian, not aligned
+static uint32_t EpochCodecEnergy(const uint8_t* sample)
+{
+	return	((uint32_t)sample[SAMPLE_ENERGY + 0]) |
+			((uint32_t)sample[SAMPLE_ENERGY + 1] << 8) |
+			((uint32_t)sample[SAMPLE_ENERGY + 2] << 16) |
+			((uint32_t)sample[SAMPLE_ENERGY + 3] << 24);
+}
+//EOF
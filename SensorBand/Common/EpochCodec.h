@@ -0,0 +1,45 @@
+// Packed epoch sample encoding for transfer, delta/zigzag/varint per field with runs of repeated samples
+#ifndef _EPOCH_CODEC_H_
+#define _EPOCH_CODEC_H_
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+
+// Definitions
+// Samples are the 8 byte Epoch_sample_t: batt, temp, accel, steps, epoch[4] (little endian energy)
+#define EPOCH_CODEC_SAMPLE_LEN		8
+// Record control byte, first byte of every record
+#define EPOCH_CODEC_RUN				0x80	// Run of repeated samples, low 7 bits are the count - 1
+#define EPOCH_CODEC_RUN_MAX			127		// Longest run, a control byte of 0xFF is never written
+#define EPOCH_CODEC_BATT			0x01	// Battery changed, zigzag varint delta follows
+#define EPOCH_CODEC_TEMP			0x02	// Temperature changed, zigzag varint delta follows
+#define EPOCH_CODEC_ACCEL			0x04	// Orientation changed, raw byte follows
+#define EPOCH_CODEC_STEPS			0x08	// Steps changed, raw byte follows
+#define EPOCH_CODEC_ENERGY			0x10	// Energy changed, zigzag varint delta (32 bit, wrapping) follows
+#define EPOCH_CODEC_PAD				0x20	// Padding to a flash word boundary, skipped (stored records only, no sample)
+// Longest single record (control, 2 + 2 varint, 2 raw, 5 varint) - worst case is longer than the raw sample
+#define EPOCH_CODEC_RECORD_MAX		12
+// Longest encoding of a number of samples
+#define EPOCH_CODEC_MAX_LEN(_n)		((_n) * EPOCH_CODEC_RECORD_MAX)
+
+// Types
+// Encoder and decoder state, the previous sample starts as all zero
+typedef struct {
+	uint8_t prev[EPOCH_CODEC_SAMPLE_LEN];	// Previous sample
+	uint8_t run;							// Encoder, repeats not yet written. Decoder, repeats not yet read
+} EpochCodec_t;
+
+// Functions
+// Clear the state at the start of each block
+void EpochCodecInit(EpochCodec_t* codec);
+// Add a sample, returns the length written to the destination (zero while a run is counted)
+uint8_t EpochCodecEncode(EpochCodec_t* codec, const uint8_t* sample, uint8_t* destination);
+// Add a sample as a single record, repeats are not counted as runs (records are complete as written, e.g. to flash)
+uint8_t EpochCodecRecord(EpochCodec_t* codec, const uint8_t* sample, uint8_t* destination);
+// Write any pending run after the last sample, returns the length written
+uint8_t EpochCodecFlush(EpochCodec_t* codec, uint8_t* destination);
+// Decode the next sample, advances the source pointer - returns false if the source is too short or invalid
+bool EpochCodecDecode(EpochCodec_t* codec, const uint8_t** source, const uint8_t* end, uint8_t* sample);
+
+#endif
+//EOF
@@ -0,0 +1,502 @@
+// Compact epoch store, stored epoch blocks are summed into coarse bins in a separate NVM region
+// Compaction follows just behind the logger in the background, so the bins are written long before the
+// epoch blocks are overwritten. Blocks are append only, pages are erased ahead when the ring enters them
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stddef.h>
+#include "nordic_common.h"
+#include "app_error.h"
+#include "pstorage.h"
+#include "Crc16.h"
+#include "EpochCompact.h"
+
+// Definitions
+#define COMPACT_PAGE_BLOCKS			(PSTORAGE_FLASH_PAGE_SIZE / EPOCH_COMPACT_BLOCK_SIZE)	// Blocks per flash page, erased together
+#define COMPACT_OPEN_START			offsetof(EpochBlockInfo_t, time_stamp)					// Header written when a block is opened
+#define COMPACT_OPEN_END			offsetof(EpochCompactBlock_t, sourceLast)
+#define COMPACT_CLOSE_WORD			offsetof(EpochCompactBlock_t, sourceLast)				// Header word written when a block is closed, before the first word
+#define COMPACT_FORMAT				(BLOCK_FORMAT_EPOCH_COMPACT | BLOCK_FORMAT_CHECK_CRC16)
+#define COMPACT_MARKER				0x0000													// Header reserved word of a clear marker block
+#define COMPACT_RETRY_MAX			3														// Failed writes or erases in a row before a fault
+
+// Clear states, the marker is written in steps when the NVM is idle
+#define COMPACT_CLEAR_NONE			0
+#define COMPACT_CLEAR_PENDING		1	// Close the open block and open the marker
+#define COMPACT_CLEAR_MARKER		2	// Close the marker
+
+// Types
+// Block header up to the check, the reserved bytes after it are erased
+typedef struct {
+	EpochBlockInfo_t info;
+	uint16_t blockFormat;
+	uint16_t blockEpochPeriod;
+	uint16_t sourceFirst;
+	uint16_t reserved1;
+	uint16_t sourceLast;
+	uint16_t check;
+} CompactHeader_t;
+
+// Globals
+static pstorage_handle_t	compact_pstorage_handle;					// Persistent storage handle for the compact blocks
+static uint16_t				compactIndex = EPOCH_COMPACT_BLOCK_COUNT;	// Position of the open or next compact block, invalid until initialised
+static uint16_t				compactNumber;								// Block number of the open or next compact block
+static uint16_t				compactBins;								// Bins written to the open block
+static bool					compactOpen;								// The block at the index is open
+static uint32_t				compactBase;								// Bin number of bin 0 in the open block
+static uint32_t				compactLast;								// Bin number of the last bin written
+static uint16_t				compactSourceLast;							// Epoch block number of the last bin written
+static uint32_t				compactResume;								// Epochs before this time were compacted before a reset
+static uint8_t				compactClear = COMPACT_CLEAR_NONE;			// Clear marker state
+static uint16_t				compactClearNumber = EPOCH_BLOCK_INDEX_INVALID;	// Block number of the newest clear marker, invalid once overwritten
+static struct {
+	uint16_t index;
+	uint16_t block_number;
+	uint16_t sample;
+	uint16_t count;
+	uint32_t time;
+	uint32_t period;
+	bool loaded;
+} compactSource;														// Next epoch to compact
+static struct {
+	uint32_t number;
+	uint16_t source;
+	EpochCompactBin_t totals;
+} compactAdd;															// Bin being summed, written when an epoch is in a later bin
+static uint32_t				compactOpenStage[(COMPACT_OPEN_END - COMPACT_OPEN_START) / sizeof(uint32_t)];
+static uint32_t				compactCloseStage[2];
+static EpochCompactBin_t	compactBinStage;
+static uint8_t				compactRetries;								// Failed NVM operations in a row
+
+// Prototypes
+static bool EpochCompactSourceReady(void);
+static bool EpochCompactWriteBin(void);
+static bool EpochCompactOpen(uint32_t base, uint16_t source, uint16_t reserved);
+static void EpochCompactClose(void);
+static bool EpochCompactWrite(uint16_t index, const void* source, uint16_t offset, uint16_t length);
+static bool EpochCompactErased(uint16_t index);
+static const EpochCompactBlock_t* EpochCompactBlockAddress(uint16_t index);
+static void EpochCompactSourceStart(uint16_t index);
+static void CompactPstorageEventHandler(pstorage_handle_t * p_handle, uint8_t op_code, uint32_t result, uint8_t* p_data, uint32_t data_len);
+
+// Source
+bool EpochCompactInit(void)
+{
+	pstorage_module_param_t param;
+	pstorage_handle_t block_handle;
+	const EpochCompactBlock_t* block;
+	uint16_t index, head;
+	bool updated;
+
+	// Verify the block is the expected size - should be 512 bytes
+	if(sizeof(EpochCompactBlock_t) != EPOCH_COMPACT_BLOCK_SIZE)
+		return false;
+
+	// Register with the pstorage module, follows the epoch data pages
+	param.block_size  = EPOCH_COMPACT_BLOCK_SIZE;
+	param.block_count = EPOCH_COMPACT_BLOCK_COUNT;
+	param.cb		  = CompactPstorageEventHandler;
+	if(pstorage_register(&param, &compact_pstorage_handle) != NRF_SUCCESS)
+		return false;
+
+	// Epoch blocks of the layout before 2.0 are left in the region, it is erased and compaction starts again
+	updated = AccelEpochLayoutUpdated();
+	if(updated)
+	{
+		block_handle.module_id = compact_pstorage_handle.module_id;
+		if(	(pstorage_block_identifier_get(&compact_pstorage_handle, 0, &block_handle) != NRF_SUCCESS) ||
+			(pstorage_clear(&block_handle, EPOCH_COMPACT_NVM_SIZE) != NRF_SUCCESS) )
+			return false;
+	}
+
+	// Newest closed block and clear marker, there are few enough to read them all
+	head = EPOCH_COMPACT_BLOCK_COUNT;
+	compactClearNumber = EPOCH_BLOCK_INDEX_INVALID;
+	for(index = 0; (index < EPOCH_COMPACT_BLOCK_COUNT) && !updated; index++)
+	{
+		block = EpochCompactBlockAddress(index);
+		if(	(block->info.block_number > EPOCH_BLOCK_NUMBER_LAST) ||
+			(block->blockFormat != COMPACT_FORMAT) ||
+			(block->check != Crc16Ccitt(((const uint8_t*)block) + sizeof(CompactHeader_t), EPOCH_COMPACT_BLOCK_SIZE - sizeof(CompactHeader_t),
+				Crc16Ccitt(block, offsetof(CompactHeader_t, check), CRC16_CCITT_INIT))) )
+			continue;
+		if((block->reserved1 == COMPACT_MARKER) &&
+			((compactClearNumber > EPOCH_BLOCK_NUMBER_LAST) || ((uint16_t)(block->info.block_number - compactClearNumber) < 0x8000)))
+			compactClearNumber = block->info.block_number;
+		if((head >= EPOCH_COMPACT_BLOCK_COUNT) || ((uint16_t)(block->info.block_number - compactNumber) < 0x8000))
+		{
+			head = index;
+			compactNumber = block->info.block_number;
+		}
+	}
+
+	// The next block follows the newest, carry on after its last bin
+	compactOpen = false;
+	compactBins = 0;
+	compactResume = 0;
+	compactClear = COMPACT_CLEAR_NONE;
+	compactAdd.totals.epochs = 0;
+	if(head < EPOCH_COMPACT_BLOCK_COUNT)
+	{
+		block = EpochCompactBlockAddress(head);
+		if(block->info.data_length > 0)
+			compactResume = (((block->info.time_stamp / EPOCH_COMPACT_PERIOD) + block->bins[block->info.data_length - 1].bin) + 1) * EPOCH_COMPACT_PERIOD;
+		compactIndex = (head + 1) % EPOCH_COMPACT_BLOCK_COUNT;
+		compactNumber = (compactNumber >= EPOCH_BLOCK_NUMBER_LAST) ? 0 : compactNumber + 1;
+	}
+	else
+	{
+		compactIndex = 0;
+		compactNumber = 0;
+	}
+
+	// A block left open by a reset is continued, its bins are complete as written
+	block = EpochCompactBlockAddress(compactIndex);
+	if(	!updated && (*(const uint32_t*)&block->info == 0xFFFFFFFF) &&
+		(block->blockFormat == COMPACT_FORMAT) &&
+		(block->blockEpochPeriod == EPOCH_COMPACT_PERIOD) )
+	{
+		static const EpochCompactBin_t erased = {0xFFFF, 0xFFFF, 0xFFFFFFFF, 0xFFFF, -1, -1};
+		compactOpen = true;
+		// A marker left open by a reset is closed before anything else
+		if(block->reserved1 == COMPACT_MARKER)
+			compactClear = COMPACT_CLEAR_MARKER;
+		compactBase = block->info.time_stamp / EPOCH_COMPACT_PERIOD;
+		compactSourceLast = EPOCH_BLOCK_INDEX_INVALID;
+		while((compactBins < EPOCH_COMPACT_BLOCK_BINS) && (memcmp(&block->bins[compactBins], &erased, sizeof(EpochCompactBin_t)) != 0))
+			compactBins++;
+		if(compactBins > 0)
+		{
+			compactLast = compactBase + block->bins[compactBins - 1].bin;
+			compactResume = (compactLast + 1) * EPOCH_COMPACT_PERIOD;
+		}
+		else
+			compactLast = compactBase;
+	}
+	// Otherwise it is only written to erased flash, a block part way through a page that is not erased is skipped
+	else if(((compactIndex % COMPACT_PAGE_BLOCKS) != 0) && !EpochCompactErased(compactIndex))
+	{
+		compactIndex = (compactIndex - (compactIndex % COMPACT_PAGE_BLOCKS) + COMPACT_PAGE_BLOCKS) % EPOCH_COMPACT_BLOCK_COUNT;
+	}
+
+	// Start at the epoch block after the last compacted time, or the oldest stored block
+	if(compactResume != 0)
+		index = AccelEpochBlockFindTime(compactResume);
+	else
+		index = AccelEpochBlockFind(activeEpochBlock.info.block_number - (EPOCH_NVM_BLOCK_COUNT - 1));
+	if(index >= EPOCH_NVM_BLOCK_COUNT)
+		index = activeIndex;
+	EpochCompactSourceStart(index);
+	return true;
+}
+
+void EpochCompactTasks(void)
+{
+	Epoch_sample_t sample;
+	uint32_t pending, time, number, energy;
+	uint16_t epochs;
+
+	// Only when the NVM is idle, the writes of a step always fit in the queue and the stage buffers are free
+	if((compactIndex >= EPOCH_COMPACT_BLOCK_COUNT) || (activeIndex >= EPOCH_NVM_BLOCK_COUNT))
+		return;
+	if((pstorage_access_status_get(&pending) != NRF_SUCCESS) || (pending != 0))
+		return;
+
+	// Clear, close the open block, then write an empty marker block and close it
+	if(compactClear != COMPACT_CLEAR_NONE)
+	{
+		if(compactOpen)
+		{
+			if(compactClear == COMPACT_CLEAR_MARKER)
+			{
+				compactClearNumber = compactNumber;
+				compactClear = COMPACT_CLEAR_NONE;
+			}
+			EpochCompactClose();
+		}
+		else if(EpochCompactOpen(0, EPOCH_BLOCK_INDEX_INVALID, COMPACT_MARKER))
+		{
+			compactSourceLast = EPOCH_BLOCK_INDEX_INVALID;
+			compactClear = COMPACT_CLEAR_MARKER;
+		}
+		return;
+	}
+
+	// A full block is closed once its bins are in the NVM
+	if(compactOpen && (compactBins >= EPOCH_COMPACT_BLOCK_BINS))
+	{
+		EpochCompactClose();
+		return;
+	}
+
+	// Sum a few stored epochs into the bin
+	for(epochs = 0; (epochs < EPOCH_COMPACT_STEP_EPOCHS) && EpochCompactSourceReady(); epochs++)
+	{
+		time = compactSource.time + (compactSource.sample * compactSource.period);
+		number = time / EPOCH_COMPACT_PERIOD;
+		// Already compacted before a reset
+		if(time < compactResume)
+		{
+			compactSource.sample++;
+			continue;
+		}
+		compactResume = 0;
+		// An epoch in a later bin completes the bin, write it and carry on at this epoch in the next step
+		if((compactAdd.totals.epochs != 0) && (number != compactAdd.number))
+		{
+			EpochCompactWriteBin();
+			return;
+		}
+		if(!AccelEpochSampleRead(&sample, compactSource.sample, 1, compactSource.index))
+		{
+			// Unreadable, skip the rest of the block
+			compactSource.sample = compactSource.count;
+			continue;
+		}
+		// First epoch of the bin
+		if(compactAdd.totals.epochs == 0)
+		{
+			memset(&compactAdd.totals, 0, sizeof(EpochCompactBin_t));
+			compactAdd.number = number;
+			compactAdd.source = compactSource.block_number;
+		}
+		// Energy is stored little endian, not aligned. Steps have two more bits in the top of the orientation
+		energy =	((uint32_t)(uint8_t)sample.part.epoch[0]) | ((uint32_t)(uint8_t)sample.part.epoch[1] << 8) |
+					((uint32_t)(uint8_t)sample.part.epoch[2] << 16) | ((uint32_t)(uint8_t)sample.part.epoch[3] << 24);
+		compactAdd.totals.steps += (uint8_t)sample.part.steps | (((uint16_t)(uint8_t)sample.part.accel & 0xC0) << 2);
+		compactAdd.totals.energy += energy;
+		compactAdd.totals.epochs++;
+		compactAdd.totals.batt = sample.part.batt;
+		compactAdd.totals.temp = sample.part.temp;
+		compactSourceLast = compactSource.block_number;
+		compactSource.sample++;
+	}
+}
+
+const EpochCompactBlock_t* EpochCompactBlockPointer(uint16_t index)
+{
+	const EpochCompactBlock_t* block = EpochCompactBlockAddress(index);
+	// Closed blocks numbered before the clear marker read as cleared
+	if(	(block != NULL) && (compactClearNumber <= EPOCH_BLOCK_NUMBER_LAST) &&
+		(block->info.block_number <= EPOCH_BLOCK_NUMBER_LAST) &&
+		((int16_t)(block->info.block_number - compactClearNumber) < 0) )
+		return NULL;
+	return block;
+}
+
+bool EpochCompactClearAll(void)
+{
+	// Nothing is erased, the marker is written in the background and hides the older blocks until the ring overwrites them
+	if(compactIndex >= EPOCH_COMPACT_BLOCK_COUNT)
+	{
+		app_error_fault_handler(0xC0C0C0C0 + __LINE__, 0, (uint32_t)NULL);
+		return false;
+	}
+	// A marker already being written still covers every older block
+	if(compactClear == COMPACT_CLEAR_NONE)
+		compactClear = COMPACT_CLEAR_PENDING;
+	// The bin being summed is dropped, start again with the epoch blocks from the active block
+	compactResume = 0;
+	compactAdd.totals.epochs = 0;
+	EpochCompactSourceStart(activeIndex);
+	return true;
+}
+
+static void EpochCompactSourceStart(uint16_t index)
+{
+	compactSource.index = index;
+	compactSource.block_number = (index == activeIndex) ? activeEpochBlock.info.block_number : AccelEpochBlockNumber(index);
+	compactSource.sample = 0;
+	compactSource.loaded = false;
+}
+
+// Move the source on to the next stored epoch, false if there are none yet
+static bool EpochCompactSourceReady(void)
+{
+	uint32_t end;
+	for(;;)
+	{
+		// The active block is compacted after it is stored
+		if(compactSource.index == activeIndex)
+		{
+			// Stored (or left by an erase) since, carry on from it or the first block after it
+			if(compactSource.block_number != activeEpochBlock.info.block_number)
+				EpochCompactSourceStart(AccelEpochBlockFind(compactSource.block_number));
+			return false;
+		}
+		// Overwritten or erased, carry on from the oldest stored block after it
+		if(AccelEpochBlockNumber(compactSource.index) != compactSource.block_number)
+		{
+			EpochCompactSourceStart(AccelEpochBlockFind(compactSource.block_number));
+			continue;
+		}
+		// Epoch times from the block header
+		if(!compactSource.loaded)
+		{
+			compactSource.count = AccelEpochBlockSamples(compactSource.index);
+			if(!AccelEpochBlockTimes(compactSource.index, &compactSource.time, &end))
+				compactSource.count = 0;
+			compactSource.period = (compactSource.count > 0) ? ((end - compactSource.time) / compactSource.count) : 0;
+			compactSource.loaded = true;
+		}
+		if(compactSource.sample < compactSource.count)
+			return true;
+		// Next block in the ring
+		compactSource.index = (compactSource.index + 1) % EPOCH_NVM_BLOCK_COUNT;
+		compactSource.block_number = (compactSource.block_number >= EPOCH_BLOCK_NUMBER_LAST) ? 0 : compactSource.block_number + 1;
+		compactSource.sample = 0;
+		compactSource.loaded = false;
+	}
+}
+
+// Write the summed bin to the open block, opening a block first if needed
+static bool EpochCompactWriteBin(void)
+{
+	// Bins are in time order within a block, a clock change or a long gap closes the block
+	if(compactOpen && ((compactAdd.number <= compactLast) || ((compactAdd.number - compactBase) > 0xFFFF)))
+	{
+		EpochCompactClose();
+		return false;
+	}
+	// Open the next block
+	if(!compactOpen && !EpochCompactOpen(compactAdd.number, compactAdd.source, 0xFFFF))
+		return false;
+	// Add the bin
+	memcpy(&compactBinStage, &compactAdd.totals, sizeof(EpochCompactBin_t));
+	compactBinStage.bin = (uint16_t)(compactAdd.number - compactBase);
+	if(!EpochCompactWrite(compactIndex, &compactBinStage, offsetof(EpochCompactBlock_t, bins) + (compactBins * sizeof(EpochCompactBin_t)), sizeof(EpochCompactBin_t)))
+		return false;
+	compactBins++;
+	compactLast = compactAdd.number;
+	compactAdd.totals.epochs = 0;
+	return true;
+}
+
+// Open the next block, the page is erased when the ring enters it (the oldest blocks)
+static bool EpochCompactOpen(uint32_t base, uint16_t source, uint16_t reserved)
+{
+	CompactHeader_t header;
+	if((compactIndex % COMPACT_PAGE_BLOCKS) == 0)
+	{
+		pstorage_handle_t block_handle;
+		block_handle.module_id = compact_pstorage_handle.module_id;
+		if(	(pstorage_block_identifier_get(&compact_pstorage_handle, compactIndex, &block_handle) != NRF_SUCCESS) ||
+			(pstorage_clear(&block_handle, PSTORAGE_FLASH_PAGE_SIZE) != NRF_SUCCESS) )
+		{
+			app_error_fault_handler(0xC0C0C0C0 + __LINE__, 0, (uint32_t)NULL);
+			return false;
+		}
+	}
+	compactBase = base;
+	header.info.time_stamp = compactBase * EPOCH_COMPACT_PERIOD;
+	header.blockFormat = COMPACT_FORMAT;
+	header.blockEpochPeriod = EPOCH_COMPACT_PERIOD;
+	header.sourceFirst = source;
+	header.reserved1 = reserved;
+	memcpy(compactOpenStage, ((uint8_t*)&header) + COMPACT_OPEN_START, sizeof(compactOpenStage));
+	if(!EpochCompactWrite(compactIndex, compactOpenStage, COMPACT_OPEN_START, sizeof(compactOpenStage)))
+		return false;
+	compactOpen = true;
+	compactBins = 0;
+	return true;
+}
+
+// Complete the open block, its bins must be in the NVM
+static void EpochCompactClose(void)
+{
+	const EpochCompactBlock_t* block = EpochCompactBlockAddress(compactIndex);
+	CompactHeader_t header;
+	// Header as it will be, the check covers the written bins
+	memcpy(&header, block, sizeof(CompactHeader_t));
+	header.info.block_number = compactNumber;
+	header.info.data_length = compactBins;
+	header.sourceLast = compactSourceLast;
+	header.check = Crc16Ccitt(((const uint8_t*)block) + sizeof(CompactHeader_t), EPOCH_COMPACT_BLOCK_SIZE - sizeof(CompactHeader_t),
+		Crc16Ccitt(&header, offsetof(CompactHeader_t, check), CRC16_CCITT_INIT));
+	// The check word, then the first word completes the block
+	memcpy(&compactCloseStage[0], ((uint8_t*)&header) + COMPACT_CLOSE_WORD, sizeof(uint32_t));
+	memcpy(&compactCloseStage[1], &header.info, sizeof(uint32_t));
+	EpochCompactWrite(compactIndex, &compactCloseStage[0], COMPACT_CLOSE_WORD, sizeof(uint32_t));
+	EpochCompactWrite(compactIndex, &compactCloseStage[1], 0, sizeof(uint32_t));
+	// Next block
+	compactOpen = false;
+	compactBins = 0;
+	compactIndex = (compactIndex + 1) % EPOCH_COMPACT_BLOCK_COUNT;
+	compactNumber = (compactNumber >= EPOCH_BLOCK_NUMBER_LAST) ? 0 : compactNumber + 1;
+	// The marker is dropped once the ring has passed it, every older block is overwritten
+	if((compactClearNumber <= EPOCH_BLOCK_NUMBER_LAST) && ((uint16_t)(compactNumber - compactClearNumber) >= EPOCH_COMPACT_BLOCK_COUNT))
+		compactClearNumber = EPOCH_BLOCK_INDEX_INVALID;
+}
+
+static bool EpochCompactWrite(uint16_t index, const void* source, uint16_t offset, uint16_t length)
+{
+	pstorage_handle_t block_handle;
+	// Word aligned write into erased flash, the source must not change until written
+	block_handle.module_id = compact_pstorage_handle.module_id;
+	if(	(pstorage_block_identifier_get(&compact_pstorage_handle, index, &block_handle) != NRF_SUCCESS) ||
+		(pstorage_store(&block_handle, (uint8_t*)source, length, offset) != NRF_SUCCESS) )
+	{
+		app_error_fault_handler(0xC0C0C0C0 + __LINE__, 0, (uint32_t)NULL);
+		return false;
+	}
+	return true;
+}
+
+static const EpochCompactBlock_t* EpochCompactBlockAddress(uint16_t index)
+{
+	pstorage_handle_t block_handle;
+	// The block identifier is the flash address
+	block_handle.module_id = compact_pstorage_handle.module_id;
+	if(	(index >= EPOCH_COMPACT_BLOCK_COUNT) ||
+		(pstorage_block_identifier_get(&compact_pstorage_handle, index, &block_handle) != NRF_SUCCESS) )
+		return NULL;
+	return (const EpochCompactBlock_t*)block_handle.block_id;
+}
+
+static bool EpochCompactErased(uint16_t index)
+{
+	const uint32_t* word = (const uint32_t*)EpochCompactBlockAddress(index);
+	uint32_t remaining;
+	// Every word must be erased
+	for(remaining = EPOCH_COMPACT_BLOCK_SIZE / sizeof(uint32_t); remaining > 0; remaining--)
+	{
+		if(*word++ != 0xFFFFFFFF)
+			return false;
+	}
+	return true;
+}
+
+// Called from the pstorage background module on events
+static void CompactPstorageEventHandler(pstorage_handle_t * p_handle, uint8_t op_code, uint32_t result, uint8_t* p_data, uint32_t data_len)
+{
+	pstorage_handle_t block_handle;
+	const uint32_t* word;
+	uint32_t remaining;
+	// Writes complete in order, the next step waits for the queue to empty (including a retry queued here)
+	if(result == NRF_SUCCESS)
+	{
+		compactRetries = 0;
+		return;
+	}
+	if(++compactRetries <= COMPACT_RETRY_MAX)
+	{
+		// The identifier is the flash address of the operation, the stage is unchanged until the queue is empty
+		memcpy(&block_handle, p_handle, sizeof(pstorage_handle_t));
+		if(	(op_code == PSTORAGE_CLEAR_OP_CODE) &&
+			(pstorage_clear(&block_handle, PSTORAGE_FLASH_PAGE_SIZE) == NRF_SUCCESS) )
+			return;
+		// A write is only run again if none of it reached the flash
+		if(op_code == PSTORAGE_STORE_OP_CODE)
+		{
+			word = (const uint32_t*)p_handle->block_id;
+			for(remaining = data_len / sizeof(uint32_t); (remaining > 0) && (*word == 0xFFFFFFFF); remaining--)
+				word++;
+			if((remaining == 0) && (pstorage_store(&block_handle, p_data, data_len, 0) == NRF_SUCCESS))
+				return;
+		}
+	}
+	// Restart, the part written block's page is skipped and compaction resumes after the last closed block
+	app_error_fault_handler(0xC0C0C0C0 + __LINE__, 0, (uint32_t)NULL);
+}
+//EOF
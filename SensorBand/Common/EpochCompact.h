@@ -0,0 +1,55 @@
+// Compact epoch store, stored epoch blocks are summed into coarse bins in a separate NVM region
+// The bins outlast the full resolution blocks, which are overwritten as the epoch ring wraps
+#ifndef _EPOCH_COMPACT_H_
+#define _EPOCH_COMPACT_H_
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+#include "acc_tasks.h"
+#include "Config.h"
+
+// Definitions
+#ifndef EPOCH_COMPACT_STEP_EPOCHS
+#define EPOCH_COMPACT_STEP_EPOCHS	64				// Most epochs read in each background step
+#endif
+
+#define EPOCH_COMPACT_BLOCK_SIZE	(512ul)												// Size of a compact block
+#define EPOCH_COMPACT_BLOCK_COUNT	(EPOCH_COMPACT_NVM_SIZE / EPOCH_COMPACT_BLOCK_SIZE)	// Number of compact blocks in the NVM
+#define EPOCH_COMPACT_BLOCK_BINS	40													// Bins in a compact block
+
+// Types
+// Totals of the epochs starting within a bin
+typedef struct EpochCompactBin_tag {
+	uint16_t bin;			// Bins after the block time stamp
+	uint16_t steps;			// Total steps
+	uint32_t energy;		// Sum of the epoch energy
+	uint16_t epochs;		// Epochs in the bin
+	int8_t batt;			// Battery of the last epoch
+	int8_t temp;			// Temperature of the last epoch
+} EpochCompactBin_t;
+
+// Compact block, bins are written as they complete and the first word last (erased while the block is open)
+typedef struct EpochCompactBlock_tag {
+	EpochBlockInfo_t info;		// Compact block number, bin count and the start time of bin 0
+	uint16_t blockFormat;		// BLOCK_FORMAT_EPOCH_COMPACT | BLOCK_FORMAT_CHECK_CRC16
+	uint16_t blockEpochPeriod;	// Bin period
+	uint16_t sourceFirst;		// Epoch block number of the first bin
+	uint16_t reserved1;		// Zero in a clear marker block, blocks numbered before it were cleared
+	uint16_t sourceLast;		// Epoch block number of the last bin (invalid if the block was open at a reset)
+	uint16_t check;				// CRC-16/CCITT of the block without the check (bytes 0-17, 20-511)
+	uint8_t reserved2[12];
+	EpochCompactBin_t bins[EPOCH_COMPACT_BLOCK_BINS];
+} EpochCompactBlock_t;
+
+// Functions
+// Register the NVM region (after the epoch logger is initialised) and find the compaction position
+bool EpochCompactInit(void);
+// Background step, call when idle - sums a few epochs and writes at most one bin
+void EpochCompactTasks(void);
+// Compact block in memory mapped NVM, NULL if invalid or cleared
+const EpochCompactBlock_t* EpochCompactBlockPointer(uint16_t index);
+// Logical clear, a marker block is written in the background and compaction starts again at the active epoch block
+bool EpochCompactClearAll(void);
+
+#endif
+//EOF
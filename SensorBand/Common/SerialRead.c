@@ -0,0 +1,289 @@
+// Epoch block read commands of the serial link: "R" hex, "RB" frames, "RM"/"RG" bursts, "RE" encoding and the "Q" query
+// Shared by serial_tasks() in main.c and the host link simulation, which sees the same command handling as the band
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include "nrf.h"
+#include "app_error.h"
+#include "pstorage.h"
+#include "ble_nus.h"
+#include "Config.h"
+#include "ble_serial.h"
+#include "acc_tasks.h"
+#include "AsciiHex.h"
+#include "EpochCodec.h"
+#include "SerialRead.h"
+
+// Definitions
+#define WRITE_SEGMENT_SIZE		(SERIAL_READ_BUFFER_LEN / 2)	// 512/32 = 16 segments of 64 bytes in read block sequence
+// Largest block frame payloads: index, block or index, block header, check, worst case packed samples
+#define BLOCK_FRAME_RAW_LEN		(sizeof(uint16_t) + EPOCH_NVM_BLOCK_SIZE)
+#define BLOCK_FRAME_PACKED_LEN	(sizeof(uint16_t) + offsetof(Epoch_block_t, epoch_data) + sizeof(uint16_t) + EPOCH_CODEC_MAX_LEN(EPOCH_BLOCK_DATA_COUNT))
+#define BLOCK_FRAME_MAX_LEN		((BLOCK_FRAME_PACKED_LEN > BLOCK_FRAME_RAW_LEN) ? BLOCK_FRAME_PACKED_LEN : BLOCK_FRAME_RAW_LEN)
+
+// Globals
+extern volatile uint32_t rtcEpochTriplicate[3];	// RTC time epoch, main.c
+
+// Prototypes
+static void SerialHexBlockSend(uint8_t* buffer);
+static void SerialReadIndexCheck(void);
+
+// Source
+uint16_t SerialReadCommand(uint8_t* buffer, uint16_t length)
+{
+	// Burst read command, "RM<index><count>", blocks are sent as frames while the client has credits
+	if((length > 1) && ((buffer[1] == 'M') || (buffer[1] == 'm')))
+	{
+		uint16_t index = status.epochReadIndex, count = EPOCH_NVM_BLOCK_COUNT;
+		// Read the optional start index and block count (hex, little endian)
+		if(length >= 6) ReadHexToBinary((uint8_t*)&index, &buffer[2], (2 * sizeof(uint16_t)));
+		if(length >= 10) ReadHexToBinary((uint8_t*)&count, &buffer[6], (2 * sizeof(uint16_t)));
+		// Fix block number if invalid or wrapped (set to start of NVM)
+		if(index >= EPOCH_NVM_BLOCK_COUNT)
+		{
+			index = activeIndex;
+			if(index != 0)
+				index--;
+		}
+		// Limit to one pass of the NVM. A count of zero stops a burst in progress
+		if(count > EPOCH_NVM_BLOCK_COUNT)
+			count = EPOCH_NVM_BLOCK_COUNT;
+		// Set the burst state and initial credits, blocks are added as the queue empties
+		status.burstIndex = index;
+		status.burstCount = count;
+		status.burstCredits = BURST_CREDITS_DEFAULT;
+		// Burst timing for measuring download changes on the bench
+		status.burstStartTicks = SYSTIME_RTC->COUNTER;
+		status.burstStartEvents = ble_serial_stats.radioEvents;
+		SerialBurstTasks();
+		return 0;
+	}
+	// Burst read credit command, "RG<credits>", client will accept more blocks
+	if((length > 1) && ((buffer[1] == 'G') || (buffer[1] == 'g')))
+	{
+		uint16_t credits = 0;
+		// Add the credits, saturate the count
+		if(ReadHexToBinary((uint8_t*)&credits, &buffer[2], (2 * sizeof(uint16_t))) > 0)
+		{
+			if(credits > (0xFFFF - status.burstCredits))
+				status.burstCredits = 0xFFFF;
+			else
+				status.burstCredits += credits;
+		}
+		SerialBurstTasks();
+		return 0;
+	}
+	// Transfer encoding command, "RE<encoding>", sets the frame format of "RB" and "RM" block reads
+	if((length > 1) && ((buffer[1] == 'E') || (buffer[1] == 'e')))
+	{
+		// Set if valid, 0 = raw, 1 = packed
+		if(length > 2)
+		{
+			uint8_t encoding = buffer[2] - '0';
+			if(encoding <= TRANSFER_ENCODING_PACKED)
+				status.transferEncoding = encoding;
+		}
+		return sprintf((char*)buffer, "RE:%u\r\n", status.transferEncoding);
+	}
+	// Binary read mode, block is sent as a frame: header, block index, raw block
+	if((length > 1) && ((buffer[1] == 'B') || (buffer[1] == 'b')))
+	{
+		SerialReadIndexCheck();
+		// Add the frame if there is room, increment the block index pointer on success
+		if(SerialBlockFrameSend(status.epochReadIndex, buffer, SERIAL_READ_BUFFER_LEN))
+		{
+			if(++status.epochReadIndex >= epockBlockCount)
+				status.epochReadIndex = 0;
+		}
+		// Binary frames are not terminated
+		return 0;
+	}
+	// Ascii hex block read
+	SerialHexBlockSend(buffer);
+	return 0;
+}
+
+uint16_t SerialReadQuery(uint8_t* buffer)
+{
+	// Logger query info string, one reply so it is all or nothing - 2x14 + 4x9 = 64 chars max, fits the buffer and control queue
+	return sprintf((char*)buffer, "T:%lu\r\nB:%u\r\nN:%u\r\nE:%lu\r\nC:%u\r\nI:%u\r\n",
+		(unsigned long)rtcEpochTriplicate[0],
+		(unsigned int)activeEpochBlock.info.block_number,
+		(unsigned int)activeEpochBlock.info.data_length,
+		(unsigned long)activeEpochBlock.info.time_stamp,
+		(unsigned int)epockBlockCount,
+		(unsigned int)(uint16_t)status.epochReadIndex);
+}
+
+bool SerialBlockFrameSend(uint16_t index, uint8_t* buffer, uint16_t bufferLen)
+{
+	uint16_t offset = 0;
+	const Epoch_block_t* block;
+	// Packed transfer encoding selected
+	if(status.transferEncoding == TRANSFER_ENCODING_PACKED)
+		return SerialPackedFrameSend(index, buffer, bufferLen);
+	// Stored blocks are sent directly from NVM without copying, if there is a free region
+	block = AccelEpochBlockPointer(index);
+	if((block != NULL) && (ble_serial_frame_region(BLE_FRAME_TYPE_EPOCH_BLOCK, &index, sizeof(uint16_t), (const uint8_t*)block, EPOCH_NVM_BLOCK_SIZE) != 0))
+		return true;
+	// Otherwise the block is copied through the queue
+	// Add the frame header and block index if the whole frame will fit
+	if(ble_serial_frame_header(BLE_FRAME_TYPE_EPOCH_BLOCK, sizeof(uint16_t) + EPOCH_NVM_BLOCK_SIZE) == 0)
+		return false;
+	ble_serial_out_push(&index, sizeof(uint16_t));
+	// Write out the raw block in short sections to the queue
+	while(offset < EPOCH_NVM_BLOCK_SIZE)
+	{
+		uint16_t toWrite = EPOCH_NVM_BLOCK_SIZE - offset;
+		if(toWrite > bufferLen)
+			toWrite = bufferLen;
+		// Early exit on read data fail
+		if( !AccelEpochBlockRead(buffer, offset, toWrite, index) )
+			break;
+		// Add the segment to the queue. Early exit if push fails to write all output
+		if( (ble_serial_out_push(buffer, toWrite)) != toWrite )
+			break;
+		// Increment the write offset
+		offset += toWrite;
+	}
+	// Check whole block was added
+	if(offset < EPOCH_NVM_BLOCK_SIZE)
+	{
+		// Adding data to queue failed. Frame is incomplete - error in debug
+#ifdef __DEBUG
+		app_error_fault_handler(0xDEADBEEF + __LINE__, 0, (uint32_t)NULL);
+#endif
+		return false;
+	}
+	return true;
+}
+
+// Encoded in a single pass
+bool SerialPackedFrameSend(uint16_t index, uint8_t* buffer, uint16_t bufferLen)
+{
+	BleFrameWriter_t frame;
+	EpochCodec_t codec;
+	Epoch_sample_t samples[8];
+	uint8_t record[EPOCH_CODEC_RECORD_MAX + 1];
+	uint16_t sample, count, toRead, i;
+	// Reserve the worst case frame length, the frame is not sent until it is complete
+	if(!ble_serial_frame_begin(&frame, BLE_FRAME_TYPE_PACKED_BLOCK, BLOCK_FRAME_PACKED_LEN))
+		return false;
+	ble_serial_frame_write(&frame, &index, sizeof(uint16_t));
+	// Block header and check as stored, the sample count is from the header
+	if(	!AccelEpochBlockRead(buffer, 0, offsetof(Epoch_block_t, epoch_data), index) ||
+		!AccelEpochBlockRead(&buffer[offsetof(Epoch_block_t, epoch_data)], offsetof(Epoch_block_t, check), sizeof(uint16_t), index) )
+		return false;
+	count = AccelEpochBlockSamples(index);
+	ble_serial_frame_write(&frame, buffer, offsetof(Epoch_block_t, epoch_data) + sizeof(uint16_t));
+	// Encode the samples straight into the frame, a few at a time (stored packed blocks are never longer re-encoded)
+	EpochCodecInit(&codec);
+	for(sample = 0; sample < count; sample += toRead)
+	{
+		toRead = sizeof(samples) / sizeof(Epoch_sample_t);
+		if(toRead > (count - sample))
+			toRead = count - sample;
+		if(!AccelEpochSampleRead(samples, sample, toRead, index))
+			return false;
+		for(i = 0; i < toRead; i++)
+			ble_serial_frame_write(&frame, record, EpochCodecEncode(&codec, samples[i].b, record));
+	}
+	ble_serial_frame_write(&frame, record, EpochCodecFlush(&codec, record));
+	// Send the completed frame
+	ble_serial_frame_end(&frame);
+	return true;
+}
+
+void SerialBurstTasks(void)
+{
+	uint8_t buffer[SERIAL_READ_BUFFER_LEN];
+	// Nothing to send or waiting for credits
+	if((status.burstCount == 0) || (status.burstCredits == 0))
+		return;
+	// Add whole frames while there is room, the last block also needs room for the end frame
+	while((status.burstCount > 0) && (status.burstCredits > 0))
+	{
+		if(QueueFree(&serial_out_queue) < (2 * BLE_FRAME_HEADER_LEN) + (2 * sizeof(uint16_t)) + (2 * sizeof(uint32_t)) + BLOCK_FRAME_MAX_LEN)
+			return;
+		// On read failure, the burst is ended early
+		if(!SerialBlockFrameSend(status.burstIndex, buffer, sizeof(buffer)))
+			break;
+		// Next block, wrapped at the end of the NVM
+		if(++status.burstIndex >= epockBlockCount)
+			status.burstIndex = 0;
+		status.burstCount--;
+		status.burstCredits--;
+	}
+	// Burst complete (or failed), add the end frame: next index, blocks not sent and the burst timing
+	if((status.burstCount == 0) || (status.burstCredits > 0))
+	{
+		struct {
+			uint16_t index;
+			uint16_t remaining;
+			uint32_t ticks;
+			uint32_t events;
+		} end = {	status.burstIndex, status.burstCount,
+					(SYSTIME_RTC->COUNTER - status.burstStartTicks) & 0x00FFFFFF,	// 24 bit counter
+					ble_serial_stats.radioEvents - status.burstStartEvents};
+		if(ble_serial_frame_header(BLE_FRAME_TYPE_BURST_END, sizeof(end)) != 0)
+			ble_serial_out_push(&end, sizeof(end));
+		// Next read continues after the burst
+		status.epochReadIndex = status.burstIndex;
+		status.burstCount = 0;
+	}
+}
+
+// Hex block read "R", the block is one line of bulk data
+static void SerialHexBlockSend(uint8_t* buffer)
+{
+	uint16_t index = 0;
+	// Check the queue has enough room to accommodate the full block
+	if(QueueFree(&serial_out_queue) < (2 + 2*EPOCH_NVM_BLOCK_SIZE))
+		return;
+	SerialReadIndexCheck();
+	// The hex block is one line of bulk data
+	ble_serial_out_boundary();
+	// Write out the encoded block in short sections to the queue
+	while(index < EPOCH_NVM_BLOCK_SIZE)
+	{
+		// Early exit on read data fail
+		if( !AccelEpochBlockRead((buffer + WRITE_SEGMENT_SIZE), index, WRITE_SEGMENT_SIZE, status.epochReadIndex) )
+			break;
+		// Encode into ascii hex in place. Early out if encoded is not expected length
+		if( (WriteBinaryToHex((char*)buffer, (buffer + WRITE_SEGMENT_SIZE), WRITE_SEGMENT_SIZE, false)) !=  (2 * WRITE_SEGMENT_SIZE) )
+			break;
+		// Add the segment to the queue. Early exit if push fails to write all output
+		if( (ble_serial_out_push(buffer, (2 * WRITE_SEGMENT_SIZE))) != (2 * WRITE_SEGMENT_SIZE) )
+			break;
+		// Increment the write offset
+		index += WRITE_SEGMENT_SIZE;
+	}
+	// Check whole block was added
+	if(index < EPOCH_NVM_BLOCK_SIZE)
+	{
+		// Adding data to queue failed. Not fully sent - error in debug, user read too fast
+#ifdef __DEBUG
+		app_error_fault_handler(0xDEADBEEF + __LINE__, 0, (uint32_t)NULL);
+#endif
+	}
+	// Increment the block index pointer on successful read
+	if(++status.epochReadIndex >= epockBlockCount)
+		status.epochReadIndex = 0;
+	// Terminate the line in the bulk data, not as a reply
+	ble_serial_out_push("\r\n", 2);
+}
+
+// Fix block number if invalid or wrapped (set to start of NVM)
+static void SerialReadIndexCheck(void)
+{
+	if(status.epochReadIndex >= EPOCH_NVM_BLOCK_COUNT)
+	{
+		status.epochReadIndex = activeIndex;
+		if(status.epochReadIndex != 0)
+			status.epochReadIndex--;
+	}
+}
+//EOF
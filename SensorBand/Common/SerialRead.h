@@ -0,0 +1,26 @@
+// Epoch block read commands of the serial link: "R" hex, "RB" frames, "RM"/"RG" bursts, "RE" encoding and the "Q" query
+// Shared by serial_tasks() in main.c and the host link simulation
+#ifndef _SERIAL_READ_H_
+#define _SERIAL_READ_H_
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+
+// Definitions
+#define SERIAL_READ_BUFFER_LEN		(64)	// Working buffer of the commands, as the serial command buffer (SERIAL_CMD_LEN)
+
+// Functions
+// Handle a block read command in the buffer ("R", "RB", "RM", "RG", "RE"), the buffer is then used for the reply
+// The buffer is at least SERIAL_READ_BUFFER_LEN + 1 bytes - returns the reply length, zero if there is no reply
+uint16_t SerialReadCommand(uint8_t* buffer, uint16_t length);
+// Logger query reply "Q" in the buffer (SERIAL_READ_BUFFER_LEN + 1 bytes) - returns the reply length
+uint16_t SerialReadQuery(uint8_t* buffer);
+// Add an epoch block to the out queue as a binary frame - returns false if there is no room or the read fails
+bool SerialBlockFrameSend(uint16_t index, uint8_t* buffer, uint16_t bufferLen);
+// Add an epoch block to the out queue as a packed frame - returns false if there is no room or the read fails
+bool SerialPackedFrameSend(uint16_t index, uint8_t* buffer, uint16_t bufferLen);
+// Burst read tasks, call as the out queue empties to add the next blocks while the client has credits
+void SerialBurstTasks(void);
+
+#endif
+//EOF
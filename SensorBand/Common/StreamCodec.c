@@ -0,0 +1,98 @@
+// Packed accelerometer stream encoding, a key sample then bit-packed deltas sized per batch
+// No hardware dependencies, the same source is used by the host decoder
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+#include "StreamCodec.h"
+
+// Source
+uint16_t StreamCodecEncode(uint8_t* destination, const int16_t* samples, uint8_t count)
+{
+	uint32_t largest[STREAM_CODEC_AXES] = {0};
+	uint32_t accumulator = 0;
+	uint16_t length = 0, index;
+	uint8_t axis, bits = 0, width[STREAM_CODEC_AXES];
+	// Nothing to encode
+	if(count == 0)
+		return 0;
+	// Key sample
+	for(axis = 0; axis < STREAM_CODEC_AXES; axis++)
+	{
+		destination[length++] = (uint8_t)samples[axis];
+		destination[length++] = (uint8_t)((uint16_t)samples[axis] >> 8);
+	}
+	// Largest zigzag delta of each axis sets the width
+	for(index = STREAM_CODEC_AXES; index < (count * STREAM_CODEC_AXES); index++)
+	{
+		int32_t delta = (int32_t)samples[index] - samples[index - STREAM_CODEC_AXES];
+		uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+		largest[index % STREAM_CODEC_AXES] |= zigzag;
+	}
+	for(axis = 0; axis < STREAM_CODEC_AXES; axis++)
+	{
+		width[axis] = 0;
+		while(largest[axis] >> width[axis])
+			width[axis]++;
+		destination[length++] = width[axis];
+	}
+	// Deltas, least significant bit first
+	for(index = STREAM_CODEC_AXES; index < (count * STREAM_CODEC_AXES); index++)
+	{
+		int32_t delta = (int32_t)samples[index] - samples[index - STREAM_CODEC_AXES];
+		uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+		accumulator |= zigzag << bits;
+		bits += width[index % STREAM_CODEC_AXES];
+		while(bits >= 8)
+		{
+			destination[length++] = (uint8_t)accumulator;
+			accumulator >>= 8;
+			bits -= 8;
+		}
+	}
+	// Last partial byte
+	if(bits > 0)
+		destination[length++] = (uint8_t)accumulator;
+	return length;
+}
+
+bool StreamCodecDecode(const uint8_t* source, uint16_t length, int16_t* samples, uint8_t count)
+{
+	uint32_t accumulator = 0;
+	uint16_t used = 0, index;
+	uint8_t axis, bits = 0;
+	const uint8_t* width;
+	// Key sample and widths
+	if((count == 0) || (length < (STREAM_CODEC_AXES * (sizeof(int16_t) + 1))))
+		return false;
+	for(axis = 0; axis < STREAM_CODEC_AXES; axis++)
+	{
+		samples[axis] = (int16_t)((uint16_t)source[used] | ((uint16_t)source[used + 1] << 8));
+		used += 2;
+	}
+	width = &source[used];
+	used += STREAM_CODEC_AXES;
+	for(axis = 0; axis < STREAM_CODEC_AXES; axis++)
+	{
+		if(width[axis] > STREAM_CODEC_WIDTH_MAX)
+			return false;
+	}
+	// Apply the deltas
+	for(index = STREAM_CODEC_AXES; index < (count * STREAM_CODEC_AXES); index++)
+	{
+		uint8_t w = width[index % STREAM_CODEC_AXES];
+		uint32_t zigzag;
+		while(bits < w)
+		{
+			if(used >= length)
+				return false;
+			accumulator |= (uint32_t)source[used++] << bits;
+			bits += 8;
+		}
+		zigzag = accumulator & ((1ul << w) - 1);
+		accumulator >>= w;
+		bits -= w;
+		samples[index] = (int16_t)(samples[index - STREAM_CODEC_AXES] + (int32_t)((zigzag >> 1) ^ -(int32_t)(zigzag & 1)));
+	}
+	return true;
+}
+//EOF
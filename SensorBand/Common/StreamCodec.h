@@ -0,0 +1,30 @@
+// Packed accelerometer stream encoding, a key sample then bit-packed deltas sized per batch
+#ifndef _STREAM_CODEC_H_
+#define _STREAM_CODEC_H_
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+
+// Definitions
+// Samples are interleaved x, y, z signed 16 bit values (accel_t)
+#define STREAM_CODEC_AXES			3
+// Bits for the largest delta, a zigzag 17 bit difference of 16 bit values
+#define STREAM_CODEC_WIDTH_MAX		17
+// Longest encoding of a batch: key sample, width per axis, deltas of the other samples at the largest width
+#define STREAM_CODEC_MAX_LEN(_n)	((STREAM_CODEC_AXES * sizeof(int16_t)) + STREAM_CODEC_AXES + \
+									((((_n) - 1) * STREAM_CODEC_AXES * STREAM_CODEC_WIDTH_MAX) + 7) / 8)
+
+// Encoded batch layout (little endian):
+//	int16_t key[3]		First sample
+//	uint8_t width[3]	Bits per delta of each axis (0 to 17), zero if the axis is constant
+//	deltas				Zigzag difference from the previous sample, for samples 1 to count-1 in x, y, z order,
+//						packed least significant bit first at the axis width, padded to a whole byte
+
+// Functions
+// Encode a batch of samples, returns the length written (zero for no samples)
+uint16_t StreamCodecEncode(uint8_t* destination, const int16_t* samples, uint8_t count);
+// Decode a batch of samples - returns false if the source is too short
+bool StreamCodecDecode(const uint8_t* source, uint16_t length, int16_t* samples, uint8_t count);
+
+#endif
+//EOF
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stddef.h>
 #include "nordic_common.h"
 #include "pstorage.h"
 #include "ble_nus.h"
@@ -18,16 +19,72 @@
 #include "acc_tasks.h"
 #include "ble_serial.h"
 #include "AsciiHex.h"
+#include "Crc16.h"
+#include "StreamCodec.h"
+#include "EpochCodec.h"
+#include "DailyRollup.h"
 
 // Definitions
+#define EPOCH_NVM_PAGE_BLOCKS		(PSTORAGE_FLASH_PAGE_SIZE / EPOCH_NVM_BLOCK_SIZE)	// Blocks per flash page, erased together
+#define EPOCH_DATA_START			(offsetof(Epoch_block_t, epoch_data))				// Block offset of the epoch data area
+#define EPOCH_CHECK_WORD			(offsetof(Epoch_block_t, check) & ~(sizeof(uint32_t) - 1))	// Block offset of the word holding the check
+#define EPOCH_WORD_DOWN(_x)			((_x) & ~(sizeof(uint32_t) - 1))					// Flash word containing a block offset
+#define EPOCH_ERASE_WORDS			(EPOCH_ERASE_NVM_SIZE / sizeof(uint32_t))			// Erase journal entries, one word each
+#define EPOCH_ERASE_WORD(_n)		((uint32_t)(uint16_t)(_n) | ((uint32_t)(uint16_t)~(_n) << 16))	// Erase journal entry, boundary and its complement
+#define EPOCH_RETAIN_MAGIC			(0x52455441ul)										// Retained state valid (plus the state size, changes with the layout)
 
 // Types 
+// Active block state kept in no-init RAM with the block, valid after a warm reset
+typedef struct {
+	uint32_t magic;
+	uint16_t index;
+	uint16_t dataBytes;
+	EpochCodec_t codec;
+	EpochBlockSummary_t summary;
+	uint16_t blockCheck;	// CRC-16/CCITT of the active block without the check (re-calculated by reads)
+	uint16_t check;			// CRC-16/CCITT of the state
+} EpochRetainBlock_t;
+// Epoch in progress kept in no-init RAM, valid after a warm reset
+typedef struct {
+	uint32_t magic;
+	uint32_t closeTime;
+	uint32_t spanLength;
+	uint64_t sum;
+	uint32_t count;
+	int32_t dc[3];
+	PedState_t ped;
+	uint16_t check;			// CRC-16/CCITT of the state
+} EpochRetainEpoch_t;
 
 // Globals
 pstorage_handle_t	epoch_pstorage_handle;						// Persistent storage handle for blocks requested by the module
-Epoch_block_t		activeEpochBlock;							// 512 byte buffer currently active (includes block, size and time)
+Epoch_block_t __attribute__((section(".epoch_state"))) activeEpochBlock;	// 512 byte buffer currently active (includes block, size and time), kept by a warm reset
 uint16_t			activeIndex = EPOCH_BLOCK_INDEX_INVALID;	// Position of active block in NVM
 const uint16_t		epockBlockCount = EPOCH_NVM_BLOCK_COUNT;	// Total number of epoch blocks
+static bool			activeBlockUpdate = false;					// Active block flash is not erased, store with update (erase and re-write page)
+static bool			activeStoring = false;						// Active block store queued, the next block starts when it is written
+static uint16_t		activeDataBytes = 0;						// Active block epoch data area used
+static uint16_t		activeCommitEnd = 0;						// Active block offset written to NVM up to, whole words
+static EpochCodec_t	activeCodec;								// Active block packed epoch encoder
+static struct {
+	uint16_t index;
+	uint16_t block_number;
+	uint16_t sample;
+	uint16_t offset;
+	EpochCodec_t codec;
+} sampleCursor = {EPOCH_BLOCK_INDEX_INVALID};					// Packed epoch read position, sequential reads are not decoded again
+static uint32_t		activeHeaderStage[offsetof(Epoch_block_t, meta_data) / sizeof(uint32_t)];	// Active block header as written when opened
+static EpochBlockSummary_t activeSummary;						// Active block summary, written to the meta data when stored
+static uint32_t		recoverStage[2 + (sizeof(EpochBlockSummary_t) / sizeof(uint32_t))];	// Completion of a block left open by a reset
+static pstorage_handle_t epoch_erase_pstorage_handle;			// Persistent storage handle for the erase journal
+static uint16_t		eraseBoundary = EPOCH_BLOCK_INDEX_INVALID;	// Oldest block number kept by the last erase, invalid once all older blocks are overwritten
+static uint16_t		eraseJournalIndex = EPOCH_ERASE_WORDS;		// Next erase journal entry
+static uint32_t		eraseJournalStage;							// Erase journal entry being written, only the newest is needed
+static EpochBlockInfo_t	eraseLeaveStage;						// Info of an open block left by an erase, closed empty
+static EpochRetainBlock_t __attribute__((section(".epoch_state"))) retainBlock;	// Active block state, sealed after each change
+static EpochRetainEpoch_t __attribute__((section(".epoch_state"))) retainEpoch;	// Epoch in progress, sealed after each FIFO batch
+static bool			retainEpochValid = false;					// Epoch in progress retained by a warm reset, restored by the first start
+static bool			epochLayoutUpdated = false;					// Blocks of the layout before 2.0 found at init, the regions are being erased
 
 // External variables
 extern EpochTime_t rtcEpochTriplicate[3];
@@ -38,19 +95,47 @@ void AccelDeviceEventHandler(void * p_event_data, uint16_t event_size);
 void AccelDeviceEventCheck(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action);
 void AccelDeviceInterruptSetup(bool enable);
 void AccelPstorageStoreActiveBlock(void);
+bool AccelPstorageEraseAhead(void);
+bool AccelPstorageWrite(uint16_t index, const void* source, uint16_t offset, uint16_t length);
+void AccelPstorageCommitEpochs(void);
+void AccelEpochBlockRecover(uint16_t index);
+void AccelEpochSummaryInit(EpochBlockSummary_t* summary);
+void AccelEpochSummaryAdd(EpochBlockSummary_t* summary, const Epoch_sample_t* sample);
+bool AccelEpochHeadSearch(uint16_t* head);
+bool AccelEpochBlockErased(uint16_t index, uint16_t count);
+void AccelEpochBlockNext(void);
+bool AccelEpochNumberErased(uint16_t number);
+uint16_t AccelEpochEraseJournalRead(void);
+bool AccelEpochEraseJournalAdd(uint16_t boundary);
+bool AccelEpochBlockResume(uint16_t index, uint16_t boundary);
+void AccelEpochRetainBlock(void);
+bool AccelEpochRetainedBlockValid(void);
+bool AccelEpochLayoutOld(void);
+void AccelEpochRetainEpoch(void);
+bool AccelEpochRetainedEpochRestore(void);
 void AccelPstorageEventHandler(pstorage_handle_t * p_handle, uint8_t op_code, uint32_t result, uint8_t* p_data, uint32_t data_len);
 
 // Source
 bool AccelEpochLoggerInit(void)
 {
 	pstorage_module_param_t param;
+	pstorage_handle_t block_handle, erase_handle;
 	ret_code_t err_code;
 	EpochBlockInfo_t block_info;
 	uint32_t max_block_num, index_start;
 	uint32_t index;
+	uint16_t head, boundary;
+	bool retained;
 	
+	// State kept in RAM by a warm reset, checked before any of it is changed
+	retained = AccelEpochRetainedBlockValid();
+	retainEpochValid = (retainEpoch.magic == (EPOCH_RETAIN_MAGIC + sizeof(EpochRetainEpoch_t))) &&
+		(retainEpoch.check == Crc16Ccitt(&retainEpoch, offsetof(EpochRetainEpoch_t, check), CRC16_CCITT_INIT));
+
 	// Clear global variables to indicate invalid
-	activeEpochBlock.info.block_number = 0;
+	if(!retained)
+		activeEpochBlock.info.block_number = 0;
+	activeIndex = EPOCH_BLOCK_INDEX_INVALID;
 	
 	// The pstorage module must be initialised ONCE, done externally externally (main.c) i.e.
 	//err_code = pstorage_init();	
@@ -76,12 +161,51 @@ bool AccelEpochLoggerInit(void)
 		return false;
 	}
 
+	// The erase journal page follows the epoch blocks
+	param.block_size  = EPOCH_ERASE_NVM_SIZE;
+	param.block_count = 1;
+	err_code = pstorage_register(&param, &epoch_erase_pstorage_handle);	
+	if(err_code != NRF_SUCCESS)
+	{
+		app_error_fault_handler(0xBEEFBEEF + __LINE__, 0, (uint32_t)NULL);
+		return false;
+	}
+	// Blocks are read unfiltered until the head is found
+	eraseBoundary = EPOCH_BLOCK_INDEX_INVALID;
+
 	// Set up the read position variables
 	index_start = EPOCH_BLOCK_INDEX_INVALID;
 	max_block_num = 0;
-	
-	// Read the NVM data record to find the write position
-	for(index = 0; index < EPOCH_NVM_BLOCK_COUNT; index++)
+
+	// Firmware before 2.0 had one larger region, its blocks now overlap the journal and the regions after it at other
+	// indexes. Nothing is kept, the blocks and the journal are erased and the logger starts again at the first block
+	epochLayoutUpdated = AccelEpochLayoutOld();
+	if(epochLayoutUpdated)
+	{
+		block_handle.module_id = epoch_pstorage_handle.module_id;
+		erase_handle.module_id = epoch_erase_pstorage_handle.module_id;
+		if(	(pstorage_block_identifier_get(&epoch_pstorage_handle, 0, &block_handle) != NRF_SUCCESS) ||
+			(pstorage_clear(&block_handle, EPOCH_NVM_SIZE_TOTAL) != NRF_SUCCESS) ||
+			(pstorage_block_identifier_get(&epoch_erase_pstorage_handle, 0, &erase_handle) != NRF_SUCCESS) ||
+			(pstorage_clear(&erase_handle, EPOCH_ERASE_NVM_SIZE) != NRF_SUCCESS) )
+		{
+			app_error_fault_handler(0xBEEFBEEF + __LINE__, 0, (uint32_t)NULL);
+			return false;
+		}
+		retained = false;
+		eraseJournalIndex = 0;
+	}
+	// Search for the newest block, reading only a few block headers
+	else if(AccelEpochHeadSearch(&head))
+	{
+		if(head < EPOCH_NVM_BLOCK_COUNT)
+		{
+			index_start = head;
+			max_block_num = AccelEpochBlockNumber(head);
+		}
+	}
+	// Blocks not in sequence. Read the NVM data record to find the write position
+	else for(index = 0; index < EPOCH_NVM_BLOCK_COUNT; index++)
 	{
 		// Read info section of each block. Ensure data was read into block info variable
 		if(AccelEpochBlockRead((uint8_t*)&block_info, 0, sizeof(EpochBlockInfo_t), index) == false)
@@ -102,9 +226,8 @@ bool AccelEpochLoggerInit(void)
 		}
 	}// for every block
 
-	// Work out the start index for the next logging position
-	if(		(index_start < EPOCH_NVM_BLOCK_COUNT) &&
-			(max_block_num < EPOCH_BLOCK_NUMBER_LAST) )
+	// Work out the start index for the next logging position, block numbers wrap (clamped below)
+	if(index_start < EPOCH_NVM_BLOCK_COUNT)
 	{
 		activeIndex = index_start + 1;
 		block_info.block_number = max_block_num + 1;
@@ -119,21 +242,227 @@ bool AccelEpochLoggerInit(void)
 	// Clamp index and block number to wrap withing ranges
 	if(activeIndex >= EPOCH_NVM_BLOCK_COUNT)				activeIndex = 0;
 	if(block_info.block_number > EPOCH_BLOCK_NUMBER_LAST)	block_info.block_number = 0;
-	
-	// Clear current logging block data count and other variables
-	//block_info.data_length = 0;
-	memset(&activeEpochBlock, 0, EPOCH_NVM_BLOCK_SIZE); 
-	
-	// On first epoch write the other active block variables will be initialized
 
-	// Set active block info
-	memcpy(&activeEpochBlock.info,  &block_info, sizeof(EpochBlockInfo_t));
+	// Blocks before the last erase stay invalid, applied once the active block is known
+	boundary = epochLayoutUpdated ? EPOCH_BLOCK_INDEX_INVALID : AccelEpochEraseJournalRead();
+
+	// A block left open by a warm reset carries on with the state kept in RAM, nothing is lost
+	if(retained && (index_start < EPOCH_NVM_BLOCK_COUNT) && AccelEpochBlockResume(index_start, boundary))
+	{
+		memcpy(&block_info, &activeEpochBlock.info, sizeof(EpochBlockInfo_t));
+	}
+	else
+	{
+		// A block left open by a reset is completed with the epochs written before the reset
+		if(	(index_start < EPOCH_NVM_BLOCK_COUNT) &&
+			(AccelEpochBlockRead((uint8_t*)&activeEpochBlock, 0, EPOCH_NVM_BLOCK_SIZE, index_start)) &&
+			(activeEpochBlock.info.data_length == EPOCH_BLOCK_LENGTH_OPEN) )
+		{
+			AccelEpochBlockRecover(index_start);
+		}
+
+		// Blocks are only written to erased flash, check the rest of the active page
+		activeBlockUpdate = false;
+		if(!epochLayoutUpdated && !AccelEpochBlockErased(activeIndex, EPOCH_NVM_PAGE_BLOCKS - (activeIndex % EPOCH_NVM_PAGE_BLOCKS)))
+		{
+			// At a page start, erase the page now. Otherwise the page holds the last block, re-write it when storing
+			if((activeIndex % EPOCH_NVM_PAGE_BLOCKS) == 0)
+				AccelPstorageEraseAhead();
+			else
+				activeBlockUpdate = true;
+		}
+		
+		// Clear current logging block data count and other variables (the head search only reads the number)
+		block_info.data_length = 0;
+		block_info.time_stamp = 0;
+		memset(&activeEpochBlock, 0, EPOCH_NVM_BLOCK_SIZE); 
+		activeStoring = false;
+		activeDataBytes = 0;
+		activeCommitEnd = 0;
+		
+		// On first epoch write the other active block variables will be initialized
+
+		// Set active block info
+		memcpy(&activeEpochBlock.info,  &block_info, sizeof(EpochBlockInfo_t));
+	}
+	// The stored blocks are all before the active block
+	eraseBoundary = boundary;
+	if(eraseBoundary <= EPOCH_BLOCK_NUMBER_LAST)
+	{
+		if((uint16_t)(eraseBoundary - block_info.block_number) < 0x8000)
+			eraseBoundary = block_info.block_number;
+		else if((uint16_t)(block_info.block_number - eraseBoundary) >= EPOCH_NVM_BLOCK_COUNT)
+			eraseBoundary = EPOCH_BLOCK_INDEX_INVALID;
+	}
+	AccelEpochRetainBlock();
 	// Set the current epoch window to not end - not logging
 	status.epochCloseTime = SYSTIME_VALUE_INVALID;
 	// Ready to log epoch data
 	return true;
 }
 
+// Carry on with a block left open by a warm reset, using the state kept in RAM. The NVM must hold the block as
+// written before the reset, the epoch words not yet written when it reset are written again
+bool AccelEpochBlockResume(uint16_t index, uint16_t boundary)
+{
+	pstorage_handle_t block_handle;
+	const uint32_t *flash, *ram;
+	uint16_t offset, end, commit;
+	// Packed blocks with room for more epochs (a full block was being stored), not erased since
+	if(	(retainBlock.index != index) || (activeEpochBlock.info.data_length == 0) ||
+		(activeEpochBlock.info.block_number > EPOCH_BLOCK_NUMBER_LAST) ||
+		((activeEpochBlock.blockFormat & ~BLOCK_FORMAT_FLAG_MASK) != BLOCK_FORMAT_EPOCH_DATAv3) ||
+		(retainBlock.dataBytes > (EPOCH_NVM_BLOCK_DATA_LEN - EPOCH_CODEC_RECORD_MAX)) )
+		return false;
+	if((boundary <= EPOCH_BLOCK_NUMBER_LAST) && ((int16_t)(activeEpochBlock.info.block_number - boundary) < 0))
+		return false;
+	block_handle.module_id = epoch_pstorage_handle.module_id;
+	if(pstorage_block_identifier_get(&epoch_pstorage_handle, index, &block_handle) != NRF_SUCCESS)
+		return false;
+	flash = (const uint32_t*)block_handle.block_id;
+	ram = (const uint32_t*)&activeEpochBlock;
+	// Header as written when the block was opened
+	if(	(((const EpochBlockInfo_t*)flash)->block_number != activeEpochBlock.info.block_number) ||
+		(((const EpochBlockInfo_t*)flash)->data_length != EPOCH_BLOCK_LENGTH_OPEN) ||
+		(memcmp(&flash[1], &ram[1], offsetof(Epoch_block_t, meta_data) - sizeof(uint32_t)) != 0) )
+		return false;
+	// The summary words are still erased
+	for(offset = offsetof(Epoch_block_t, meta_data); offset < EPOCH_WORD_DOWN(EPOCH_DATA_START); offset += sizeof(uint32_t))
+	{
+		if(flash[offset / sizeof(uint32_t)] != 0xFFFFFFFF)
+			return false;
+	}
+	// Epoch words committed before the reset match, up to any not written yet
+	end = EPOCH_WORD_DOWN(EPOCH_DATA_START + retainBlock.dataBytes);
+	for(; offset < end; offset += sizeof(uint32_t))
+	{
+		if(flash[offset / sizeof(uint32_t)] != ram[offset / sizeof(uint32_t)])
+			break;
+	}
+	// The rest of the block is erased, including the check (the store had not started)
+	for(commit = offset; offset < EPOCH_NVM_BLOCK_SIZE; offset += sizeof(uint32_t))
+	{
+		if(flash[offset / sizeof(uint32_t)] != 0xFFFFFFFF)
+			return false;
+	}
+	// Carry on with the block, the rest of its page was erased before it was opened
+	activeIndex = index;
+	activeBlockUpdate = false;
+	activeStoring = false;
+	activeDataBytes = retainBlock.dataBytes;
+	activeCommitEnd = commit;
+	memcpy(&activeCodec, &retainBlock.codec, sizeof(EpochCodec_t));
+	memcpy(&activeSummary, &retainBlock.summary, sizeof(EpochBlockSummary_t));
+	AccelPstorageCommitEpochs();
+	return true;
+}
+
+// Seal the active block state in RAM, a reset part way through a change leaves it invalid
+void AccelEpochRetainBlock(void)
+{
+	retainBlock.magic = EPOCH_RETAIN_MAGIC + sizeof(EpochRetainBlock_t);
+	retainBlock.index = activeIndex;
+	retainBlock.dataBytes = activeDataBytes;
+	memcpy(&retainBlock.codec, &activeCodec, sizeof(EpochCodec_t));
+	memcpy(&retainBlock.summary, &activeSummary, sizeof(EpochBlockSummary_t));
+	retainBlock.blockCheck = Crc16Ccitt(&activeEpochBlock, offsetof(Epoch_block_t, check), CRC16_CCITT_INIT);
+	retainBlock.check = Crc16Ccitt(&retainBlock, offsetof(EpochRetainBlock_t, check), CRC16_CCITT_INIT);
+}
+
+// Active block state in RAM is valid, after a warm reset (no-init RAM is random at power on)
+bool AccelEpochRetainedBlockValid(void)
+{
+	return	(retainBlock.magic == (EPOCH_RETAIN_MAGIC + sizeof(EpochRetainBlock_t))) &&
+			(retainBlock.check == Crc16Ccitt(&retainBlock, offsetof(EpochRetainBlock_t, check), CRC16_CCITT_INIT)) &&
+			(retainBlock.blockCheck == Crc16Ccitt(&activeEpochBlock, offsetof(Epoch_block_t, check), CRC16_CCITT_INIT));
+}
+
+// Seal the epoch in progress in RAM
+void AccelEpochRetainEpoch(void)
+{
+	retainEpoch.magic = EPOCH_RETAIN_MAGIC + sizeof(EpochRetainEpoch_t);
+	retainEpoch.closeTime = status.epochCloseTime;
+	retainEpoch.spanLength = status.epochSpanLenth;
+	retainEpoch.sum = eepoch_sum;
+	retainEpoch.count = sample_count;
+	retainEpoch.dc[0] = x_dc;
+	retainEpoch.dc[1] = y_dc;
+	retainEpoch.dc[2] = z_dc;
+	memcpy(&retainEpoch.ped, &pedState, sizeof(PedState_t));
+	retainEpoch.check = Crc16Ccitt(&retainEpoch, offsetof(EpochRetainEpoch_t, check), CRC16_CCITT_INIT);
+}
+
+// Carry on with the epoch in progress before a warm reset, once after initialising. The window may have closed 
+// while the logger was stopped, it is then closed at once with the samples it has
+bool AccelEpochRetainedEpochRestore(void)
+{
+	int32_t remaining;
+	if(!retainEpochValid)
+		return false;
+	retainEpochValid = false;
+	remaining = retainEpoch.closeTime - rtcEpochTriplicate[0];
+	if(	(retainEpoch.closeTime == SYSTIME_VALUE_INVALID) || (retainEpoch.count == 0) ||
+		(remaining > (int32_t)settings.epochPeriod) || (remaining <= -(int32_t)settings.epochPeriod) )
+		return false;
+	status.epochCloseTime = retainEpoch.closeTime;
+	status.epochSpanLenth = retainEpoch.spanLength;
+	eepoch_sum = retainEpoch.sum;
+	sample_count = retainEpoch.count;
+	x_dc = retainEpoch.dc[0];
+	y_dc = retainEpoch.dc[1];
+	z_dc = retainEpoch.dc[2];
+	memcpy(&pedState, &retainEpoch.ped, sizeof(PedState_t));
+	return true;
+}
+
+// Blocks are written in index order with sequential numbers. From the oldest index of the current pass up to the 
+// newest block the numbers are in sequence, after it the blocks are erased or one pass older - binary search for the end
+bool AccelEpochHeadSearch(uint16_t* head)
+{
+	uint16_t first, low, high, mid, number, next;
+	// The oldest index of the current pass is 0, unless the first page was just erased ahead of the write position
+	for(first = 0; (first <= EPOCH_NVM_PAGE_BLOCKS) && (first < EPOCH_NVM_BLOCK_COUNT); first++)
+	{
+		number = AccelEpochBlockNumber(first);
+		if(number <= EPOCH_BLOCK_NUMBER_LAST)
+			break;
+	}
+	// Nothing written, the last block should also be empty
+	if((first > EPOCH_NVM_PAGE_BLOCKS) || (first >= EPOCH_NVM_BLOCK_COUNT))
+	{
+		*head = EPOCH_BLOCK_INDEX_INVALID;
+		return (AccelEpochBlockNumber(EPOCH_NVM_BLOCK_COUNT - 1) > EPOCH_BLOCK_NUMBER_LAST);
+	}
+	// Find the last block in sequence from the first
+	low = first;
+	high = EPOCH_NVM_BLOCK_COUNT - 1;
+	while(low < high)
+	{
+		mid = low + ((high - low + 1) / 2);
+		if(AccelEpochBlockNumber(mid) == (uint16_t)(((uint32_t)number + (mid - first)) % (EPOCH_BLOCK_NUMBER_LAST + 1)))
+			low = mid;
+		else
+			high = mid - 1;
+	}
+	*head = low;
+	// Check the block after the newest is erased or one pass older, otherwise the ring is not in sequence
+	number = (uint16_t)(((uint32_t)number + (low - first)) % (EPOCH_BLOCK_NUMBER_LAST + 1));
+	next = AccelEpochBlockNumber((low + 1) % EPOCH_NVM_BLOCK_COUNT);
+	if(	(next <= EPOCH_BLOCK_NUMBER_LAST) &&
+		(next != (uint16_t)(((uint32_t)number + (EPOCH_BLOCK_NUMBER_LAST + 1) + 1 - EPOCH_NVM_BLOCK_COUNT) % (EPOCH_BLOCK_NUMBER_LAST + 1))) )
+		return false;
+	return true;
+}
+
+// Block number from the NVM, invalid if erased or unreadable
+uint16_t AccelEpochBlockNumber(uint16_t index)
+{
+	EpochBlockInfo_t block_info;
+	if(!AccelEpochBlockRead((uint8_t*)&block_info, 0, sizeof(EpochBlockInfo_t), index))
+		return EPOCH_BLOCK_INDEX_INVALID;
+	return block_info.block_number;
+}
+
 void AccelCalcEpochWindow(void)
 {
 	uint32_t timeNow, offset;
@@ -182,8 +511,10 @@ void AccelCalcEpochWindow(void)
 bool AccelEpochLoggerStart(void)
 {
 	accel_t current = {0};
-	// Set current time and clear data length
-	activeEpochBlock.info.data_length = 0;
+	bool resumed;
+	// Set current time and clear data length (unless epochs are already in NVM)
+	if(activeDataBytes == 0)
+		activeEpochBlock.info.data_length = 0;
 	// Check accelerometer is present first
 	if(!AccelPresent())
 	{
@@ -193,8 +524,10 @@ bool AccelEpochLoggerStart(void)
 		app_error_fault_handler(0xBEEFBEEF + __LINE__, 0, (uint32_t)NULL);
 		return false;
 	}
-	// Calculate *first* epoch window end time
-	AccelCalcEpochWindow();
+	// Carry on with the epoch in progress before a warm reset. Otherwise calculate *first* epoch window end time
+	resumed = AccelEpochRetainedEpochRestore();
+	if(!resumed)
+		AccelCalcEpochWindow();
 	// Initialize global settings variable with modified defaults
 	AccelSetting(NULL, status.accelRange, status.accelRate);
 	// Start the accelerometer using global settings variable
@@ -204,13 +537,15 @@ bool AccelEpochLoggerStart(void)
 	// Get the current sensor value to initialize filter
 	AccelReadSample(&current);
 	// Clear epoch vars 
-	EpochInit(&current);
+	if(!resumed)
+		EpochInit(&current);
 	// Clear pending interrupts
 	AccelReadEvents();
 	// Setup interrupt pins - Fifo/other interrupts will begin triggering
 	AccelDeviceInterruptSetup(true);
 	// Reset pedometer
-	PedInit(PED_ONE_G_VALUE);
+	if(!resumed)
+		PedInit(PED_ONE_G_VALUE);
 	return true;
 }
 
@@ -227,6 +562,8 @@ bool AccelEpochLoggerStop(void)
 		// Accel was present and stopped
 		retval = true;
 	}
+	// The epoch in progress is not carried on by a reset
+	retainEpoch.magic = 0;
 	// If active logging and data stored, finalize
 	if(activeEpochBlock.info.data_length > 0)
 	{
@@ -243,10 +580,13 @@ bool AccelEpochBlockRead(uint8_t* destination, uint16_t offset, uint16_t length,
 	// If the index is for the active block then read from RAM
 	if(index == activeIndex)
 	{
-		// Make fake CRC for now. TODO: Clear old epoch data and calculate CRC
-		activeEpochBlock.check = 0xFFFF;
-		// Copy the active block to destination
+		// Calculate the CRC if it is read, unused epoch data is erased
+		if((offset + length) > offsetof(Epoch_block_t, check))
+			activeEpochBlock.check = Crc16Ccitt(&activeEpochBlock, offsetof(Epoch_block_t, check), CRC16_CCITT_INIT);
+		// Copy the active block to destination, erased if it is being stored after an erase
 		memcpy(destination, ((uint8_t*)&activeEpochBlock) + offset, length);
+		if(AccelEpochNumberErased(activeEpochBlock.info.block_number))
+			memset(destination, 0xFF, length);
 		return true;
 	}
 	else
@@ -263,32 +603,343 @@ bool AccelEpochBlockRead(uint8_t* destination, uint16_t offset, uint16_t length,
 			app_error_fault_handler(0xBEEFBEEF + __LINE__, 0, (uint32_t)NULL);
 			return false;
 		}	
+		// Blocks logically erased read as erased flash
+		if(AccelEpochNumberErased(((const EpochBlockInfo_t*)block_handle.block_id)->block_number))
+			memset(destination, 0xFF, length);
 	}
 	// Loaded NVM block successfully
 	return true;
 }
 
-bool AccelEpochBlockClearAll(void)
+const Epoch_block_t* AccelEpochBlockPointer(uint16_t index)
 {
 	pstorage_handle_t block_handle;
+	// Check the index is valid
+	if((index >= EPOCH_NVM_BLOCK_COUNT) || (activeIndex >= EPOCH_NVM_BLOCK_COUNT))
+		return NULL;
+	// The active block is in RAM and the rest of its page is erased ahead of writing
+	if((index / EPOCH_NVM_PAGE_BLOCKS) == (activeIndex / EPOCH_NVM_PAGE_BLOCKS))
+		return NULL;
+	// The next page holds the oldest blocks and is erased when the active block enters it, a reference could still be queued
+	if((index / EPOCH_NVM_PAGE_BLOCKS) == (((activeIndex / EPOCH_NVM_PAGE_BLOCKS) + 1) % (EPOCH_NVM_BLOCK_COUNT / EPOCH_NVM_PAGE_BLOCKS)))
+		return NULL;
+	// The block identifier is the flash address
+	block_handle.module_id = epoch_pstorage_handle.module_id;
+	if(pstorage_block_identifier_get(&epoch_pstorage_handle, index, &block_handle) != NRF_SUCCESS)
+		return NULL;
+	// Logically erased blocks are read through the filtered copy
+	if(AccelEpochNumberErased(((const Epoch_block_t*)block_handle.block_id)->info.block_number))
+		return NULL;
+	return (const Epoch_block_t*)block_handle.block_id;
+}
 
-	// Clear the logger state to begin at block 0
-	activeIndex = 0; // Clear active index to start again at sector 0
-	memset(&activeEpochBlock, 0, EPOCH_NVM_BLOCK_SIZE); // Wipe ram as well
-	status.epochCloseTime = SYSTIME_VALUE_INVALID; // No end to current epoch
+uint16_t AccelEpochBlockSamples(uint16_t index)
+{
+	struct {
+		EpochBlockInfo_t info;
+		uint16_t blockFormat;
+	} header;
+	uint16_t limit = EPOCH_BLOCK_DATA_COUNT;
+	if(!AccelEpochBlockRead((uint8_t*)&header, 0, sizeof(header), index) || (header.info.block_number > EPOCH_BLOCK_NUMBER_LAST))
+		return 0;
+	// Packed blocks hold a variable number of epochs
+	if((header.blockFormat & ~BLOCK_FORMAT_FLAG_MASK) == BLOCK_FORMAT_EPOCH_DATAv3)
+		limit = EPOCH_BLOCK_PACKED_COUNT;
+	return (header.info.data_length > limit) ? limit : header.info.data_length;
+}
 
-	// Set module ID (may not be needed)
-	block_handle.module_id = epoch_pstorage_handle.module_id;
-	// Request to read from block 0 (at offset of zero)
-	pstorage_block_identifier_get(&epoch_pstorage_handle, 0, &block_handle);	
-	// Ensure data was read into destination pointer variable
-	if((pstorage_clear(&block_handle, (EPOCH_NVM_SIZE_TOTAL))) != NRF_SUCCESS)
+bool AccelEpochSampleRead(Epoch_sample_t* destination, uint16_t first, uint16_t count, uint16_t index)
+{
+	pstorage_handle_t block_handle;
+	const Epoch_block_t* block = &activeEpochBlock;
+	EpochCodec_t codec;
+	Epoch_sample_t skipped;
+	const uint8_t *source, *end;
+	uint16_t sample;
+	// Stored blocks are read from the memory mapped NVM, the active block from RAM
+	if(index != activeIndex)
+	{
+		block_handle.module_id = epoch_pstorage_handle.module_id;
+		if(pstorage_block_identifier_get(&epoch_pstorage_handle, index, &block_handle) != NRF_SUCCESS)
+			return false;
+		block = (const Epoch_block_t*)block_handle.block_id;
+	}
+	if(AccelEpochNumberErased(block->info.block_number))
+		return false;
+	// Fixed size samples are copied
+	if((block->blockFormat & ~BLOCK_FORMAT_FLAG_MASK) != BLOCK_FORMAT_EPOCH_DATAv3)
+	{
+		if((first + count) > EPOCH_BLOCK_DATA_COUNT)
+			return false;
+		memcpy(destination, &block->epoch_data[first], count * sizeof(Epoch_sample_t));
+		return true;
+	}
+	// Packed samples are decoded from the start of the block, or carry on from the last read of the same block
+	if(	(sampleCursor.index == index) && (sampleCursor.block_number == block->info.block_number) && 
+		(sampleCursor.sample <= first) )
+	{
+		memcpy(&codec, &sampleCursor.codec, sizeof(EpochCodec_t));
+		source = ((const uint8_t*)block) + sampleCursor.offset;
+		sample = sampleCursor.sample;
+	}
+	else
+	{
+		EpochCodecInit(&codec);
+		source = (const uint8_t*)block->epoch_data;
+		sample = 0;
+	}
+	end = ((const uint8_t*)block) + offsetof(Epoch_block_t, check);
+	for(; sample < (first + count); sample++)
+	{
+		if(!EpochCodecDecode(&codec, &source, end, (sample < first) ? skipped.b : destination[sample - first].b))
+		{
+			sampleCursor.index = EPOCH_BLOCK_INDEX_INVALID;
+			return false;
+		}
+	}
+	// Blocks only change by adding records, the position stays valid until the block is erased
+	sampleCursor.index = index;
+	sampleCursor.block_number = block->info.block_number;
+	sampleCursor.sample = sample;
+	sampleCursor.offset = source - (const uint8_t*)block;
+	memcpy(&sampleCursor.codec, &codec, sizeof(EpochCodec_t));
+	return true;
+}
+
+uint16_t AccelEpochBlockFind(uint16_t block_number)
+{
+	EpochBlockInfo_t block_info;
+	uint16_t index, back;
+	// Blocks are numbered sequentially with the index, count back from the active block
+	back = activeEpochBlock.info.block_number - block_number;
+	// Invalid, overwritten or future block numbers start at the oldest possible block
+	if((block_number > EPOCH_BLOCK_NUMBER_LAST) || (back >= EPOCH_NVM_BLOCK_COUNT))
+		back = EPOCH_NVM_BLOCK_COUNT - 1;
+	// Nothing is kept before the last erase
+	if(AccelEpochNumberErased(activeEpochBlock.info.block_number))
+		back = 0;
+	else if((eraseBoundary <= EPOCH_BLOCK_NUMBER_LAST) && (back > (uint16_t)(activeEpochBlock.info.block_number - eraseBoundary)))
+		back = activeEpochBlock.info.block_number - eraseBoundary;
+	index = (activeIndex + EPOCH_NVM_BLOCK_COUNT - back) % EPOCH_NVM_BLOCK_COUNT;
+	// Skip erased or out of sequence blocks, the active block is always valid
+	while((index != activeIndex) && (back > 0))
+	{
+		// Stored block must have the expected block number
+		if(	(AccelEpochBlockRead((uint8_t*)&block_info, 0, sizeof(EpochBlockInfo_t), index)) && 
+			(block_info.block_number <= EPOCH_BLOCK_NUMBER_LAST) &&
+			(block_info.block_number == (uint16_t)(activeEpochBlock.info.block_number - back)) )
+			break;
+		// Next block, wrapped at the end of the NVM
+		if(++index >= EPOCH_NVM_BLOCK_COUNT)
+			index = 0;
+		back--;
+	}
+	return index;
+}
+
+uint16_t AccelEpochBlockFindTime(uint32_t time)
+{
+	uint16_t oldest, count, low, high, mid, index;
+	uint32_t start, end, found;
+	// Stored blocks from the oldest to the active block, in time order unless the clock was changed
+	oldest = AccelEpochBlockFind(activeEpochBlock.info.block_number - (EPOCH_NVM_BLOCK_COUNT - 1));
+	count = ((activeIndex + EPOCH_NVM_BLOCK_COUNT - oldest) % EPOCH_NVM_BLOCK_COUNT) + 1;
+	// The active block has no time until the first epoch
+	if(activeEpochBlock.info.data_length == 0)
+		count--;
+	if((count == 0) || (activeIndex >= EPOCH_NVM_BLOCK_COUNT))
+		return EPOCH_BLOCK_INDEX_INVALID;
+	// Binary search for the newest block starting at or before the time
+	low = 0;
+	high = count - 1;
+	while(low < high)
+	{
+		mid = low + ((high - low + 1) / 2);
+		if(AccelEpochBlockTimes((oldest + mid) % EPOCH_NVM_BLOCK_COUNT, &start, &end) && (start <= time))
+			low = mid;
+		else
+			high = mid - 1;
+	}
+	index = (oldest + low) % EPOCH_NVM_BLOCK_COUNT;
+	if(!AccelEpochBlockTimes(index, &found, &end))
+		return EPOCH_BLOCK_INDEX_INVALID;
+	if((found <= time) && (time < end))
+		return index;
+	// Not covered, the clock may have been changed. Check every block, newest first
+	for(mid = count; mid > 0; mid--)
+	{
+		if(AccelEpochBlockTimes((oldest + mid - 1) % EPOCH_NVM_BLOCK_COUNT, &start, &end) && (start <= time) && (time < end))
+			return (oldest + mid - 1) % EPOCH_NVM_BLOCK_COUNT;
+	}
+	// Time is between blocks (not logging), the next block is the first after it
+	if((found <= time) && ((low + 1) < count))
+		index = (oldest + low + 1) % EPOCH_NVM_BLOCK_COUNT;
+	return index;
+}
+
+// Time of the first epoch in a block and the end of the last
+bool AccelEpochBlockTimes(uint16_t index, uint32_t* start, uint32_t* end)
+{
+	struct {
+		EpochBlockInfo_t info;
+		uint16_t blockFormat;
+		uint16_t blockEpochPeriod;
+	} header;
+	if(!AccelEpochBlockRead((uint8_t*)&header, 0, sizeof(header), index))
+		return false;
+	// The first format did not record the period
+	if((header.blockFormat & ~BLOCK_FORMAT_FLAG_MASK) == BLOCK_FORMAT_EPOCH_DATA)
+		header.blockEpochPeriod = settings.epochPeriod;
+	*start = header.info.time_stamp;
+	*end = header.info.time_stamp + ((uint32_t)AccelEpochBlockSamples(index) * header.blockEpochPeriod);
+	return true;
+}
+
+bool AccelEpochBlockClearAll(void)
+{
+	uint16_t boundary;
+	// Check a valid block is being written
+	if(activeIndex >= EPOCH_NVM_BLOCK_COUNT)
+		return false;
+	// Blocks before the boundary are invalid, the epochs of the active block are erased too
+	boundary = activeEpochBlock.info.block_number;
+	if(activeEpochBlock.info.data_length > 0)
+		boundary = (boundary >= EPOCH_BLOCK_NUMBER_LAST) ? 0 : boundary + 1;
+	// Recorded first, a reset before the blocks are left keeps them erased
+	if(!AccelEpochEraseJournalAdd(boundary))
+		return false;
+	eraseBoundary = boundary;
+	sampleCursor.index = EPOCH_BLOCK_INDEX_INVALID;
+	// A block being stored starts the next block when written. Otherwise the open block is left part written and
+	// closed with no epochs (clearing the bits of the open length), unless it is to be re-written with an update
+	if((activeEpochBlock.info.data_length > 0) && !activeStoring)
+	{
+		if(!activeBlockUpdate)
+		{
+			memcpy(&eraseLeaveStage, &activeEpochBlock.info, sizeof(uint32_t));
+			eraseLeaveStage.data_length = 0;
+			AccelPstorageWrite(activeIndex, &eraseLeaveStage, 0, sizeof(uint32_t));
+		}
+		AccelEpochBlockNext();
+	}
+	// The logger carries on, pages are erased ahead of it as before
+	return true;
+}
+
+// Start the next block after the active block
+void AccelEpochBlockNext(void)
+{
+	uint16_t nextBlockNum = activeEpochBlock.info.block_number + 1;
+	// Either clear active block info completely
+	memset(&activeEpochBlock.info,  0, sizeof(EpochBlockInfo_t));
+	// Or just set write position of next point to zero
+	// activeEpochBlock.info.data_length = 0;
+	// Update index the next block number
+	activeEpochBlock.info.block_number = nextBlockNum;
+	// Update the NVM index position
+	if(++activeIndex >= EPOCH_NVM_BLOCK_COUNT)
+		activeIndex = 0;
+	// The rest of the page was erased before the first block was written
+	activeBlockUpdate = false;
+	activeStoring = false;
+	activeDataBytes = 0;
+	activeCommitEnd = 0;
+	// Blocks before the erase boundary have all been overwritten
+	if((eraseBoundary <= EPOCH_BLOCK_NUMBER_LAST) && ((uint16_t)(activeEpochBlock.info.block_number - eraseBoundary) >= EPOCH_NVM_BLOCK_COUNT))
+		eraseBoundary = EPOCH_BLOCK_INDEX_INVALID;
+	// Entering a new page, erase it ahead of the block being filled
+	if((activeIndex % EPOCH_NVM_PAGE_BLOCKS) == 0)
+		AccelPstorageEraseAhead();
+	AccelEpochRetainBlock();
+}
+
+// Block number is before the last erase, the boundary is within a ring of the active block (or the next block while storing)
+bool AccelEpochNumberErased(uint16_t number)
+{
+	if(eraseBoundary > EPOCH_BLOCK_NUMBER_LAST)
+		return false;
+	return ((int16_t)(number - eraseBoundary) < 0);
+}
+
+// Any stored block in a fixed sample format, only written by firmware before 2.0 (the blocks are still aligned)
+bool AccelEpochLayoutOld(void)
+{
+	struct {
+		EpochBlockInfo_t info;
+		uint16_t blockFormat;
+	} header;
+	uint16_t index;
+	for(index = 0; index < EPOCH_NVM_BLOCK_COUNT; index++)
+	{
+		if(	AccelEpochBlockRead((uint8_t*)&header, 0, sizeof(header), index) &&
+			(header.info.block_number <= EPOCH_BLOCK_NUMBER_LAST) &&
+			((header.blockFormat & ~BLOCK_FORMAT_FLAG_MASK) != BLOCK_FORMAT_EPOCH_DATAv3) )
+			return true;
+	}
+	return false;
+}
+
+bool AccelEpochLayoutUpdated(void)
+{
+	return epochLayoutUpdated;
+}
+
+// Newest boundary in the erase journal, invalid if none. A full journal, or one with an entry cut short by a reset, is rewritten
+uint16_t AccelEpochEraseJournalRead(void)
+{
+	pstorage_handle_t block_handle;
+	const uint32_t* journal;
+	uint16_t boundary = EPOCH_BLOCK_INDEX_INVALID;
+	block_handle.module_id = epoch_erase_pstorage_handle.module_id;
+	if(pstorage_block_identifier_get(&epoch_erase_pstorage_handle, 0, &block_handle) != NRF_SUCCESS)
+		return EPOCH_BLOCK_INDEX_INVALID;
+	journal = (const uint32_t*)block_handle.block_id;
+	// Entries are appended to the erased page
+	for(eraseJournalIndex = 0; eraseJournalIndex < EPOCH_ERASE_WORDS; eraseJournalIndex++)
+	{
+		if(journal[eraseJournalIndex] == 0xFFFFFFFF)
+			break;
+		if(journal[eraseJournalIndex] != EPOCH_ERASE_WORD(journal[eraseJournalIndex]))
+		{
+			eraseJournalIndex = EPOCH_ERASE_WORDS;
+			break;
+		}
+		boundary = (uint16_t)journal[eraseJournalIndex];
+	}
+	// No room left, start the page again with the newest boundary
+	if((eraseJournalIndex >= EPOCH_ERASE_WORDS) && (boundary <= EPOCH_BLOCK_NUMBER_LAST))
+		AccelEpochEraseJournalAdd(boundary);
+	return boundary;
+}
+
+// Append an erase boundary to the journal
+bool AccelEpochEraseJournalAdd(uint16_t boundary)
+{
+	pstorage_handle_t block_handle;
+	block_handle.module_id = epoch_erase_pstorage_handle.module_id;
+	if(pstorage_block_identifier_get(&epoch_erase_pstorage_handle, 0, &block_handle) != NRF_SUCCESS)
 	{
-		// Failed to load, take corrective action. Start at index 0 (any/current block number)
 		app_error_fault_handler(0xBEEFBEEF + __LINE__, 0, (uint32_t)NULL);
 		return false;
-	}	
-	// Cleared all NVM blocks queued
+	}
+	// Full, erase the page first. Only a reset between the two loses the boundary (once every page of erases)
+	if(eraseJournalIndex >= EPOCH_ERASE_WORDS)
+	{
+		if(pstorage_clear(&block_handle, EPOCH_ERASE_NVM_SIZE) != NRF_SUCCESS)
+		{
+			app_error_fault_handler(0xBEEFBEEF + __LINE__, 0, (uint32_t)NULL);
+			return false;
+		}
+		eraseJournalIndex = 0;
+	}
+	// Entries queued together all write the newest boundary, which is the one read back
+	eraseJournalStage = EPOCH_ERASE_WORD(boundary);
+	if(pstorage_store(&block_handle, (uint8_t*)&eraseJournalStage, sizeof(uint32_t), eraseJournalIndex * sizeof(uint32_t)) != NRF_SUCCESS)
+	{
+		app_error_fault_handler(0xBEEFBEEF + __LINE__, 0, (uint32_t)NULL);
+		return false;
+	}
+	eraseJournalIndex++;
 	return true;
 }
 
@@ -300,44 +951,14 @@ void AccelPstorageEventHandler(pstorage_handle_t * p_handle, uint8_t op_code, ui
 		case PSTORAGE_STORE_OP_CODE:
 		case PSTORAGE_UPDATE_OP_CODE:
 
-			// After update (NVM write), start the next block
-			if (result == NRF_SUCCESS)
-			{
-				uint16_t nextBlockNum = activeEpochBlock.info.block_number + 1;
-				// Either clear active block info completely
-				memset(&activeEpochBlock.info,  0, sizeof(EpochBlockInfo_t));
-				// Or just set write position of next point to zero
-				// activeEpochBlock.info.data_length = 0;
-				// Update index the next block number
-				activeEpochBlock.info.block_number = nextBlockNum;
-				// Update the NVM index position
-				if(++activeIndex >= EPOCH_NVM_BLOCK_COUNT)
-					activeIndex = 0;
-			}
+			// After the active block info is written (last write of the block), start the next block
+			if ((result == NRF_SUCCESS) && (p_data == (uint8_t*)&activeEpochBlock))
+				AccelEpochBlockNext();
 
 			break;
 
 		case PSTORAGE_CLEAR_OP_CODE:
-			// After clearing the block, get the handle to the active one and store (unless no data to store -> erase all case)
-			if((result == NRF_SUCCESS) && (activeEpochBlock.info.data_length != 0))
-			{
-				// Commit the active epoch data block to NVM
-				pstorage_handle_t nvm_handle;
-				//Get the block handle being written, store to global
-				result = pstorage_block_identifier_get(&epoch_pstorage_handle, activeIndex, &nvm_handle);
-				if(result != NRF_SUCCESS)
-				{
-					app_error_fault_handler(0xBEEFBEEF + __LINE__, 0, (uint32_t)NULL);
-					return;		
-				}	
-				// Write the active block to NVM and check result
-				result = pstorage_store(&nvm_handle, (uint8_t *)&activeEpochBlock, EPOCH_NVM_BLOCK_SIZE, 0);
-				if(result != NRF_SUCCESS)
-				{
-					app_error_fault_handler(0xBEEFBEEF + __LINE__, 0, (uint32_t)NULL);
-					return;		
-				}					
-			}
+			// Page erased ahead of the write position, nothing to do
 			break;
 
 		case PSTORAGE_LOAD_OP_CODE:			
@@ -349,23 +970,18 @@ void AccelPstorageEventHandler(pstorage_handle_t * p_handle, uint8_t op_code, ui
 
 void AccelPstorageStoreActiveBlock(void)
 {
-	uint32_t err_code, i;
-	uint16_t *checkPtr, check;
+	uint32_t err_code;
 	// Commit the active epoch data block to NVM
 	pstorage_handle_t nvm_handle;
 	// Check a valid block is being written
 	if(activeIndex >= EPOCH_NVM_BLOCK_COUNT)
 		return;
 
-	// Calculate and write the checksum. Initialize variables
-	checkPtr = (uint16_t*)&activeEpochBlock; check = 0;
-	// Add 510 of the 512 bytes in the block as 16 bit words
-	for(i = 0; i < ((EPOCH_NVM_BLOCK_SIZE / 2) - 1); i++)
-	{
-		check += *checkPtr++;
-	}
-	// Make the full block checksum equal zero (negate it)
-	activeEpochBlock.check = (~check) + 1;
+	// Summary of the epochs in the meta data
+	if(activeEpochBlock.blockFormat & BLOCK_FORMAT_SUMMARY)
+		memcpy(activeEpochBlock.meta_data, &activeSummary, sizeof(EpochBlockSummary_t));
+	// Calculate and write the CRC of the first 510 of the 512 bytes in the block
+	activeEpochBlock.check = Crc16Ccitt(&activeEpochBlock, offsetof(Epoch_block_t, check), CRC16_CCITT_INIT);
 
 	//Get the block handle being written, store to global
 	err_code = pstorage_block_identifier_get(&epoch_pstorage_handle, activeIndex, &nvm_handle);
@@ -374,34 +990,203 @@ void AccelPstorageStoreActiveBlock(void)
 		app_error_fault_handler(0xBEEFBEEF + __LINE__, 0, (uint32_t)NULL);
 		return;		
 	}
-#if 0
-	//Request clearing of the block.
-	err_code = pstorage_clear(&nvm_handle, EPOCH_NVM_BLOCK_SIZE);
-	if(err_code != NRF_SUCCESS)
+	// Epochs are already in the erased flash, add the part word not written, the check and then the length
+	if(!activeBlockUpdate)
 	{
-		app_error_fault_handler(0xBEEFBEEF + __LINE__, 0, (uint32_t)NULL);
-		return;		
-	}	
-#else
-	//Store GATTS information.
+		uint16_t end = EPOCH_WORD_DOWN(EPOCH_DATA_START + activeDataBytes + sizeof(uint32_t) - 1);
+		// The summary words were left erased when the block was opened
+		if(activeEpochBlock.blockFormat & BLOCK_FORMAT_SUMMARY)
+			AccelPstorageWrite(activeIndex, activeEpochBlock.meta_data, offsetof(Epoch_block_t, meta_data), sizeof(EpochBlockSummary_t));
+		// The erased words between the data and the check are not written
+		if(end <= EPOCH_CHECK_WORD)
+		{
+			if(end > activeCommitEnd)
+				AccelPstorageWrite(activeIndex, ((uint8_t*)&activeEpochBlock) + activeCommitEnd, activeCommitEnd, end - activeCommitEnd);
+			activeCommitEnd = EPOCH_CHECK_WORD;
+		}
+		AccelPstorageWrite(activeIndex, ((uint8_t*)&activeEpochBlock) + activeCommitEnd, activeCommitEnd, EPOCH_NVM_BLOCK_SIZE - activeCommitEnd);
+		activeCommitEnd = EPOCH_NVM_BLOCK_SIZE;
+		AccelPstorageWrite(activeIndex, &activeEpochBlock.info, 0, sizeof(uint32_t));
+		activeStoring = true;
+		// The store complete event of the info starts the next block
+		return;
+	}
+	// Not erased (e.g. after a reset part way through a page), back up and re-write the page
 	err_code = pstorage_update(&nvm_handle, (uint8_t *)&activeEpochBlock, EPOCH_NVM_BLOCK_SIZE, 0);	
 	if(err_code != NRF_SUCCESS)
 	{
 		app_error_fault_handler(0xBEEFBEEF + __LINE__, 0, (uint32_t)NULL);
 		return;		
 	}							
-#endif
-	// The erase complete event triggers the store command
+	activeStoring = true;
+	// The store complete event starts the next block
 	return;
 }	
 
+bool AccelPstorageWrite(uint16_t index, const void* source, uint16_t offset, uint16_t length)
+{
+	pstorage_handle_t nvm_handle;
+	// Word aligned write into erased flash, the source must not change until written
+	nvm_handle.module_id = epoch_pstorage_handle.module_id;
+	if(	(pstorage_block_identifier_get(&epoch_pstorage_handle, index, &nvm_handle) != NRF_SUCCESS) ||
+		(pstorage_store(&nvm_handle, (uint8_t*)source, length, offset) != NRF_SUCCESS) )
+	{
+		app_error_fault_handler(0xBEEFBEEF + __LINE__, 0, (uint32_t)NULL);
+		return false;
+	}
+	return true;
+}
+
+// Write the epoch records added since the last commit. Each flash word is written once, when it is full (records
+// are padded to the end of a word), the word shared with the check is written when the block is stored
+void AccelPstorageCommitEpochs(void)
+{
+	uint16_t end;
+	// Full words of records, the word with the check is only written when the block is stored
+	end = EPOCH_WORD_DOWN(EPOCH_DATA_START + activeDataBytes);
+	if(end > EPOCH_CHECK_WORD)
+		end = EPOCH_CHECK_WORD;
+	if(end <= activeCommitEnd)
+		return;
+	if(AccelPstorageWrite(activeIndex, ((uint8_t*)&activeEpochBlock) + activeCommitEnd, activeCommitEnd, end - activeCommitEnd))
+		activeCommitEnd = end;
+}
+
+// Complete a block left open by a reset (loaded into the active block), the epochs written before the reset are kept
+void AccelEpochBlockRecover(uint16_t index)
+{
+	EpochBlockSummary_t summary, erased;
+	Epoch_sample_t sample;
+	uint16_t count;
+	bool summaryErased, checkErased;
+	// A reset part way through storing the block may have written the summary and check already
+	memset(&erased, 0xFF, sizeof(EpochBlockSummary_t));
+	summaryErased = (memcmp(activeEpochBlock.meta_data, &erased, sizeof(EpochBlockSummary_t)) == 0);
+	checkErased = (*(const uint32_t*)(((const uint8_t*)&activeEpochBlock) + EPOCH_CHECK_WORD) == 0xFFFFFFFF);
+	AccelEpochSummaryInit(&summary);
+	if((activeEpochBlock.blockFormat & ~BLOCK_FORMAT_FLAG_MASK) == BLOCK_FORMAT_EPOCH_DATAv3)
+	{
+		EpochCodec_t codec;
+		const uint8_t *source, *end;
+		// Records end in the last written word, the words after are erased
+		for(end = ((const uint8_t*)&activeEpochBlock) + EPOCH_CHECK_WORD; end > ((const uint8_t*)&activeEpochBlock) + EPOCH_DATA_START; end -= sizeof(uint32_t))
+		{
+			if(*(const uint32_t*)(end - sizeof(uint32_t)) != 0xFFFFFFFF)
+				break;
+		}
+		// Count the complete records
+		EpochCodecInit(&codec);
+		source = ((const uint8_t*)&activeEpochBlock) + EPOCH_DATA_START;
+		for(count = 0; (count < EPOCH_BLOCK_PACKED_COUNT) && EpochCodecDecode(&codec, &source, end, sample.b); count++)
+			AccelEpochSummaryAdd(&summary, &sample);
+	}
+	else
+	{
+		Epoch_sample_t erased;
+		// Fixed samples, up to the first erased one
+		memset(&erased, 0xFF, sizeof(Epoch_sample_t));
+		for(count = 0; count < EPOCH_BLOCK_DATA_COUNT; count++)
+		{
+			if(memcmp(&activeEpochBlock.epoch_data[count], &erased, sizeof(Epoch_sample_t)) == 0)
+				break;
+		}
+	}
+	activeEpochBlock.info.data_length = count;
+	// The summary is only written if it was left erased
+	if((activeEpochBlock.blockFormat & BLOCK_FORMAT_SUMMARY) && summaryErased)
+		memcpy(activeEpochBlock.meta_data, &summary, sizeof(EpochBlockSummary_t));
+	activeEpochBlock.check = Crc16Ccitt(&activeEpochBlock, offsetof(Epoch_block_t, check), CRC16_CCITT_INIT);
+	// Written from a copy, the active block is re-used for the next block
+	memcpy(&recoverStage[0], &activeEpochBlock.info, sizeof(uint32_t));
+	memcpy(&recoverStage[1], ((uint8_t*)&activeEpochBlock) + EPOCH_CHECK_WORD, sizeof(uint32_t));
+	memcpy(&recoverStage[2], activeEpochBlock.meta_data, sizeof(EpochBlockSummary_t));
+	if((activeEpochBlock.blockFormat & BLOCK_FORMAT_SUMMARY) && summaryErased)
+		AccelPstorageWrite(index, &recoverStage[2], offsetof(Epoch_block_t, meta_data), sizeof(EpochBlockSummary_t));
+	if(checkErased)
+		AccelPstorageWrite(index, &recoverStage[1], EPOCH_CHECK_WORD, sizeof(uint32_t));
+	AccelPstorageWrite(index, &recoverStage[0], 0, sizeof(uint32_t));
+}
+
+void AccelEpochSummaryInit(EpochBlockSummary_t* summary)
+{
+	memset(summary, 0, sizeof(EpochBlockSummary_t));
+	summary->battMin = INT8_MAX;
+	summary->battMax = INT8_MIN;
+	memset(summary->reserved, 0xFF, sizeof(summary->reserved));
+}
+
+void AccelEpochSummaryAdd(EpochBlockSummary_t* summary, const Epoch_sample_t* sample)
+{
+	uint32_t energy;
+	uint16_t steps;
+	// Steps are the unsigned count for the epoch, two more bits are in the top of the orientation
+	steps = (uint16_t)(uint8_t)sample->part.steps | (((uint16_t)(uint8_t)sample->part.accel & 0xC0) << 2);
+	summary->steps += steps;
+	if(steps != 0)
+		summary->activeEpochs++;
+	// Energy is stored little endian, not aligned
+	energy =	((uint32_t)(uint8_t)sample->part.epoch[0]) | ((uint32_t)(uint8_t)sample->part.epoch[1] << 8) |
+				((uint32_t)(uint8_t)sample->part.epoch[2] << 16) | ((uint32_t)(uint8_t)sample->part.epoch[3] << 24);
+	if(energy > summary->energyMax)
+		summary->energyMax = energy;
+	if(sample->part.batt < summary->battMin)
+		summary->battMin = sample->part.batt;
+	if(sample->part.batt > summary->battMax)
+		summary->battMax = sample->part.batt;
+}
+
+void AccelEpochTimeChanged(void)
+{
+	// Only for a block with epochs, a new block starts at the new time
+	if(activeEpochBlock.info.data_length == 0)
+		return;
+	activeSummary.flags |= EPOCH_SUMMARY_TIME_CHANGED;
+	if(activeEpochBlock.blockFormat & BLOCK_FORMAT_SUMMARY)
+		memcpy(activeEpochBlock.meta_data, &activeSummary, sizeof(EpochBlockSummary_t));
+	AccelEpochRetainBlock();
+}
+
+bool AccelPstorageEraseAhead(void)
+{
+	pstorage_handle_t nvm_handle;
+	// Erase the whole page at the active block, the oldest blocks
+	nvm_handle.module_id = epoch_pstorage_handle.module_id;
+	if(	(pstorage_block_identifier_get(&epoch_pstorage_handle, activeIndex - (activeIndex % EPOCH_NVM_PAGE_BLOCKS), &nvm_handle) != NRF_SUCCESS) ||
+		(pstorage_clear(&nvm_handle, PSTORAGE_FLASH_PAGE_SIZE) != NRF_SUCCESS) )
+	{
+		app_error_fault_handler(0xBEEFBEEF + __LINE__, 0, (uint32_t)NULL);
+		return false;
+	}
+	// Queued, completes before the next store
+	return true;
+}
+
+bool AccelEpochBlockErased(uint16_t index, uint16_t count)
+{
+	pstorage_handle_t block_handle;
+	const uint32_t* word;
+	uint32_t remaining;
+	// The block identifier is the flash address
+	block_handle.module_id = epoch_pstorage_handle.module_id;
+	if(pstorage_block_identifier_get(&epoch_pstorage_handle, index, &block_handle) != NRF_SUCCESS)
+		return false;
+	// Every word must be erased
+	word = (const uint32_t*)block_handle.block_id;
+	for(remaining = (count * EPOCH_NVM_BLOCK_SIZE) / sizeof(uint32_t); remaining > 0; remaining--)
+	{
+		if(*word++ != 0xFFFFFFFF)
+			return false;
+	}
+	return true;
+}
+
 void AccelPstorageAddEpoch(Epoch_sample_t* data)
 {
 	// Check a valid block is being written
 	if(activeIndex >= EPOCH_NVM_BLOCK_COUNT)
 		return;
 	// Current block is full (busy writing error, shouldn't occurr)
-	if(activeEpochBlock.info.data_length >= EPOCH_BLOCK_DATA_COUNT)
+	if((activeEpochBlock.info.data_length > 0) && (activeDataBytes > (EPOCH_NVM_BLOCK_DATA_LEN - EPOCH_CODEC_RECORD_MAX)))
 	{
 		app_error_fault_handler(0xBEEFBEEF + __LINE__, 0, (uint32_t)NULL);
 		return;		
@@ -411,23 +1196,48 @@ void AccelPstorageAddEpoch(Epoch_sample_t* data)
 	{
 		// Write time stamp of first epoch entry to the block info
 		activeEpochBlock.info.time_stamp = status.epochCloseTime;
-		// Set the data block format
-		activeEpochBlock.blockFormat = BLOCK_FORMAT_EPOCH_DATAv2;
+		// Set the data block format, packed epochs with a summary
+		activeEpochBlock.blockFormat = BLOCK_FORMAT_EPOCH_DATAv3 | BLOCK_FORMAT_CHECK_CRC16 | BLOCK_FORMAT_SUMMARY;
 		// Add epoch period into old meta data region
 		activeEpochBlock.blockEpochPeriod = settings.epochPeriod; 
-		// TODO: Update block meta data if required
-		memset(activeEpochBlock.meta_data, 0, sizeof(activeEpochBlock.meta_data));
+		// Summary is written when the block is stored, the rest of the meta data is unused (erased)
+		memset(activeEpochBlock.meta_data, 0xFF, sizeof(activeEpochBlock.meta_data));
+		AccelEpochSummaryInit(&activeSummary);
+		// Clear the previous block's records, the unused area is erased as in the NVM
+		memset(activeEpochBlock.epoch_data, 0xFF, sizeof(activeEpochBlock.epoch_data));
+		EpochCodecInit(&activeCodec);
+		activeDataBytes = 0;
+		// Write the header now with an open length, completed when the block is stored
+		activeCommitEnd = EPOCH_WORD_DOWN(EPOCH_DATA_START);
+		if(!activeBlockUpdate)
+		{
+			memcpy(activeHeaderStage, &activeEpochBlock, sizeof(activeHeaderStage));
+			((EpochBlockInfo_t*)activeHeaderStage)->data_length = EPOCH_BLOCK_LENGTH_OPEN;
+			AccelPstorageWrite(activeIndex, activeHeaderStage, 0, sizeof(activeHeaderStage));
+		}
 	}	
-	// Add data point of new epoch
-	memcpy(&activeEpochBlock.epoch_data[activeEpochBlock.info.data_length], data, sizeof(Epoch_sample_t));
+	// Add data point of new epoch, packed as the changes from the last
+	activeDataBytes += EpochCodecRecord(&activeCodec, data->b, ((uint8_t*)activeEpochBlock.epoch_data) + activeDataBytes);
 	// Update length variable
 	activeEpochBlock.info.data_length++;
-	// Check for final entry in a full block
-	if(activeEpochBlock.info.data_length >= EPOCH_BLOCK_DATA_COUNT)
+	// Summary so far, visible in reads of the active block
+	AccelEpochSummaryAdd(&activeSummary, data);
+	memcpy(activeEpochBlock.meta_data, &activeSummary, sizeof(EpochBlockSummary_t));
+	// Write each epoch to the NVM as it is added, padded to the end of its flash word so a reset loses none
+	if(!activeBlockUpdate)
+	{
+		while(((EPOCH_DATA_START + activeDataBytes) % sizeof(uint32_t) != 0) && ((EPOCH_DATA_START + activeDataBytes) < EPOCH_CHECK_WORD))
+			((uint8_t*)activeEpochBlock.epoch_data)[activeDataBytes++] = EPOCH_CODEC_PAD;
+		AccelPstorageCommitEpochs();
+	}
+	// Check for final entry in a full block, when the next record may not fit
+	if(activeDataBytes > (EPOCH_NVM_BLOCK_DATA_LEN - EPOCH_CODEC_RECORD_MAX))
 	{
 		// Save the block to memory, success will reset the length
 		AccelPstorageStoreActiveBlock();
 	}
+	// Kept by a warm reset, which carries on with the block
+	AccelEpochRetainBlock();
 	// The next epoch should occur after the data has been saved to NVM
 	return;	
 }
@@ -458,17 +1268,22 @@ void AccelEpochWriteTasks(void)
 		epoch.part.accel &= 0x3f;
 		epoch.part.accel |= (steps >> 2) & 0xC0;
 
+		// A reset before the next epoch is sealed must not add this one again
+		retainEpoch.magic = 0;
 		// Normalize the epoch integration by dividing by window length (i.e. Set to 'sum per second')
 		eepoch_sum /= settings.epochPeriod;
 		// Add to data point in block		
 		memcpy(epoch.part.epoch, &eepoch_sum, sizeof(uint32_t));
 		// Add result to the global buffer and reset
 		AccelPstorageAddEpoch(&epoch);
+		// Add to the daily totals by the epoch start, an epoch ending at the day boundary is in the day before
+		DailyRollupAddEpoch(status.epochCloseTime - settings.epochPeriod, &epoch, steps);
 		// Clear the eepoch variables - restart integrator
 		eepoch_sum = 0;
 		sample_count = 0;
 		// Calculate next window end time
 		AccelCalcEpochWindow();
+		AccelEpochRetainEpoch();
 
         // Check pins to ensure no events are missed
 		AccelDeviceEventCheck((nrf_drv_gpiote_pin_t) 0, (nrf_gpiote_polarity_t) 0);
@@ -483,7 +1298,7 @@ void AccelDeviceEventHandler(void * p_event_data, uint16_t event_size)
 	// Fifo event pin
 	if(event == ACCEL_INT1)
 	{
-		uint8_t count, index;
+		uint8_t count;
 		accel_t samples[ACCEL_FIFO_WATERMARK];
 
 		// Read interrupt sources to clear pending interrupts
@@ -492,12 +1307,11 @@ void AccelDeviceEventHandler(void * p_event_data, uint16_t event_size)
 		// FW:1.9 edit
 		if(status.streamMode != 3)
 		{
-			// Calaulate epoch/pedometer values
-			for(index = 0; index < count; index++)
-			{
-				// Add data to the epoch
-				EpochAdd(&samples[index]);
-			}
+			// Calaulate epoch/pedometer values, the whole FIFO batch at once
+			EpochAddBatch(samples, count);
+			// Kept by a warm reset, the epoch carries on
+			if(status.epochCloseTime != SYSTIME_VALUE_INVALID)
+				AccelEpochRetainEpoch();
 		}
 
 		// Check for over-run error flags set
@@ -536,11 +1350,46 @@ void AccelDeviceEventHandler(void * p_event_data, uint16_t event_size)
 					// Add debug info to serial buffer ever second if space
 					if(QueueFree(&serial_out_queue) >= length)
 					{
-						// Output to stream
+						// Output to stream, one line of bulk data
+						ble_serial_out_boundary();
 						ble_serial_service_send(buffer, length);	
 					}
 				}
 			}
+			// Raw accelerometer data in binary frames - add to serial buffer
+			else if(((status.streamMode == 1) || (status.streamMode == 3)) && (status.streamFormat != STREAM_FORMAT_HEX))
+			{
+				// Frame header, sequence is counted for every batch so the client can detect dropped frames
+				static uint16_t sequence = 0;
+				struct {
+					uint16_t sequence;
+					uint16_t count;
+					uint32_t timeStamp;
+					uint16_t batt;
+					uint16_t temp;
+				} info = {sequence++, count, SYSTIME_RTC->COUNTER, battRaw, tempRaw};
+				// Delta packed samples, the size depends on the batch
+				if(status.streamFormat == STREAM_FORMAT_PACKED)
+				{
+					uint8_t packed[STREAM_CODEC_MAX_LEN(ACCEL_FIFO_WATERMARK)];
+					length = StreamCodecEncode(packed, (const int16_t*)samples, count);
+					if(ble_serial_frame_header(BLE_FRAME_TYPE_ACCEL_PACKED, sizeof(info) + length) != 0)
+					{
+						ble_serial_out_push(&info, sizeof(info));
+						ble_serial_out_push(packed, length);
+					}
+					else
+						ble_serial_stats.droppedBatches++;
+				}
+				// Add the whole frame if there is space (header checks)
+				else if(ble_serial_frame_header(BLE_FRAME_TYPE_ACCEL_STREAM, sizeof(info) + (count * sizeof(accel_t))) != 0)
+				{
+					ble_serial_out_push(&info, sizeof(info));
+					ble_serial_out_push(samples, count * sizeof(accel_t));
+				}
+				else
+					ble_serial_stats.droppedBatches++;
+			}
 			// Raw accelerometer data - add to serial buffer 
 			else if((status.streamMode == 1) || (status.streamMode == 3))
 			{
@@ -552,6 +1401,8 @@ void AccelDeviceEventHandler(void * p_event_data, uint16_t event_size)
 					uint16_t index = 0;
 					uint8_t buffer[ (WRITE_SEGMENT_SIZE * sizeof(accel_t) * 2) ];
 
+					// Each batch is one line of bulk data
+					ble_serial_out_boundary();
 					// Add streaming packet data header for time, batt, temp, count, etc... 
 					length = WriteBinaryToHex(buffer, (void*)&timeStamp, sizeof(uint32_t), false);			// 8 bytes
 					length += WriteBinaryToHex(buffer+length, (void*)&battRaw, sizeof(uint16_t), false);	// 4 bytes
@@ -571,7 +1422,7 @@ void AccelDeviceEventHandler(void * p_event_data, uint16_t event_size)
 						// Encode into ascii hex in place. Convert data byte length to character count
 						size = WriteBinaryToHex(buffer, &samples[index], size, false);
 						// Add the text segment to the queue. Early exit if push fails to write all output
-						if( (QueuePush(&serial_out_queue, buffer, size)) != size )
+						if( (ble_serial_out_push(buffer, size)) != size )
 							break;
 						// Increment the write offset
 						index += length;
@@ -579,6 +1430,8 @@ void AccelDeviceEventHandler(void * p_event_data, uint16_t event_size)
 					// Terminate data packet		
 					ble_serial_service_send("\r\n", 2);
 				}// If enough space to add to text queue
+				else
+					ble_serial_stats.droppedBatches++;
 			}// Stream mode 1
 		}// Stream modes
 	}// INT1 source
@@ -9,20 +9,27 @@
 #ifndef EPOCH_LENGTH_DEFAULT
 #define EPOCH_LENGTH_DEFAULT		(60ul * 1)		// 1 minute epoch interval
 #endif
-#ifndef EPOCH_NVM_SIZE_TOTAL
-#define EPOCH_NVM_SIZE_TOTAL		(64ul * 1024)	// Size of program flash used for data 
-#endif
 
 #define EPOCH_NVM_BLOCK_SIZE		(512ul)													// Size of an epoch data block
 #define EPOCH_NVM_BLOCK_COUNT		(EPOCH_NVM_SIZE_TOTAL / EPOCH_NVM_BLOCK_SIZE)			// Number of summary blocks in the NVM
 #define EPOCH_NVM_BLOCK_DATA_LEN	(EPOCH_NVM_BLOCK_SIZE - (sizeof(EpochBlockInfo_t)) - 22 - 2)
 #define EPOCH_BLOCK_DATA_COUNT		(EPOCH_NVM_BLOCK_DATA_LEN / (sizeof(Epoch_sample_t)) )	// Number of epoch samples per block
+#define EPOCH_BLOCK_PACKED_COUNT	(EPOCH_NVM_BLOCK_DATA_LEN)								// Most epoch samples in a packed block, one byte each
 #define EPOCH_BLOCK_NUMBER_LAST		(0xFFFE)												// Valid blocks numbered within this range, wraps arround
 #define EPOCH_BLOCK_INDEX_INVALID	(0xFFFF)												// A value for invalid array indexes
+#define EPOCH_BLOCK_LENGTH_OPEN		(0xFFFF)												// Block data length in NVM until the block is complete
 
 // NVM block data formats
 #define BLOCK_FORMAT_EPOCH_DATA		0		// Default/general data format
 #define BLOCK_FORMAT_EPOCH_DATAv2		1	// As above but added epoch period
+#define BLOCK_FORMAT_EPOCH_DATAv3		2	// As above but the epoch data area holds EpochCodec records (no runs), the block closes when full
+#define BLOCK_FORMAT_EPOCH_COMPACT		3	// Compact block (EpochCompactBlock_t), coarse bins of older epochs
+#define BLOCK_FORMAT_SUMMARY		0x4000	// Flag, meta data holds the EpochBlockSummary_t of the block
+#define BLOCK_FORMAT_FLAG_MASK		0xC000	// Flags, the rest is the data format
+
+// Block summary flags
+#define EPOCH_SUMMARY_TIME_CHANGED	0x01	// The clock was set while the block was open
+#define BLOCK_FORMAT_CHECK_CRC16	0x8000	// Flag, check is the CRC-16/CCITT of the first 510 bytes (otherwise the additive checksum)
 
 // Types
 
@@ -47,6 +54,17 @@ typedef struct EpochBlockInfo_tag {
 	uint32_t time_stamp;	
 } EpochBlockInfo_t;
 
+// Summary of the epochs in a block, in the meta data (16 of 18 bytes, the last two are unused)
+typedef struct EpochBlockSummary_tag {
+	uint32_t steps;			// Total steps
+	uint32_t energyMax;		// Largest epoch energy
+	uint16_t activeEpochs;	// Epochs with steps
+	int8_t battMin;			// Lowest battery
+	int8_t battMax;			// Highest battery
+	uint8_t flags;			// Summary flags
+	uint8_t reserved[3];
+} EpochBlockSummary_t;
+
 // Epoch data block type
 typedef struct Epoch_block_tag
 {
@@ -60,7 +78,7 @@ typedef struct Epoch_block_tag
 	uint8_t meta_data[18]; 
 	// 480 bytes of sequential epoch entries (1 hour/ 60 mins)
 	Epoch_sample_t epoch_data[EPOCH_BLOCK_DATA_COUNT];
-	// Checksum, ECC or CRC etc.
+	// Checksum or CRC, see block format
 	uint16_t check;
 } Epoch_block_t;
 
@@ -85,10 +103,28 @@ void AccelEpochWriteTasks(void);
 void AccelCalcEpochWindow(void);
 // Epoch block read routine
 bool AccelEpochBlockRead(uint8_t* destination, uint16_t offset, uint16_t length, uint16_t index);
-// Queue all the NVM epoch data to be erased
+// Direct pointer to a stored block in memory mapped NVM, NULL for blocks that may change (active block page and the next page erased)
+const Epoch_block_t* AccelEpochBlockPointer(uint16_t index);
+// Number of epoch samples in a block, any format
+uint16_t AccelEpochBlockSamples(uint16_t index);
+// Read epoch samples from a block, any format (packed blocks are decoded from the start)
+bool AccelEpochSampleRead(Epoch_sample_t* destination, uint16_t first, uint16_t count, uint16_t index);
+// Find the index of a block number, or the oldest stored block after it
+uint16_t AccelEpochBlockFind(uint16_t block_number);
+// Block number at an index, invalid if erased
+uint16_t AccelEpochBlockNumber(uint16_t index);
+// Time of the first epoch in a block and the end of the last
+bool AccelEpochBlockTimes(uint16_t index, uint32_t* start, uint32_t* end);
+// Find the index of the stored block covering a time (or the first block after it), invalid if there are none
+uint16_t AccelEpochBlockFindTime(uint32_t time);
+// Note a clock change in the active block summary
+void AccelEpochTimeChanged(void);
+// Erase all the epoch data logically, stored blocks are invalid at once and their pages are erased as the logger reaches them
 bool AccelEpochBlockClearAll(void);
 // Add epoch data to the active block
 void AccelPstorageAddEpoch(Epoch_sample_t* data);
+// The NVM held blocks of the layout before 2.0 at init and is being erased, the regions after the journal are erased by their modules
+bool AccelEpochLayoutUpdated(void);
 
 #endif
 //EOF
@@ -19,13 +19,33 @@
 ble_nus_t m_nus;	
 void (*ble_serial_user_cb)(void) = NULL;
 volatile bool serial_in_queue_flag = false;
+volatile bool serial_out_queue_flag = false;
 volatile bool serial_connected = false;
-// The serial fifo queues
+// The serial fifo queues, the out queue is for bulk data and the control queue is for command replies
 queue_t serial_in_queue;
 queue_t serial_out_queue;
+queue_t serial_control_queue;
 // The serial data buffers 
 uint8_t serial_in_buffer[BLE_SERIAL_IN_QUEUE_LEN];
 uint8_t serial_out_buffer[BLE_SERIAL_OUT_QUEUE_LEN];
+uint8_t serial_control_buffer[BLE_SERIAL_CONTROL_QUEUE_LEN];
+// Link statistics
+BleSerialStats_t ble_serial_stats;
+// Bulk data boundaries, out queue positions of frame/line starts. Added in application context and removed by the transmit handler
+uint16_t serial_out_boundaries[BLE_SERIAL_OUT_BOUNDARIES];
+volatile uint8_t serial_out_boundary_head, serial_out_boundary_tail;
+// The out regions sent by reference, added in application context and removed by the transmit handler
+BleSerialRegion_t serial_out_regions[BLE_SERIAL_OUT_REGIONS];
+volatile uint8_t serial_out_region_head, serial_out_region_tail;
+uint16_t serial_out_region_sent;
+
+// Position in the outgoing data, the out queue and regions
+typedef struct {
+	unsigned int head;		// Out queue head
+	uint8_t region;			// Region index
+	uint16_t sent;			// Sent length of region
+	bool stop;				// Stop at the next boundary
+} ble_serial_out_pos_t;
 
 // Driver internal prototypes
 extern void ble_serial_receive_handler(ble_nus_t * p_nus, uint8_t * p_data, uint16_t length);
@@ -33,6 +53,8 @@ extern void ble_serial_transmit_handler(void);
 extern void ble_serial_init_buffers(void);
 extern void ble_serial_radio_evt_enable(void);
 extern void SWI1_IRQHandler(void); // Radio events
+static uint16_t ble_serial_out_next(ble_serial_out_pos_t* pos, uint8_t** data, uint16_t max_len);
+static bool ble_serial_out_at_boundary(void);
 
 // Driver functions source
 // Call once from services initialize and enable serial service operation
@@ -44,6 +66,7 @@ void ble_serial_service_init(void)
 	ble_serial_init_buffers();
 	// Clear pending packet and connected flags
 	serial_in_queue_flag = false;
+	serial_out_queue_flag = false;
 	serial_connected = false;
 	// Serial service initialization for Nordic UART emulator 
 	memset(&nus_init, 0, sizeof(nus_init));
@@ -70,7 +93,7 @@ uint16_t ble_serial_service_send(const uint8_t* data_buffer, uint16_t data_len)
 	else
 	{
 		// Copy data to queue and return the count copied successfully
-		length = QueuePush(&serial_out_queue, (const void*) data_buffer, data_len);
+		length = ble_serial_out_push(data_buffer, data_len);
 		// If data was added, try sending it out to client
 // Called every connection event
 //		if(length != 0)	ble_serial_transmit_handler();
@@ -78,6 +101,163 @@ uint16_t ble_serial_service_send(const uint8_t* data_buffer, uint16_t data_len)
 	// Return size value
 	return (uint16_t)length;
 }
+// Add data to the out queue (bulk data, not checked for connection) - returns the added length
+uint16_t ble_serial_out_push(const void* data, uint16_t data_len)
+{
+	uint16_t length, waiting;
+	length = (uint16_t)QueuePush(&serial_out_queue, data, data_len);
+	// Statistics
+	ble_serial_stats.bytesQueued += length;
+	if(length != data_len)
+		ble_serial_stats.rejectedPushes++;
+	waiting = (uint16_t)QueueLength(&serial_out_queue);
+	if(waiting > ble_serial_stats.queueHighWater)
+		ble_serial_stats.queueHighWater = waiting;
+	return length;
+}
+// Add a command reply to the control queue, sent ahead of bulk data - returns the added length (zero if it does not all fit)
+uint16_t ble_serial_control_send(const uint8_t* data_buffer, uint16_t data_len)
+{
+	// Check if connected
+	if(serial_connected == false)
+		return 0;
+	// Replies are not split
+	if(QueueFree(&serial_control_queue) < data_len)
+	{
+		ble_serial_stats.rejectedPushes++;
+		return 0;
+	}
+	ble_serial_stats.bytesQueued += data_len;
+	return (uint16_t)QueuePush(&serial_control_queue, (const void*) data_buffer, data_len);
+}
+// Mark the start of a bulk data frame or text line at the out queue tail, replies may be sent here
+void ble_serial_out_boundary(void)
+{
+	uint8_t next = (serial_out_boundary_tail + 1) % BLE_SERIAL_OUT_BOUNDARIES;
+	// If full, the boundary is skipped and replies wait for a later one
+	if(next == serial_out_boundary_head)
+		return;
+	// Repeated boundaries are not needed
+	if(	(serial_out_boundary_head != serial_out_boundary_tail) && 
+		(serial_out_boundaries[(serial_out_boundary_tail + BLE_SERIAL_OUT_BOUNDARIES - 1) % BLE_SERIAL_OUT_BOUNDARIES] == serial_out_queue.tail) )
+		return;
+	serial_out_boundaries[serial_out_boundary_tail] = serial_out_queue.tail;
+	serial_out_boundary_tail = next;
+}
+// Outgoing data waiting to be sent, queued and in regions
+uint32_t ble_serial_out_pending(void)
+{
+	uint32_t length = QueueLength(&serial_out_queue);
+	uint8_t region = serial_out_region_head;
+	// Regions not yet sent, the first may be part sent
+	if(region != serial_out_region_tail)
+		length -= serial_out_region_sent;
+	for(; region != serial_out_region_tail; region = (region + 1) % BLE_SERIAL_OUT_REGIONS)
+		length += serial_out_regions[region].length;
+	return length;
+}
+// Add a binary frame header to the outgoing buffer if the full payload will also fit - returns header length added (or zero)
+uint16_t ble_serial_frame_header(uint8_t type, uint16_t payload_len)
+{
+	BleFrameHeader_t header;
+	// Check if connected
+	if(serial_connected == false)
+		return 0;
+	// Only start the frame if the caller can add the whole payload after it
+	if(QueueFree(&serial_out_queue) < (BLE_FRAME_HEADER_LEN + payload_len))
+		return 0;
+	// Make the header and add it to the queue, the frame start is a boundary
+	ble_serial_out_boundary();
+	header.sync = BLE_FRAME_SYNC;
+	header.type = type;
+	header.length = payload_len;
+	return ble_serial_out_push(&header, BLE_FRAME_HEADER_LEN);
+}
+// Add a binary frame of prefix data (copied) followed by a constant region (not copied) - returns the total frame length (or zero)
+uint16_t ble_serial_frame_region(uint8_t type, const void* prefix, uint16_t prefix_len, const uint8_t* data, uint16_t data_len)
+{
+	BleFrameHeader_t header;
+	uint8_t next = (serial_out_region_tail + 1) % BLE_SERIAL_OUT_REGIONS;
+	// Check if connected
+	if(serial_connected == false)
+		return 0;
+	// Check for a free region and queue space for the header and prefix
+	if((next == serial_out_region_head) || (data_len == 0))
+		return 0;
+	if(QueueFree(&serial_out_queue) < (BLE_FRAME_HEADER_LEN + prefix_len))
+		return 0;
+	// Header and prefix are copied to the queue, the frame start is a boundary
+	ble_serial_out_boundary();
+	header.sync = BLE_FRAME_SYNC;
+	header.type = type;
+	header.length = prefix_len + data_len;
+	ble_serial_out_push(&header, BLE_FRAME_HEADER_LEN);
+	ble_serial_out_push(prefix, prefix_len);
+	ble_serial_stats.bytesQueued += data_len;
+	// Region follows the queued data, set the entry before adding it
+	serial_out_regions[serial_out_region_tail].data = data;
+	serial_out_regions[serial_out_region_tail].length = data_len;
+	serial_out_regions[serial_out_region_tail].mark = serial_out_queue.tail;
+	serial_out_region_tail = next;
+	return BLE_FRAME_HEADER_LEN + prefix_len + data_len;
+}
+// Write to the out queue after the tail without adding it, the transmit handler can not see it yet
+static void ble_serial_queue_write_ahead(uint16_t offset, const void* data, uint16_t length)
+{
+	uint8_t* buffer = (uint8_t*)serial_out_queue.buffer;
+	const uint8_t* source = (const uint8_t*)data;
+	unsigned int index = (serial_out_queue.tail + offset) % serial_out_queue.capacity;
+	while(length--)
+	{
+		buffer[index] = *source++;
+		if(++index >= serial_out_queue.capacity)
+			index = 0;
+	}
+}
+// Start a binary frame of up to limit payload bytes - returns false if not connected or no room
+bool ble_serial_frame_begin(BleFrameWriter_t* frame, uint8_t type, uint16_t limit)
+{
+	frame->length = 0;
+	frame->limit = 0;
+	frame->type = type;
+	// Check if connected
+	if(serial_connected == false)
+		return false;
+	// Reserve space for the whole frame
+	if(QueueFree(&serial_out_queue) < (BLE_FRAME_HEADER_LEN + limit))
+		return false;
+	frame->limit = limit;
+	return true;
+}
+// Add payload to a started frame - returns the length added
+uint16_t ble_serial_frame_write(BleFrameWriter_t* frame, const void* data, uint16_t length)
+{
+	// Limit to the reserved space
+	if(length > (frame->limit - frame->length))
+		length = frame->limit - frame->length;
+	ble_serial_queue_write_ahead(BLE_FRAME_HEADER_LEN + frame->length, data, length);
+	frame->length += length;
+	return length;
+}
+// Set the frame header and release the frame to be sent - returns the total frame length
+uint16_t ble_serial_frame_end(BleFrameWriter_t* frame)
+{
+	BleFrameHeader_t header;
+	// Not started
+	if(frame->limit == 0)
+		return 0;
+	// Header now the length is known
+	header.sync = BLE_FRAME_SYNC;
+	header.type = frame->type;
+	header.length = frame->length;
+	ble_serial_queue_write_ahead(0, &header, BLE_FRAME_HEADER_LEN);
+	// Add the whole frame to the queue at once, the frame start is a boundary
+	ble_serial_out_boundary();
+	QueueExternallyAdded(&serial_out_queue, BLE_FRAME_HEADER_LEN + frame->length);
+	ble_serial_stats.bytesQueued += BLE_FRAME_HEADER_LEN + frame->length;
+	frame->limit = 0;
+	return BLE_FRAME_HEADER_LEN + frame->length;
+}
 // Check input serial buffer for input data and/or extract it - returns copied length (or count received for NULL pointer)
 uint16_t ble_serial_service_receive(uint8_t* data_buffer, uint16_t data_len)
 {
@@ -185,11 +365,77 @@ void ble_serial_receive_handler(ble_nus_t * p_nus, uint8_t * p_data, uint16_t le
 	return;
 }
 
+// Next contiguous outgoing data at the position, up to the maximum length - advances the position and returns the length
+static uint16_t ble_serial_out_next(ble_serial_out_pos_t* pos, uint8_t** data, uint16_t max_len)
+{
+	unsigned int tail = *(volatile unsigned int*)&serial_out_queue.tail;
+	unsigned int length;
+	// Check for a region waiting to be sent
+	if(pos->region != serial_out_region_tail)
+	{
+		BleSerialRegion_t* region = &serial_out_regions[pos->region];
+		// The region is next if the queue data before it is sent
+		if(pos->head == region->mark)
+		{
+			length = region->length - pos->sent;
+			if(length > max_len)
+				length = max_len;
+			*data = (uint8_t*)&region->data[pos->sent];
+			// Next region after the last of this one
+			pos->sent += length;
+			if(pos->sent >= region->length)
+			{
+				pos->region = (pos->region + 1) % BLE_SERIAL_OUT_REGIONS;
+				pos->sent = 0;
+			}
+			return length;
+		}
+		// Queue data up to the region
+		tail = region->mark;
+	}
+	// Stop at the next boundary, replies are waiting
+	if(pos->stop && (serial_out_boundary_head != serial_out_boundary_tail))
+	{
+		unsigned int boundary = serial_out_boundaries[serial_out_boundary_head];
+		unsigned int capacity = serial_out_queue.capacity;
+		if(pos->head == boundary)
+			return 0;
+		if(((boundary + capacity - pos->head) % capacity) < ((tail + capacity - pos->head) % capacity))
+			tail = boundary;
+	}
+	// Contiguous out queue entries
+	length = (tail >= pos->head) ? (tail - pos->head) : (serial_out_queue.capacity - pos->head);
+	if(length > max_len)
+		length = max_len;
+	*data = &serial_out_buffer[pos->head];
+	pos->head = (pos->head + length) % serial_out_queue.capacity;
+	return length;
+}
+
+// Check if the sent bulk data ends on a boundary, a whole frame or text line
+static bool ble_serial_out_at_boundary(void)
+{
+	unsigned int head = serial_out_queue.head;
+	// Part sent regions are not boundaries, unsent regions at the head belong to the previous frame
+	if(serial_out_region_head != serial_out_region_tail)
+	{
+		if((serial_out_region_sent != 0) || (serial_out_regions[serial_out_region_head].mark == head))
+			return false;
+	}
+	// All sent
+	else if(head == *(volatile unsigned int*)&serial_out_queue.tail)
+		return true;
+	// Start of a frame or line
+	return (serial_out_boundary_head != serial_out_boundary_tail) && (serial_out_boundaries[serial_out_boundary_head] == head);
+}
+
 // Serial handler to send data out
 void ble_serial_transmit_handler(void)
 {	
 	uint32_t return_code;
-	uint8_t* queue_ptr;
+	uint8_t* packet_ptr;
+	uint8_t packet[BLE_NUS_MAX_DATA_LEN];
+	uint16_t packets = 0;
 
 	// Check if connected
 	if(serial_connected == false)
@@ -197,28 +443,83 @@ void ble_serial_transmit_handler(void)
 	// Check for outgoing data, queue packet(s) for transmit to client until max packets pending is reached
 	for(;;)
 	{
-		int32_t length;
-		// Check available output data contiguous length, sent from queue directly
-		length = QueueContiguousEntries(&serial_out_queue, (void**)&queue_ptr);
+		ble_serial_out_pos_t pos = {serial_out_queue.head, serial_out_region_head, serial_out_region_sent, false};
+		bool control = false;
+		uint16_t length;
+		// Replies are sent first, but only between bulk frames/lines and never in the same packet
+		if(QueueLength(&serial_control_queue) > 0)
+		{
+			if(ble_serial_out_at_boundary())
+			{
+				length = QueueContiguousEntries(&serial_control_queue, (void**)&packet_ptr);
+				if(length > BLE_NUS_MAX_DATA_LEN)
+					length = BLE_NUS_MAX_DATA_LEN;
+				control = true;
+			}
+			else
+			{
+				// Bulk data up to the next boundary
+				pos.stop = true;
+			}
+		}
+		// Check available output data contiguous length, sent from queue or region directly
+		if(!control)
+			length = ble_serial_out_next(&pos, &packet_ptr, BLE_NUS_MAX_DATA_LEN);
 		// Exit early if no more out data present in buffer to send
-		if(length <= 0)
+		if(length == 0)
 			break;
-		// Clamp length to maximum serial packet length
-		if(length > BLE_NUS_MAX_DATA_LEN)
-			length = BLE_NUS_MAX_DATA_LEN;
-		// Try adding data to the outgoing radio's packet send queue
-		return_code = ble_nus_string_send(&m_nus, queue_ptr, length);
+		// Short bulk packets are filled from the following data (queue wrap or region edge) 
+		if((!control) && (length < BLE_NUS_MAX_DATA_LEN))
+		{
+			uint8_t* next_ptr;
+			uint16_t next_len;
+			memcpy(packet, packet_ptr, length);
+			while((length < BLE_NUS_MAX_DATA_LEN) && ((next_len = ble_serial_out_next(&pos, &next_ptr, BLE_NUS_MAX_DATA_LEN - length)) > 0))
+			{
+				memcpy(&packet[length], next_ptr, next_len);
+				length += next_len;
+			}
+			packet_ptr = packet;
+		}
+		// Try adding data to the outgoing radio's packet send queue, the data is copied
+		return_code = ble_nus_string_send(&m_nus, packet_ptr, length);
 		// Check result of transmit packet routine
 		switch(return_code) {
 			case NRF_SUCCESS: 
 			{
-				// If packet queued for send then update the sent packet size record array 
-				QueueExternallyRemoved(&serial_out_queue, length);	
+				unsigned int removed;
+				// Statistics
+				ble_serial_stats.bytesSent += length;
+				ble_serial_stats.packetsSent++;
+				packets++;
+				// If packet queued for send then remove the sent data
+				if(control)
+				{
+					QueueExternallyRemoved(&serial_control_queue, length);
+					continue;
+				}
+				removed = (pos.head + serial_out_queue.capacity - serial_out_queue.head) % serial_out_queue.capacity;
+				// Remove the boundaries passed
+				while(serial_out_boundary_head != serial_out_boundary_tail)
+				{
+					unsigned int offset = (serial_out_boundaries[serial_out_boundary_head] + serial_out_queue.capacity - serial_out_queue.head) % serial_out_queue.capacity;
+					if(offset >= removed)
+						break;
+					serial_out_boundary_head = (serial_out_boundary_head + 1) % BLE_SERIAL_OUT_BOUNDARIES;
+				}
+				QueueExternallyRemoved(&serial_out_queue, removed);	
+				serial_out_region_sent = pos.sent;
+				serial_out_region_head = pos.region;
 				// Try to enqueue another packet
 				continue;
 			}	
 			// Other expected errors
 			case BLE_ERROR_NO_TX_PACKETS:
+			{
+				// Radio buffers are full, the connection event is fully used
+				ble_serial_stats.noTxPackets++;
+				break;
+			}
 			case NRF_ERROR_INVALID_STATE:
 			{
 				// The last packet did not get added, no change and exit
@@ -236,6 +537,10 @@ void ble_serial_transmit_handler(void)
 		// Stop looping on first send failure;
 		break;
 	} // For...
+	if(packets > ble_serial_stats.packetsMax)
+		ble_serial_stats.packetsMax = packets;
+	// Indicate output queue space to the application, it may add more data outside of this interrupt
+	serial_out_queue_flag = true;
 }
 
 // Dump any remaining data from the buffers and clear buffer queue states
@@ -244,6 +549,13 @@ void ble_serial_init_buffers(void)
 	// Initialize and reset the serial buffer queues
 	QueueInit(&serial_in_queue, sizeof(uint8_t), BLE_SERIAL_IN_QUEUE_LEN, serial_in_buffer);	
 	QueueInit(&serial_out_queue, sizeof(uint8_t), BLE_SERIAL_OUT_QUEUE_LEN, serial_out_buffer);	
+	QueueInit(&serial_control_queue, sizeof(uint8_t), BLE_SERIAL_CONTROL_QUEUE_LEN, serial_control_buffer);	
+	// No boundaries or regions to send
+	serial_out_boundary_head = 0;
+	serial_out_boundary_tail = 0;
+	serial_out_region_head = 0;
+	serial_out_region_tail = 0;
+	serial_out_region_sent = 0;
 }
 
 // The event created on radio on and off events and the event handler
@@ -253,6 +565,8 @@ void SWI1_IRQHandler(void)
 	// Check if connected
 	if(serial_connected == false)
 		return;	
+	// Count connection events
+	ble_serial_stats.radioEvents++;
 	// Create a new event to pass to the local serial BLE event handler
 	ble_evt_t p_ble_evt = {.header.evt_id = BLE_EVT_TX_COMPLETE, .header.evt_len = 0};
 	ble_serial_event_handler(&m_nus, &p_ble_evt);	
@@ -4,11 +4,62 @@
 #include <stdint.h>
 #include "utils/Queue.h"
 
+// Binary frames - binary replies are framed so they can be separated from ascii text replies
+#define BLE_FRAME_SYNC				0xA5	// Frame start marker, never a valid ascii text character
+#define BLE_FRAME_HEADER_LEN		(sizeof(BleFrameHeader_t))
+// Frame payload types
+#define BLE_FRAME_TYPE_EPOCH_BLOCK	'B'		// uint16_t block index, raw Epoch_block_t
+#define BLE_FRAME_TYPE_BURST_END	'E'		// uint16_t next block index, uint16_t blocks not sent, uint32_t rtc ticks, uint32_t radio events since the burst start
+#define BLE_FRAME_TYPE_NEW_EPOCHS	'N'		// uint16_t block number, offset, count, period, uint32_t time stamp, count * Epoch_sample_t
+#define BLE_FRAME_TYPE_ACCEL_STREAM	'I'		// uint16_t sequence, count, uint32_t rtc ticks, uint16_t batt, temp, count * accel_t
+#define BLE_FRAME_TYPE_ACCEL_PACKED	'D'		// As BLE_FRAME_TYPE_ACCEL_STREAM header, StreamCodec encoded samples
+#define BLE_FRAME_TYPE_LINK_STATS	'K'		// BleSerialStats_t
+#define BLE_FRAME_TYPE_BLOCK_SUMMARY	'S'		// count * (uint16_t block index, block header (30 bytes): info, format, period, meta data)
+#define BLE_FRAME_TYPE_PACKED_BLOCK	'P'		// uint16_t block index, block header (30 bytes), uint16_t check, EpochCodec records for data_length samples
+#define BLE_FRAME_TYPE_COMPACT_BLOCK	'C'		// uint16_t compact block index, raw EpochCompactBlock_t
+#define BLE_FRAME_TYPE_DAILY_ROLLUP	'R'		// DailyRecord_t current day, DAILY_RECORD_COUNT * DailyRecord_t stored ring (index order, erased are 0xFF)
+
+// Header at the start of each binary frame (little endian)
+typedef struct BleFrameHeader_tag {
+	uint8_t sync;			// Always BLE_FRAME_SYNC
+	uint8_t type;			// Payload type
+	uint16_t length;		// Payload length in bytes, excluding header
+} BleFrameHeader_t;
+
+// Data sent by reference from a constant memory region (e.g. flash), ordered with the out queue data
+typedef struct BleSerialRegion_tag {
+	const uint8_t* data;	// Region start, must not change until sent
+	uint16_t length;		// Region length
+	uint16_t mark;			// Out queue tail when added, the region is sent when the queue head reaches it
+} BleSerialRegion_t;
+
+// Binary frame of unknown length, written to the out queue and not sent until ended
+typedef struct BleFrameWriter_tag {
+	uint16_t length;		// Payload written
+	uint16_t limit;			// Payload space reserved
+	uint8_t type;			// Payload type
+} BleFrameWriter_t;
+
+// Link statistics, read and reset by command. Little endian binary frame payload
+typedef struct BleSerialStats_tag {
+	uint32_t bytesQueued;	// Bytes added to the out and control queues, including regions
+	uint32_t bytesSent;		// Bytes accepted by the radio
+	uint32_t packetsSent;	// Packets accepted by the radio
+	uint32_t radioEvents;	// Radio inactive notifications, one per connection event
+	uint16_t packetsMax;	// Most packets added in one transmit handler call
+	uint16_t noTxPackets;	// Radio packet buffers full (BLE_ERROR_NO_TX_PACKETS)
+	uint16_t queueHighWater;// Most data waiting in the out queue
+	uint16_t droppedBatches;// Stream batches not sent, no queue space
+	uint16_t rejectedPushes;// Queue additions not fully added
+	uint16_t reserved;
+} BleSerialStats_t;
+
 // Global variables, mainly for debug 
 // Instance of the nordic uart service and other variables
 extern ble_nus_t m_nus;	
 extern void (*ble_serial_user_cb)(void);
 extern volatile bool serial_in_queue_flag;
+extern volatile bool serial_out_queue_flag;
 extern uint8_t serial_out_send_record[];
 extern uint8_t ble_tx_queue_max_len, serial_out_send_record_tail_index, serial_out_pending_count;
 // The serial data buffers 
@@ -17,12 +68,33 @@ extern uint8_t serial_out_buffer[];
 // The serial fifo queues
 extern queue_t serial_in_queue;
 extern queue_t serial_out_queue;
+extern queue_t serial_control_queue;
+// Link statistics
+extern BleSerialStats_t ble_serial_stats;
 
 // Function prototypes
 // Call from services initialise to setup buffered serial service operation
 void ble_serial_service_init(void);
 // Add data to the outgoing serial buffer - returns the added segment length (or max available space for NULL pointer)
 uint16_t ble_serial_service_send(const uint8_t* data_buffer, uint16_t data_len);
+// Add data to the out queue (bulk data, not checked for connection) - returns the added length
+uint16_t ble_serial_out_push(const void* data, uint16_t data_len);
+// Add a command reply to the control queue, sent ahead of bulk data - returns the added length (zero if it does not all fit)
+uint16_t ble_serial_control_send(const uint8_t* data_buffer, uint16_t data_len);
+// Mark the start of a bulk data frame or text line at the out queue tail, replies may be sent here
+void ble_serial_out_boundary(void);
+// Outgoing data waiting to be sent, queued and in regions
+uint32_t ble_serial_out_pending(void);
+// Add a binary frame header to the outgoing buffer if the full payload will also fit - returns header length added (or zero)
+uint16_t ble_serial_frame_header(uint8_t type, uint16_t payload_len);
+// Add a binary frame of prefix data (copied) followed by a constant region (not copied) - returns the total frame length (or zero)
+uint16_t ble_serial_frame_region(uint8_t type, const void* prefix, uint16_t prefix_len, const uint8_t* data, uint16_t data_len);
+// Start a binary frame of up to limit payload bytes - returns false if not connected or no room
+bool ble_serial_frame_begin(BleFrameWriter_t* frame, uint8_t type, uint16_t limit);
+// Add payload to a started frame - returns the length added
+uint16_t ble_serial_frame_write(BleFrameWriter_t* frame, const void* data, uint16_t length);
+// Set the frame header and release the frame to be sent - returns the total frame length
+uint16_t ble_serial_frame_end(BleFrameWriter_t* frame);
 // Check input serial buffer for input data and/or extract it - returns copied length (or count received for NULL pointer)
 uint16_t ble_serial_service_receive(uint8_t* data_buffer, uint16_t data_len);
 // SoftDevice event handler, called for all BLE events to handle connection changes and serial tasks
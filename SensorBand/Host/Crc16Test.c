@@ -0,0 +1,130 @@
+// Crc16Ccitt test against a bitwise reference, a dump verifier and the check cost per block
+//	Crc16Test				Self test on random blocks
+//	Crc16Test <dump.bin>	Check every written 512 byte block of an epoch store dump
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Crc16.h"
+#include "HostBoard.h"
+#include "FrameDecode.h"
+
+// Definitions
+#define CRC_TEST_DUMP_SIZE		(64ul * 1024)	// Self test dump, the largest store read at once
+#define CRC_TEST_REPEAT			200				// Passes over the dump for the timing
+
+// Globals
+static uint8_t dump[CRC_TEST_DUMP_SIZE];
+
+// Prototypes
+static uint16_t CrcTestReference(const uint8_t* data, uint32_t length, uint16_t crc);
+static uint32_t CrcTestVerify(const uint8_t* data, uint32_t length, uint32_t* written);
+
+// Source
+int main(int argc, char* argv[])
+{
+	uint32_t failures = 0, length, offset, index, written, bad;
+	clock_t start;
+	double seconds;
+	volatile uint32_t sink = 0;
+
+	// Check value of the CRC-16/CCITT-FALSE catalogue entry
+	if(Crc16Ccitt("123456789", 9, CRC16_CCITT_INIT) != 0x29B1)
+		failures++;
+	// Random lengths and split points against the bitwise form
+	HostRandomSeed(6);
+	for(index = 0; index < sizeof(dump); index++)
+		dump[index] = (uint8_t)HostRandom();
+	for(index = 0; index < 20000; index++)
+	{
+		length = HostRandom() % 1024;
+		offset = HostRandom() % (sizeof(dump) - length);
+		written = HostRandom() % (length + 1);
+		if(Crc16Ccitt(&dump[offset + written], length - written, Crc16Ccitt(&dump[offset], written, CRC16_CCITT_INIT)) !=
+			CrcTestReference(&dump[offset], length, CRC16_CCITT_INIT))
+			failures++;
+	}
+	printf("CRC-16/CCITT against the bitwise form: %s\n", (failures == 0) ? "ok" : "FAILED");
+
+	// A dump to check, or random written blocks with a few corrupt
+	if(argc > 1)
+	{
+		FILE* file = fopen(argv[1], "rb");
+		if(file == NULL)
+		{
+			fprintf(stderr, "Cannot open %s\n", argv[1]);
+			return 1;
+		}
+		length = fread(dump, 1, sizeof(dump), file);
+		fclose(file);
+		bad = CrcTestVerify(dump, length, &written);
+		printf("%s: %u blocks, %u written, %u bad\n", argv[1], (unsigned int)(length / EPOCH_NVM_BLOCK_SIZE), (unsigned int)written, (unsigned int)bad);
+		return ((failures == 0) && (bad == 0)) ? 0 : 1;
+	}
+	length = sizeof(dump);
+	for(offset = 0; offset < length; offset += EPOCH_NVM_BLOCK_SIZE)
+	{
+		Epoch_block_t* block = (Epoch_block_t*)&dump[offset];
+		block->info.block_number = offset / EPOCH_NVM_BLOCK_SIZE;
+		block->blockFormat = BLOCK_FORMAT_EPOCH_DATAv3 | BLOCK_FORMAT_CHECK_CRC16;
+		block->check = Crc16Ccitt(block, offsetof(Epoch_block_t, check), CRC16_CCITT_INIT);
+	}
+	dump[1000] ^= 0x01;
+	dump[20000] ^= 0x80;
+	dump[length - 3] ^= 0x10;
+	bad = CrcTestVerify(dump, length, &written);
+	if(bad != 3)
+		failures++;
+	printf("Self test dump: %u blocks, %u bad of 3 corrupted: %s\n", (unsigned int)written, (unsigned int)bad, (bad == 3) ? "ok" : "FAILED");
+
+	// Cost per block, table and bitwise
+	start = clock();
+	for(index = 0; index < CRC_TEST_REPEAT; index++)
+		sink += CrcTestVerify(dump, length, &written);
+	seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	printf("Verify %uKB: %.0f MB/s, %.0f ns per block on the host\n", (unsigned int)(length / 1024), (CRC_TEST_REPEAT * (length / 1e6)) / seconds,
+		(seconds * 1e9) / (CRC_TEST_REPEAT * (length / EPOCH_NVM_BLOCK_SIZE)));
+	start = clock();
+	for(index = 0; index < CRC_TEST_REPEAT; index++)
+	{
+		for(offset = 0; offset < length; offset += EPOCH_NVM_BLOCK_SIZE)
+			sink += CrcTestReference(&dump[offset], offsetof(Epoch_block_t, check), CRC16_CCITT_INIT);
+	}
+	printf("Bitwise form: %.0f ns per block on the host\n",
+		((double)(clock() - start) / CLOCKS_PER_SEC * 1e9) / (CRC_TEST_REPEAT * (length / EPOCH_NVM_BLOCK_SIZE)));
+	return (failures == 0) ? 0 : 1;
+}
+
+// Bit at a time, from the polynomial
+static uint16_t CrcTestReference(const uint8_t* data, uint32_t length, uint16_t crc)
+{
+	uint8_t bit;
+	while(length-- > 0)
+	{
+		crc ^= (uint16_t)*data++ << 8;
+		for(bit = 0; bit < 8; bit++)
+			crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+	}
+	return crc;
+}
+
+// Check the written blocks, erased blocks are skipped - returns the bad block count
+static uint32_t CrcTestVerify(const uint8_t* data, uint32_t length, uint32_t* written)
+{
+	uint32_t offset, bad = 0;
+	*written = 0;
+	for(offset = 0; (offset + EPOCH_NVM_BLOCK_SIZE) <= length; offset += EPOCH_NVM_BLOCK_SIZE)
+	{
+		const Epoch_block_t* block = (const Epoch_block_t*)&data[offset];
+		if(block->info.block_number > EPOCH_BLOCK_NUMBER_LAST)
+			continue;
+		(*written)++;
+		if(!FrameDecodeBlockCheck(block))
+			bad++;
+	}
+	return bad;
+}
+//EOF
@@ -0,0 +1,334 @@
+// EpochCalc square root against the bit by bit form, the epoch energy of typical movement and a cycle estimate
+// EpochAddBatch() of FIFO batches against EpochAdd() of each sample, the same state and the host time of each
+//	EpochCalcTest				Square root at every rounding boundary, epoch energy of synthetic movement
+//	EpochCalcTest <samples.bin>	Also a recording of accel_t samples (int16_t x, y, z little endian, 50Hz)
+//	EpochCalcTest -all			Also every 32 bit square root input (slow)
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "EpochCalc.h"
+#include "HostBoard.h"
+
+// Definitions
+#define CALC_TEST_RATE			ACCEL_DEFAULT_RATE
+#define CALC_TEST_EPOCH			(60ul * CALC_TEST_RATE)			// Samples per minute epoch
+#define CALC_TEST_SAMPLES		(60ul * CALC_TEST_EPOCH)		// An hour of each movement
+#define CALC_TEST_RANDOM		(1ul << 24)						// Random 32 bit square root inputs
+#define CALC_TEST_CLOCK			16e6							// nRF51 CPU clock
+#define CALC_TEST_BATCH			ACCEL_FIFO_WATERMARK			// Samples per FIFO batch
+#define CALC_TEST_REPEAT		10								// Passes over the samples for the batch timing
+#define CALC_TEST_BATCH_MAX		0xFFFF							// Largest EpochAddBatch() count
+// Rough Cortex-M0 cycles (single cycle multiply) from the loop counts of each square root
+#define CALC_CYCLES_TABLE(_steps)				(29 + (8 * (_steps)))
+#define CALC_CYCLES_BITWISE(_shifts, _steps)	(12 + (5 * (_shifts)) + (10 * (_steps)))
+
+// Globals
+static accel_t samples[CALC_TEST_SAMPLES];
+static uint32_t failures;
+
+// Prototypes
+static uint32_t CalcTestReference(uint32_t input, uint32_t* cycles);
+static uint32_t CalcTestCycles(uint32_t input);
+static void CalcTestMovement(uint32_t count, double amplitude, double frequency);
+static void CalcTestGait(uint32_t count, double cadence, double impact);
+static void CalcTestEnergy(const char* name, uint32_t count);
+static void CalcTestBatch(const char* name, uint32_t count, bool steps);
+static void CalcTestFullScale(void);
+static void CalcTestFail(const char* reason, uint32_t value);
+
+// Source
+int main(int argc, char* argv[])
+{
+	uint32_t root, input, index, cycles;
+	bool all = false;
+	const char* recording = NULL;
+
+	for(index = 1; index < (uint32_t)argc; index++)
+	{
+		if(strcmp(argv[index], "-all") == 0)
+			all = true;
+		else
+			recording = argv[index];
+	}
+
+	// Every 16 bit input, both sides of every rounding boundary (n^2 + n) and the largest inputs
+	for(input = 0; input <= 0xFFFF; input++)
+	{
+		if(SquareRootRounded(input) != CalcTestReference(input, &cycles))
+			CalcTestFail("16 bit input", input);
+	}
+	for(root = 0; root <= 0xFFFF; root++)
+	{
+		for(input = (root * root) + root - (root > 0); input <= (root * root) + root + 1; input++)
+		{
+			if(SquareRootRounded(input) != CalcTestReference(input, &cycles))
+				CalcTestFail("rounding boundary", input);
+		}
+	}
+	HostRandomSeed(24);
+	for(index = 0; index < CALC_TEST_RANDOM; index++)
+	{
+		input = HostRandom() >> (HostRandom() % 32);
+		if(SquareRootRounded(input) != CalcTestReference(input, &cycles))
+			CalcTestFail("random input", input);
+	}
+	input = 0xFFFFFFFFul;
+	if(SquareRootRounded(input) != CalcTestReference(input, &cycles))
+		CalcTestFail("largest input", input);
+	if(all)
+	{
+		input = 0;
+		do {
+			if(SquareRootRounded(input) != CalcTestReference(input, &cycles))
+				CalcTestFail("32 bit input", input);
+		} while(++input != 0);
+	}
+	printf("Square root against the bit by bit form, %s: %s\n", all ? "every 32 bit input" : "16 bit, boundaries and random inputs",
+		(failures == 0) ? "ok" : "FAILED");
+
+	// Epoch energy and the cost of each square root form
+	printf("Minute epochs at %uHz, energy against the bit by bit form, M0 cycles per sample estimate and host time:\n", CALC_TEST_RATE);
+	CalcTestMovement(CALC_TEST_SAMPLES, 0.0, 0.0);
+	CalcTestEnergy("still", CALC_TEST_SAMPLES);
+	CalcTestGait(CALC_TEST_SAMPLES, 1.8, 0.8);
+	CalcTestEnergy("walking", CALC_TEST_SAMPLES);
+	CalcTestMovement(CALC_TEST_SAMPLES, 1.2, 2.8);
+	CalcTestEnergy("running", CALC_TEST_SAMPLES);
+
+	// The same samples in FIFO batches and one at a time
+	printf("EpochAddBatch() of %u sample batches against EpochAdd() of each sample, host time per sample:\n", CALC_TEST_BATCH);
+	CalcTestMovement(CALC_TEST_SAMPLES, 0.0, 0.0);
+	CalcTestBatch("still", CALC_TEST_SAMPLES, false);
+	CalcTestGait(CALC_TEST_SAMPLES, 1.8, 0.8);
+	CalcTestBatch("walking", CALC_TEST_SAMPLES, true);
+	CalcTestMovement(CALC_TEST_SAMPLES, 1.2, 2.8);
+	CalcTestBatch("running", CALC_TEST_SAMPLES, true);
+	CalcTestFullScale();
+	if(recording != NULL)
+	{
+		FILE* file = fopen(recording, "rb");
+		if(file == NULL)
+		{
+			fprintf(stderr, "Cannot open %s\n", recording);
+			return 1;
+		}
+		index = fread(samples, sizeof(accel_t), CALC_TEST_SAMPLES, file);
+		fclose(file);
+		CalcTestEnergy(recording, index);
+		CalcTestBatch(recording, index, false);
+	}
+	return (failures == 0) ? 0 : 1;
+}
+
+// The bit by bit form (EE_SQRT_BITWISE), with its cycle estimate
+static uint32_t CalcTestReference(uint32_t input, uint32_t* cycles)
+{
+	uint32_t op = input, res = 0, one = 1ul << 30, shifts = 0, steps = 0;
+	while(one > op)
+	{
+		one >>= 2;
+		shifts++;
+	}
+	while(one != 0)
+	{
+		if(op >= res + one)
+		{
+			op = op - (res + one);
+			res = res + 2 * one;
+		}
+		res >>= 1;
+		one >>= 2;
+		steps++;
+	}
+	if(op > res)
+		res++;
+	*cycles = CALC_CYCLES_BITWISE(shifts, steps);
+	return res;
+}
+
+// Cycle estimate of SquareRootRounded(), from its shift down and the bits left to find
+static uint32_t CalcTestCycles(uint32_t input)
+{
+	uint8_t k = 0;
+	if(input >= 0x01000000ul) { input >>= 8; k += 4; }
+	if(input >= 0x00100000ul) { input >>= 4; k += 2; }
+	if(input >= 0x00040000ul) { input >>= 2; k += 1; }
+	if(input >= 0x00010000ul) { input >>= 2; k += 1; }
+	return CALC_CYCLES_TABLE((k != 0) ? (k + 1) : 5);
+}
+
+// Gravity turning slowly, a periodic movement on top and sensor noise, as read from the FIFO (+/-8g, 1g is 4096)
+static void CalcTestMovement(uint32_t count, double amplitude, double frequency)
+{
+	uint32_t index;
+	double t, angle;
+	HostRandomSeed(25);
+	for(index = 0; index < count; index++)
+	{
+		t = (double)index / CALC_TEST_RATE;
+		angle = 0.3 * sin(t / 20.0) + amplitude * 0.2 * sin(2 * M_PI * frequency * t / 2);
+		samples[index].x = (int16_t)(16 * (lround(250 * (sin(angle) + amplitude * 0.5 * sin(2 * M_PI * frequency * t + 1.0))) + (int32_t)(HostRandom() % 5) - 2));
+		samples[index].y = (int16_t)(16 * (lround(250 * (0.2 * cos(t / 30.0) + amplitude * 0.3 * sin(2 * M_PI * frequency * t / 2))) + (int32_t)(HostRandom() % 5) - 2));
+		samples[index].z = (int16_t)(16 * (lround(250 * (cos(angle) + amplitude * sin(2 * M_PI * frequency * t))) + (int32_t)(HostRandom() % 5) - 2));
+	}
+}
+
+// Walking, a heel strike at each step (impact in g) on gravity, a sway at half the cadence and sensor noise
+static void CalcTestGait(uint32_t count, double cadence, double impact)
+{
+	uint32_t index;
+	double t, phase, strike;
+	HostRandomSeed(26);
+	for(index = 0; index < count; index++)
+	{
+		t = (double)index / CALC_TEST_RATE;
+		phase = fmod(t * cadence, 1.0);
+		strike = (phase < 0.2) ? impact * sin(M_PI * phase / 0.2) : 0.0;
+		samples[index].x = (int16_t)(16 * (lround(250 * (0.2 + 0.1 * sin(M_PI * cadence * t) + 0.3 * strike)) + (int32_t)(HostRandom() % 5) - 2));
+		samples[index].y = (int16_t)(16 * (lround(250 * (0.1 * cos(M_PI * cadence * t))) + (int32_t)(HostRandom() % 5) - 2));
+		samples[index].z = (int16_t)(16 * (lround(250 * (1.0 + strike)) + (int32_t)(HostRandom() % 5) - 2));
+	}
+}
+
+// Epoch energy of the firmware against the same filter with the bit by bit root, and the cost of each root
+static void CalcTestEnergy(const char* name, uint32_t count)
+{
+	int32_t xdc, ydc, zdc, x, y, z;
+	uint32_t index, input, cycles, epochs = 0, different = 0;
+	uint64_t reference = 0, start, tableCycles = 0, bitwiseCycles = 0;
+	static uint32_t inputs[CALC_TEST_SAMPLES];
+	clock_t time;
+	double tableTime, bitwiseTime;
+	volatile uint32_t sink = 0;
+	if(count < CALC_TEST_EPOCH)
+		return;
+	EpochInit(&samples[0]);
+	PedInit(PED_ONE_G_VALUE);
+	xdc = x_dc;
+	ydc = y_dc;
+	zdc = z_dc;
+	start = eepoch_sum;
+	for(index = 0; index < count; index++)
+	{
+		EpochAdd(&samples[index]);
+		// The filter of CalcSvm()
+		xdc = xdc - (xdc >> EE_LPF_SHIFT) + samples[index].x;
+		ydc = ydc - (ydc >> EE_LPF_SHIFT) + samples[index].y;
+		zdc = zdc - (zdc >> EE_LPF_SHIFT) + samples[index].z;
+		x = samples[index].x - (xdc >> EE_LPF_SHIFT);
+		y = samples[index].y - (ydc >> EE_LPF_SHIFT);
+		z = samples[index].z - (zdc >> EE_LPF_SHIFT);
+		input = ((uint32_t)x * (uint32_t)x) + ((uint32_t)y * (uint32_t)y) + ((uint32_t)z * (uint32_t)z);
+		inputs[index] = input;
+		reference += CalcTestReference(input, &cycles);
+		bitwiseCycles += cycles;
+		tableCycles += CalcTestCycles(input);
+		// Compare each whole epoch
+		if(((index + 1) % CALC_TEST_EPOCH) == 0)
+		{
+			if((eepoch_sum - start) != reference)
+				different++;
+			epochs++;
+			start = eepoch_sum;
+			reference = 0;
+		}
+	}
+	if(different > 0)
+		CalcTestFail(name, different);
+	// Host time of the roots of the samples
+	count = epochs * CALC_TEST_EPOCH;
+	time = clock();
+	for(index = 0; index < count; index++)
+		sink += SquareRootRounded(inputs[index]);
+	tableTime = (double)(clock() - time) / CLOCKS_PER_SEC;
+	time = clock();
+	for(index = 0; index < count; index++)
+		sink += CalcTestReference(inputs[index], &cycles);
+	bitwiseTime = (double)(clock() - time) / CLOCKS_PER_SEC;
+	printf("  %-10s %4u epochs, %u different, cycles table %3.0f bitwise %3.0f (%.1f%% and %.1f%% of the CPU at 400Hz), host %.1f ns and %.1f ns\n",
+		name, (unsigned int)epochs, (unsigned int)different, (double)tableCycles / count, (double)bitwiseCycles / count,
+		(100.0 * 400 * tableCycles) / (count * CALC_TEST_CLOCK), (100.0 * 400 * bitwiseCycles) / (count * CALC_TEST_CLOCK),
+		(tableTime * 1e9) / count, (bitwiseTime * 1e9) / count);
+}
+
+// Batches and single samples from the same start must leave the same filter, energy and pedometer state, and
+// movement with steps must count some
+static void CalcTestBatch(const char* name, uint32_t count, bool steps)
+{
+	int32_t dc[3];
+	uint64_t sum;
+	uint32_t index, repeat, added, counted;
+	PedState_t ped;
+	clock_t time;
+	double sampleTime, batchTime;
+	bool same;
+	count -= count % CALC_TEST_BATCH;
+	if(count == 0)
+		return;
+	EpochInit(&samples[0]);
+	PedInit(PED_ONE_G_VALUE);
+	time = clock();
+	for(repeat = 0; repeat < CALC_TEST_REPEAT; repeat++)
+	{
+		for(index = 0; index < count; index++)
+			EpochAdd(&samples[index]);
+	}
+	sampleTime = (double)(clock() - time) / CLOCKS_PER_SEC;
+	dc[0] = x_dc;
+	dc[1] = y_dc;
+	dc[2] = z_dc;
+	sum = eepoch_sum;
+	added = sample_count;
+	ped = pedState;
+	counted = pedState.total;
+	EpochInit(&samples[0]);
+	PedInit(PED_ONE_G_VALUE);
+	time = clock();
+	for(repeat = 0; repeat < CALC_TEST_REPEAT; repeat++)
+	{
+		for(index = 0; index < count; index += CALC_TEST_BATCH)
+			EpochAddBatch(&samples[index], CALC_TEST_BATCH);
+	}
+	batchTime = (double)(clock() - time) / CLOCKS_PER_SEC;
+	same = (dc[0] == x_dc) && (dc[1] == y_dc) && (dc[2] == z_dc) && (sum == eepoch_sum) && (added == sample_count) &&
+		(counted == pedState.total) && (memcmp(&ped, &pedState, sizeof(PedState_t)) == 0);
+	if(!same)
+		CalcTestFail(name, count);
+	if(steps && (counted == 0))
+		CalcTestFail("no steps", count);
+	printf("  %-10s %7u samples, %5u steps, state %s, per sample %.1f ns, batch %.1f ns (%.2f)\n", name, (unsigned int)count,
+		(unsigned int)(pedState.total / CALC_TEST_REPEAT), same ? "same" : "DIFFERENT", (sampleTime * 1e9) / (CALC_TEST_REPEAT * count),
+		(batchTime * 1e9) / (CALC_TEST_REPEAT * count), batchTime / sampleTime);
+}
+
+// The largest batch of full scale samples, every axis changing sign each sample, sums without overflow
+static void CalcTestFullScale(void)
+{
+	uint64_t sum;
+	uint32_t index;
+	for(index = 0; index < CALC_TEST_BATCH_MAX; index++)
+		samples[index].x = samples[index].y = samples[index].z = (index & 1) ? INT16_MIN : INT16_MAX;
+	EpochInit(&samples[0]);
+	PedInit(PED_ONE_G_VALUE);
+	for(index = 0; index < CALC_TEST_BATCH_MAX; index++)
+		EpochAdd(&samples[index]);
+	sum = eepoch_sum;
+	EpochInit(&samples[0]);
+	PedInit(PED_ONE_G_VALUE);
+	EpochAddBatch(samples, CALC_TEST_BATCH_MAX);
+	if(eepoch_sum != sum)
+		CalcTestFail("full scale batch", CALC_TEST_BATCH_MAX);
+	printf("Batch of %u full scale samples, energy %llu (%.0f%% of 32 bits): %s\n", CALC_TEST_BATCH_MAX, (unsigned long long)sum,
+		(100.0 * sum) / 4294967296.0, (eepoch_sum == sum) ? "ok" : "FAILED");
+}
+
+static void CalcTestFail(const char* reason, uint32_t value)
+{
+	if(failures++ < 10)
+		fprintf(stderr, "Failed: %s (%u)\n", reason, (unsigned int)value);
+}
+//EOF
@@ -0,0 +1,213 @@
+// EpochCodec round trip test, compression of typical epochs and the encode cost per block
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "EpochCodec.h"
+#include "HostBoard.h"
+
+// Definitions
+#define CODEC_TEST_BLOCK		60			// Samples in a block of fixed samples (EPOCH_BLOCK_DATA_COUNT)
+#define CODEC_TEST_SAMPLES		2000		// Samples per random sequence
+#define CODEC_TEST_SEQUENCES	2000
+#define CODEC_TEST_DAYS			30			// Typical data for the compression figures
+#define CODEC_TEST_REPEAT		20000		// Blocks encoded for the timing
+#define CODEC_TEST_DATA_START	30			// Block offset of the stored records, padded to flash words from here
+
+// Globals
+static uint8_t samples[CODEC_TEST_DAYS * 24 * 60][EPOCH_CODEC_SAMPLE_LEN];
+static uint8_t encoded[EPOCH_CODEC_MAX_LEN(CODEC_TEST_DAYS * 24 * 60) + EPOCH_CODEC_RECORD_MAX];
+static uint32_t failures;
+
+// Prototypes
+static void CodecTestSequence(uint32_t count, uint8_t style);
+static uint32_t CodecTestEncode(uint32_t count, bool records, bool pad);
+static bool CodecTestDecode(uint32_t count, uint32_t length);
+static void CodecTestFail(const char* reason, uint32_t sequence);
+
+// Source
+int main(int argc, char* argv[])
+{
+	uint32_t sequence, length, block, count, transfer, stored, padded;
+	clock_t start;
+	double seconds;
+	volatile uint32_t sink = 0;
+	EpochCodec_t codec;
+	uint8_t record[EPOCH_CODEC_RECORD_MAX + 1];
+	const uint8_t* source;
+
+	// Random sequences in both modes, each must decode to the same samples in the encoded length
+	HostRandomSeed(1);
+	for(sequence = 0; sequence < CODEC_TEST_SEQUENCES; sequence++)
+	{
+		count = 1 + (HostRandom() % CODEC_TEST_SAMPLES);
+		CodecTestSequence(count, sequence % 4);
+		length = CodecTestEncode(count, false, false);
+		if(length > EPOCH_CODEC_MAX_LEN(count))
+			CodecTestFail("transfer encoding longer than the limit", sequence);
+		if(!CodecTestDecode(count, length))
+			CodecTestFail("transfer encoding round trip", sequence);
+		length = CodecTestEncode(count, true, true);
+		if(!CodecTestDecode(count, length))
+			CodecTestFail("padded record encoding round trip", sequence);
+		length = CodecTestEncode(count, true, false);
+		if(length > EPOCH_CODEC_MAX_LEN(count))
+			CodecTestFail("record encoding longer than the limit", sequence);
+		if(!CodecTestDecode(count, length))
+			CodecTestFail("record encoding round trip", sequence);
+		// A cut short encoding must fail, not read past the end
+		if(length > 0)
+		{
+			EpochCodecInit(&codec);
+			source = encoded;
+			for(block = 0; block < count; block++)
+			{
+				if(!EpochCodecDecode(&codec, &source, encoded + length - 1, record))
+					break;
+			}
+			if(block >= count)
+				CodecTestFail("short record encoding decoded", sequence);
+		}
+	}
+	// Erased flash is never a valid record
+	memset(encoded, 0xFF, sizeof(encoded));
+	EpochCodecInit(&codec);
+	source = encoded;
+	if(EpochCodecDecode(&codec, &source, encoded + 16, record))
+		CodecTestFail("erased flash decoded", 0);
+	printf("Round trip of %u random sequences: %s\n", CODEC_TEST_SEQUENCES, (failures == 0) ? "ok" : "FAILED");
+
+	// Compression of typical minute epochs, per block of fixed samples
+	HostRandomSeed(12345);
+	count = CODEC_TEST_DAYS * 24 * 60;
+	for(sequence = 0; sequence < count; sequence++)
+		HostEpochSample(sequence, samples[sequence]);
+	transfer = 0;
+	stored = 0;
+	padded = 0;
+	for(block = 0; (block + CODEC_TEST_BLOCK) <= count; block += CODEC_TEST_BLOCK)
+	{
+		EpochCodecInit(&codec);
+		for(sequence = block; sequence < (block + CODEC_TEST_BLOCK); sequence++)
+			transfer += EpochCodecEncode(&codec, samples[sequence], record);
+		transfer += EpochCodecFlush(&codec, record);
+		EpochCodecInit(&codec);
+		for(sequence = block; sequence < (block + CODEC_TEST_BLOCK); sequence++)
+		{
+			length = EpochCodecRecord(&codec, samples[sequence], record);
+			stored += length;
+			// Each epoch is committed to flash at once, padded to the end of the word
+			padded = ((CODEC_TEST_DATA_START + padded + length + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1)) - CODEC_TEST_DATA_START;
+		}
+	}
+	printf("%u days of minute epochs, %u bytes raw\n", CODEC_TEST_DAYS, (unsigned int)(block * EPOCH_CODEC_SAMPLE_LEN));
+	printf("  transfer (runs)    %7u bytes, %.2f bytes per epoch, ratio %.2f\n", (unsigned int)transfer,
+		(double)transfer / block, (double)(block * EPOCH_CODEC_SAMPLE_LEN) / transfer);
+	printf("  stored (records)   %7u bytes, %.2f bytes per epoch, ratio %.2f\n", (unsigned int)stored,
+		(double)stored / block, (double)(block * EPOCH_CODEC_SAMPLE_LEN) / stored);
+	printf("  flash (padded)     %7u bytes, %.2f bytes per epoch, ratio %.2f\n", (unsigned int)padded,
+		(double)padded / block, (double)(block * EPOCH_CODEC_SAMPLE_LEN) / padded);
+
+	// Encode cost of a block, host time for comparing changes (not the M0 cycle count)
+	start = clock();
+	for(sequence = 0; sequence < CODEC_TEST_REPEAT; sequence++)
+	{
+		block = (sequence % ((count / CODEC_TEST_BLOCK) - 1)) * CODEC_TEST_BLOCK;
+		EpochCodecInit(&codec);
+		for(length = 0; length < CODEC_TEST_BLOCK; length++)
+			sink += EpochCodecEncode(&codec, samples[block + length], record);
+		sink += EpochCodecFlush(&codec, record);
+	}
+	seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	printf("Encode %u samples: %.0f ns per block on the host\n", CODEC_TEST_BLOCK, (seconds * 1e9) / CODEC_TEST_REPEAT);
+	return (failures == 0) ? 0 : 1;
+}
+
+// Random samples: repeats with long runs, small changes, large changes, or random bytes
+static void CodecTestSequence(uint32_t count, uint8_t style)
+{
+	uint32_t index, energy;
+	uint8_t byte;
+	memset(samples[0], 0, EPOCH_CODEC_SAMPLE_LEN);
+	for(index = 0; index < count; index++)
+	{
+		if(index > 0)
+			memcpy(samples[index], samples[index - 1], EPOCH_CODEC_SAMPLE_LEN);
+		switch(style)
+		{
+			case 0:
+				// Mostly repeated, runs longer than the longest run record
+				if((HostRandom() % 300) != 0)
+					break;
+				// Otherwise a small change
+			case 1:
+				// Small changes of a few fields
+				for(byte = 0; byte < 4; byte++)
+				{
+					if((HostRandom() % 3) == 0)
+						samples[index][byte] += (HostRandom() % 5) - 2;
+				}
+				memcpy(&energy, &samples[index][4], sizeof(uint32_t));
+				energy += (HostRandom() % 64) - 32;
+				memcpy(&samples[index][4], &energy, sizeof(uint32_t));
+				break;
+			case 2:
+				// Large changes, energy wraps
+				samples[index][0] ^= 0x80;
+				samples[index][1] = (uint8_t)HostRandom();
+				energy = HostRandom() | 0x80000000ul;
+				memcpy(&samples[index][4], &energy, sizeof(uint32_t));
+				break;
+			default:
+				for(byte = 0; byte < EPOCH_CODEC_SAMPLE_LEN; byte++)
+					samples[index][byte] = (uint8_t)HostRandom();
+				break;
+		}
+	}
+}
+
+// Encode a sequence as one block, runs or single records (padded to words as in flash) - returns the length
+static uint32_t CodecTestEncode(uint32_t count, bool records, bool pad)
+{
+	EpochCodec_t codec;
+	uint32_t index, length = 0;
+	uint8_t written;
+	EpochCodecInit(&codec);
+	for(index = 0; index < count; index++)
+	{
+		written = records ? EpochCodecRecord(&codec, samples[index], &encoded[length]) : EpochCodecEncode(&codec, samples[index], &encoded[length]);
+		if(written > EPOCH_CODEC_RECORD_MAX + 1)
+			CodecTestFail("record longer than the limit", index);
+		length += written;
+		while(pad && (((CODEC_TEST_DATA_START + length) % sizeof(uint32_t)) != 0))
+			encoded[length++] = EPOCH_CODEC_PAD;
+	}
+	return length + EpochCodecFlush(&codec, &encoded[length]);
+}
+
+static bool CodecTestDecode(uint32_t count, uint32_t length)
+{
+	EpochCodec_t codec;
+	const uint8_t* source = encoded;
+	uint8_t sample[EPOCH_CODEC_SAMPLE_LEN];
+	uint32_t index;
+	EpochCodecInit(&codec);
+	for(index = 0; index < count; index++)
+	{
+		if(!EpochCodecDecode(&codec, &source, encoded + length, sample) || (memcmp(sample, samples[index], EPOCH_CODEC_SAMPLE_LEN) != 0))
+			return false;
+	}
+	// Padding after the last record fills its flash word
+	while((source < (encoded + length)) && (*source == EPOCH_CODEC_PAD))
+		source++;
+	return (source == (encoded + length)) && (codec.run == 0);
+}
+
+static void CodecTestFail(const char* reason, uint32_t sequence)
+{
+	if(failures++ < 10)
+		fprintf(stderr, "Failed: %s (%u)\n", reason, (unsigned int)sequence);
+}
+//EOF
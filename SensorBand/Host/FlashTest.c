@@ -0,0 +1,380 @@
+// Epoch store flash cost against the old update path, and a random test of epochs, erases and resets
+//	FlashTest				Cost of 30 days of epochs, the daily totals across resets, the update from the old layout,
+//							then the random test
+//	FlashTest <rounds>		Random test length, each round adds an epoch, resets or erases
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pstorage.h"
+#include "acc_tasks.h"
+#include "EpochCompact.h"
+#include "DailyRollup.h"
+#include "HostBoard.h"
+#include "HostFlash.h"
+
+// Definitions
+#define FLASH_TEST_DAYS			30
+#define FLASH_TEST_DAILY_DAYS	4			// Days of the daily totals test, with a cold reset every few hours
+#define FLASH_TEST_OLD_SIZE		(64ul * 1024)	// Epoch region of firmware before 2.0, ending at its settings page (now the second)
+#define FLASH_TEST_OLD_START	(HOST_FLASH_SIZE - (3 * PSTORAGE_FLASH_PAGE_SIZE) - FLASH_TEST_OLD_SIZE)
+#define FLASH_TEST_DATA_SIZE	(EPOCH_NVM_SIZE_TOTAL + EPOCH_ERASE_NVM_SIZE + EPOCH_COMPACT_NVM_SIZE + DAILY_NVM_SIZE_TOTAL)
+#define FLASH_TEST_ROUNDS		200000ul	// Random test rounds by default
+#define FLASH_TEST_ERASE_MS		22.3		// nRF51 page erase, most
+#define FLASH_TEST_WRITE_MS		0.0463		// nRF51 word write, most
+
+// Globals
+static uint32_t flashTestCounter;			// Epoch count, stored in each epoch to check the order
+static uint32_t flashTestFirst;				// Oldest epoch count that may be visible
+static uint32_t flashTestLast;				// Newest epoch count seen by the last check
+static uint32_t failures;
+
+// Prototypes
+static void FlashTestReport(const char* name, uint32_t epochs);
+static void FlashTestLegacy(uint32_t epochs);
+static void FlashTestRings(void);
+static uint32_t FlashTestDaily(void);
+static bool FlashTestDailyInit(void);
+static void FlashTestLayout(void);
+static void FlashTestReset(bool warm);
+static void FlashTestAdd(void);
+static uint32_t FlashTestCheck(uint32_t first, uint32_t round);
+static uint16_t FlashTestJournal(void);
+static void FlashTestFail(const char* reason, uint32_t round);
+
+// Source
+int main(int argc, char* argv[])
+{
+	Epoch_sample_t epoch;
+	uint32_t minute, rounds = FLASH_TEST_ROUNDS, round, action, first, resets = 0, erases = 0;
+	uint16_t boundary;
+
+	// Typical epochs through the logger, each written as it is added
+	HostFlashInit();
+	HostRandomSeed(12345);
+	settings.epochPeriod = 60;
+	if(!AccelEpochLoggerInit())
+		return 1;
+	HostFlashRunAll();
+	HostFlashCountersClear();
+	for(minute = 0; minute < (FLASH_TEST_DAYS * 24 * 60); minute++)
+	{
+		HostEpochSample(minute, epoch.b);
+		status.epochCloseTime = 1500000000ul + (minute * 60);
+		AccelPstorageAddEpoch(&epoch);
+		HostFlashRunAll();
+	}
+	FlashTestRings();
+	printf("%u days of minute epochs, per day:\n", FLASH_TEST_DAYS);
+	printf("%-16s %8s %8s %8s %8s %8s\n", "Path", "Erases", "Words", "Stores", "Updates", "Busy ms");
+	FlashTestReport("append", minute);
+	// The old path, an update of each full block of fixed samples
+	FlashTestLegacy(minute);
+	FlashTestReport("pstorage_update", minute);
+
+	// Today's totals are rebuilt from the stored epochs after a cold reset
+	round = FlashTestDaily();
+	printf("Daily totals of %u days across %u cold resets: %s\n", FLASH_TEST_DAILY_DAYS, (unsigned int)round, (failures == 0) ? "ok" : "FAILED");
+
+	// Blocks of the old layout are erased by the first start after an update, nothing is read from them
+	FlashTestLayout();
+	printf("Update from the layout before 2.0: %s\n", (failures == 0) ? "ok" : "FAILED");
+
+	// Random epochs, erases, warm and cold resets: the epochs seen are in order and none from before an erase
+	if(argc > 1)
+		rounds = strtoul(argv[1], NULL, 0);
+	HostFlashInit();
+	HostRandomSeed(13);
+	if(!HostRetainedRamLoss(HostRandom()))
+		FlashTestFail("no .epoch_state section", 0);
+	FlashTestReset(false);
+	flashTestCounter = 1;
+	flashTestFirst = 0;
+	for(round = 0; round < rounds; round++)
+	{
+		action = HostRandom() % 1000;
+		if(action < 5)
+		{
+			// Nothing before the erase is seen at once, it is kept if the journal entry is written
+			first = flashTestCounter;
+			boundary = activeEpochBlock.info.block_number + (activeEpochBlock.info.data_length > 0);
+			if(!AccelEpochBlockClearAll())
+				FlashTestFail("erase", round);
+			erases++;
+			if(FlashTestCheck(first, round) != 0)
+				FlashTestFail("epochs seen after an erase", round);
+			if(HostRandom() & 1)
+			{
+				HostFlashRunAll();
+				flashTestFirst = first;
+			}
+			else
+			{
+				FlashTestReset(HostRandom() & 1);
+				resets++;
+				if(FlashTestJournal() == boundary)
+					flashTestFirst = first;
+			}
+		}
+		else if(action < 10)
+		{
+			FlashTestReset(HostRandom() & 1);
+			resets++;
+		}
+		else if(action < 12)
+		{
+			// A cold reset once the queued flash operations are done keeps every epoch added
+			HostFlashRunAll();
+			FlashTestReset(false);
+			resets++;
+			if((FlashTestCheck(flashTestFirst, round) > 0) && (flashTestLast != (flashTestCounter - 1)))
+				FlashTestFail("epoch lost by a cold reset", round);
+		}
+		else
+		{
+			// Flash operations mostly complete before the next epoch, some are still queued at a reset
+			HostFlashRunAll();
+			FlashTestAdd();
+			if(HostRandom() % 3)
+				HostFlashRunAll();
+		}
+		// A journal lost with its page erased brings the old blocks back, once every page of erases
+		if(FlashTestJournal() == EPOCH_BLOCK_INDEX_INVALID)
+			flashTestFirst = 0;
+		FlashTestCheck(flashTestFirst, round);
+	}
+	HostFlashRunAll();
+	printf("Random test, %u rounds with %u erases and %u resets, %u epochs seen: %s\n", (unsigned int)rounds,
+		(unsigned int)erases, (unsigned int)resets, (unsigned int)FlashTestCheck(0, round), (failures == 0) ? "ok" : "FAILED");
+	return (failures == 0) ? 0 : 1;
+}
+
+// Counters per day of epochs and the flash busy time, the CPU and radio wait for each operation
+static void FlashTestReport(const char* name, uint32_t epochs)
+{
+	double days = epochs / (24.0 * 60.0);
+	printf("%-16s %8.1f %8.0f %8.0f %8.1f %8.0f\n", name, hostFlashCounters.pageErases / days, hostFlashCounters.wordsWritten / days,
+		hostFlashCounters.stores / days, hostFlashCounters.updates / days,
+		((hostFlashCounters.pageErases * FLASH_TEST_ERASE_MS) + (hostFlashCounters.wordsWritten * FLASH_TEST_WRITE_MS)) / days);
+}
+
+// Days kept by the full epoch ring and by the compact ring, the compact bins must outlast the epochs they are summed from
+static void FlashTestRings(void)
+{
+	uint32_t epochs = 0;
+	uint16_t index;
+	double epochDays, compactDays;
+	for(index = 0; index < EPOCH_NVM_BLOCK_COUNT; index++)
+		epochs += AccelEpochBlockSamples(index);
+	epochDays = (epochs * (double)settings.epochPeriod) / (24.0 * 60.0 * 60.0);
+	// Less the page erased ahead
+	compactDays = ((EPOCH_COMPACT_BLOCK_COUNT - (PSTORAGE_FLASH_PAGE_SIZE / EPOCH_COMPACT_BLOCK_SIZE)) * EPOCH_COMPACT_BLOCK_BINS *
+		(double)EPOCH_COMPACT_PERIOD) / (24.0 * 60.0 * 60.0);
+	if(compactDays <= epochDays)
+		FlashTestFail("compact ring shorter than the epoch ring", 0);
+	printf("Epoch ring %.1f days (%u epochs), compact ring %.1f days: %s\n", epochDays, (unsigned int)epochs, compactDays,
+		(compactDays > epochDays) ? "ok" : "FAILED");
+}
+
+// AccelPstorageStoreActiveBlock() before the append path, an update of each full block
+static void FlashTestLegacy(uint32_t epochs)
+{
+	static Epoch_block_t block;
+	pstorage_module_param_t param = {NULL, EPOCH_NVM_BLOCK_SIZE, EPOCH_NVM_BLOCK_COUNT};
+	pstorage_handle_t base, handle;
+	uint32_t index;
+	HostFlashInit();
+	if(pstorage_register(&param, &base) != NRF_SUCCESS)
+		exit(1);
+	memset(&block, 0, sizeof(block));
+	for(index = 0; index < (epochs / EPOCH_BLOCK_DATA_COUNT); index++)
+	{
+		block.info.block_number = index;
+		block.info.data_length = EPOCH_BLOCK_DATA_COUNT;
+		pstorage_block_identifier_get(&base, index % EPOCH_NVM_BLOCK_COUNT, &handle);
+		pstorage_update(&handle, (uint8_t*)&block, EPOCH_NVM_BLOCK_SIZE, 0);
+		HostFlashRunAll();
+	}
+}
+
+// Minute epochs through the logger and the daily totals, the current day must be the same after each cold reset
+static uint32_t FlashTestDaily(void)
+{
+	Epoch_sample_t epoch;
+	DailyRecord_t before, after;
+	uint32_t minute, resets = 0;
+	HostFlashInit();
+	HostRandomSeed(21);
+	if(!FlashTestDailyInit())
+		return 0;
+	for(minute = 0; minute < (FLASH_TEST_DAILY_DAYS * 24 * 60); minute++)
+	{
+		// As AccelEpochWriteTasks(), the close time is set when the epoch is added
+		HostEpochSample(minute, epoch.b);
+		status.epochCloseTime = 1500000000ul + ((minute + 1) * 60);
+		AccelPstorageAddEpoch(&epoch);
+		DailyRollupAddEpoch(status.epochCloseTime - settings.epochPeriod, &epoch,
+			(uint8_t)epoch.part.steps | (((uint16_t)(uint8_t)epoch.part.accel & 0xC0) << 2));
+		HostFlashRunAll();
+		if((HostRandom() % 240) != 0)
+			continue;
+		DailyRollupCurrent(&before);
+		HostFlashRestart();
+		HostRetainedRamLoss(HostRandom());
+		if(!FlashTestDailyInit())
+			return resets;
+		resets++;
+		DailyRollupCurrent(&after);
+		if(memcmp(&before, &after, sizeof(DailyRecord_t)) != 0)
+			FlashTestFail("daily totals lost by a reset", minute);
+	}
+	return resets;
+}
+
+// Logger and daily totals as at start up
+static bool FlashTestDailyInit(void)
+{
+	settings.epochPeriod = 60;
+	if(!AccelEpochLoggerInit() || !DailyRollupInit())
+	{
+		FlashTestFail("daily init", 0);
+		return false;
+	}
+	HostFlashRunAll();
+	DailyRollupRestore();
+	return true;
+}
+
+// Old fixed sample blocks in the region before 2.0, which started two pages further on. Every block is stored and
+// checked, so that some land on the journal, compact and daily pages
+static void FlashTestLayout(void)
+{
+	Epoch_block_t block;
+	uint16_t* word = (uint16_t*)&block;
+	uint16_t sum, i;
+	uint32_t index, offset;
+	HostFlashInit();
+	for(index = 0; index < (FLASH_TEST_OLD_SIZE / EPOCH_NVM_BLOCK_SIZE); index++)
+	{
+		memset(&block, 0, sizeof(block));
+		block.info.block_number = index;
+		block.info.data_length = EPOCH_BLOCK_DATA_COUNT;
+		block.info.time_stamp = 1500000000ul + (index * EPOCH_BLOCK_DATA_COUNT * 60);
+		block.blockFormat = BLOCK_FORMAT_EPOCH_DATAv2;
+		block.blockEpochPeriod = 60;
+		for(i = 0; i < EPOCH_BLOCK_DATA_COUNT; i++)
+			HostEpochSample((index * EPOCH_BLOCK_DATA_COUNT) + i, block.epoch_data[i].b);
+		// The whole block adds to zero
+		for(i = 0, sum = 0; i < ((EPOCH_NVM_BLOCK_SIZE / sizeof(uint16_t)) - 1); i++)
+			sum += word[i];
+		block.check = -sum;
+		memcpy((uint8_t*)HostFlashAddress(FLASH_TEST_OLD_START + (index * EPOCH_NVM_BLOCK_SIZE)), &block, sizeof(block));
+	}
+	// First start of the new firmware, the logger and the regions after it as in main()
+	settings.epochPeriod = 60;
+	if(!AccelEpochLoggerInit() || !AccelEpochLayoutUpdated() || !EpochCompactInit() || !DailyRollupInit())
+	{
+		FlashTestFail("old layout not found", 0);
+		return;
+	}
+	HostFlashRunAll();
+	for(offset = 0; offset < FLASH_TEST_DATA_SIZE; offset++)
+	{
+		if(HostFlashAddress(offset)[0] != 0xFF)
+		{
+			FlashTestFail("old layout not erased", offset);
+			return;
+		}
+	}
+	if((activeIndex != 0) || (activeEpochBlock.info.block_number != 0))
+		FlashTestFail("logger not started again", 0);
+	// Logs as usual, and the next start finds the new layout
+	for(index = 0; index < 1000; index++)
+	{
+		FlashTestAdd();
+		HostFlashRunAll();
+	}
+	HostFlashRestart();
+	if(!AccelEpochLoggerInit() || AccelEpochLayoutUpdated() || !EpochCompactInit() || !DailyRollupInit())
+		FlashTestFail("new layout taken for the old", 0);
+}
+
+// Reset with a random part of the queued flash operations run, a cold reset also loses the no-init RAM
+static void FlashTestReset(bool warm)
+{
+	HostFlashPowerLoss(HostRandom() % (HostFlashPending() + 1));
+	HostFlashRestart();
+	if(!warm)
+		HostRetainedRamLoss(HostRandom());
+	if(!AccelEpochLoggerInit())
+		FlashTestFail("logger init", 0);
+	HostFlashRunAll();
+}
+
+// An epoch holding its count
+static void FlashTestAdd(void)
+{
+	Epoch_sample_t epoch;
+	memset(&epoch, 0, sizeof(epoch));
+	memcpy(epoch.part.epoch, &flashTestCounter, sizeof(uint32_t));
+	epoch.part.steps = HostRandom() % 20;
+	epoch.part.batt = 50;
+	epoch.part.temp = 20;
+	flashTestCounter++;
+	status.epochCloseTime = flashTestCounter * 60;
+	AccelPstorageAddEpoch(&epoch);
+}
+
+// Read every epoch from the oldest block to the active block - returns the count seen
+static uint32_t FlashTestCheck(uint32_t first, uint32_t round)
+{
+	Epoch_sample_t epoch;
+	uint32_t last = 0, value, seen = 0;
+	flashTestLast = 0;
+	uint16_t index = (activeIndex + 1) % EPOCH_NVM_BLOCK_COUNT, count, sample;
+	for(;;)
+	{
+		count = AccelEpochBlockSamples(index);
+		for(sample = 0; sample < count; sample++)
+		{
+			if(!AccelEpochSampleRead(&epoch, sample, 1, index))
+			{
+				FlashTestFail("epoch read", round);
+				return seen;
+			}
+			memcpy(&value, epoch.part.epoch, sizeof(uint32_t));
+			if(value < first)
+				FlashTestFail("erased epoch seen", round);
+			if(value <= last)
+				FlashTestFail("epochs out of order", round);
+			last = value;
+			flashTestLast = value;
+			seen++;
+		}
+		if(index == activeIndex)
+			break;
+		index = (index + 1) % EPOCH_NVM_BLOCK_COUNT;
+	}
+	return seen;
+}
+
+// Newest erase boundary in the journal page after the epoch blocks, invalid if none
+static uint16_t FlashTestJournal(void)
+{
+	const uint32_t* journal = (const uint32_t*)HostFlashAddress(EPOCH_NVM_SIZE_TOTAL);
+	uint32_t index;
+	uint16_t boundary = EPOCH_BLOCK_INDEX_INVALID;
+	for(index = 0; (index < (EPOCH_ERASE_NVM_SIZE / sizeof(uint32_t))) && (journal[index] != 0xFFFFFFFF); index++)
+		boundary = (uint16_t)journal[index];
+	return boundary;
+}
+
+static void FlashTestFail(const char* reason, uint32_t round)
+{
+	if(failures++ < 10)
+		fprintf(stderr, "Failed: %s (round %u, active %u, block %u)\n", reason, (unsigned int)round,
+			(unsigned int)activeIndex, (unsigned int)activeEpochBlock.info.block_number);
+}
+//EOF
@@ -0,0 +1,173 @@
+// Central side decoder of the serial link bulk data, text lines and binary frames, and of the epoch block encodings
+// Frames start with the sync byte, which is never ascii text, so a frame can only start between lines
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "AsciiHex.h"
+#include "Crc16.h"
+#include "EpochCodec.h"
+#include "FrameDecode.h"
+
+// Source
+void FrameDecodeInit(FrameDecoder_t* decoder, FrameDecodeLine_t line, FrameDecodeFrame_t frame)
+{
+	memset(decoder, 0, sizeof(FrameDecoder_t));
+	decoder->line = line;
+	decoder->frame = frame;
+}
+
+void FrameDecodeAdd(FrameDecoder_t* decoder, const uint8_t* data, uint16_t length)
+{
+	for(; length > 0; data++, length--)
+	{
+		// Frame payload
+		if(decoder->headerLength >= BLE_FRAME_HEADER_LEN)
+		{
+			decoder->buffer[decoder->length++] = *data;
+			if(decoder->length >= decoder->payloadLength)
+			{
+				if(decoder->frame != NULL)
+					decoder->frame(decoder->header[1], decoder->buffer, decoder->length);
+				decoder->headerLength = 0;
+				decoder->length = 0;
+			}
+			continue;
+		}
+		// Frame header, the payload length is little endian
+		if((decoder->headerLength > 0) || ((*data == BLE_FRAME_SYNC) && (decoder->length == 0)))
+		{
+			decoder->header[decoder->headerLength++] = *data;
+			if(decoder->headerLength < BLE_FRAME_HEADER_LEN)
+				continue;
+			decoder->payloadLength = (uint16_t)decoder->header[2] | ((uint16_t)decoder->header[3] << 8);
+			decoder->length = 0;
+			if(decoder->payloadLength > FRAME_DECODE_MAX_LEN)
+			{
+				decoder->errors++;
+				decoder->headerLength = 0;
+			}
+			else if(decoder->payloadLength == 0)
+			{
+				if(decoder->frame != NULL)
+					decoder->frame(decoder->header[1], decoder->buffer, 0);
+				decoder->headerLength = 0;
+			}
+			continue;
+		}
+		// Text, lines end with either line end character and empty lines are skipped
+		if((*data == '\r') || (*data == '\n'))
+		{
+			if(decoder->length > 0)
+			{
+				decoder->buffer[decoder->length] = '\0';
+				if(decoder->line != NULL)
+					decoder->line((const char*)decoder->buffer, decoder->length);
+			}
+			decoder->length = 0;
+			continue;
+		}
+		if(decoder->length >= FRAME_DECODE_MAX_LEN)
+		{
+			decoder->errors++;
+			decoder->length = 0;
+		}
+		decoder->buffer[decoder->length++] = *data;
+	}
+}
+
+bool FrameDecodeBlockCheck(const Epoch_block_t* block)
+{
+	const uint16_t* word = (const uint16_t*)block;
+	uint16_t sum = 0, i;
+	if(block->blockFormat & BLOCK_FORMAT_CHECK_CRC16)
+		return (block->check == Crc16Ccitt(block, offsetof(Epoch_block_t, check), CRC16_CCITT_INIT));
+	// The whole block adds to zero
+	for(i = 0; i < (EPOCH_NVM_BLOCK_SIZE / sizeof(uint16_t)); i++)
+		sum += word[i];
+	return (sum == 0);
+}
+
+bool FrameDecodeHexBlock(const char* line, uint16_t length, Epoch_block_t* block)
+{
+	if(length != (2 * EPOCH_NVM_BLOCK_SIZE))
+		return false;
+	return (ReadHexToBinary((uint8_t*)block, line, length) == EPOCH_NVM_BLOCK_SIZE);
+}
+
+bool FrameDecodePackedBlock(const uint8_t* payload, uint16_t length, uint16_t* index, Epoch_block_t* block)
+{
+	EpochCodec_t codec, record;
+	Epoch_sample_t sample;
+	const uint8_t *source, *end;
+	uint16_t count, limit, sample_index, written = 0;
+	bool packed;
+	// Index, header as stored and the check
+	if(length < (sizeof(uint16_t) + offsetof(Epoch_block_t, epoch_data) + sizeof(uint16_t)))
+		return false;
+	memcpy(index, payload, sizeof(uint16_t));
+	memset(block, 0xFF, sizeof(Epoch_block_t));
+	memcpy(block, &payload[sizeof(uint16_t)], offsetof(Epoch_block_t, epoch_data));
+	memcpy(&block->check, &payload[sizeof(uint16_t) + offsetof(Epoch_block_t, epoch_data)], sizeof(uint16_t));
+	source = &payload[sizeof(uint16_t) + offsetof(Epoch_block_t, epoch_data) + sizeof(uint16_t)];
+	end = &payload[length];
+	// Sample count as the sender, erased blocks have none
+	packed = ((block->blockFormat & ~BLOCK_FORMAT_FLAG_MASK) == BLOCK_FORMAT_EPOCH_DATAv3);
+	limit = packed ? EPOCH_BLOCK_PACKED_COUNT : EPOCH_BLOCK_DATA_COUNT;
+	count = (block->info.block_number > EPOCH_BLOCK_NUMBER_LAST) ? 0 : block->info.data_length;
+	if(count > limit)
+		count = limit;
+	// Transfer records (with runs) decoded, stored as single records in packed blocks or as fixed samples
+	EpochCodecInit(&codec);
+	EpochCodecInit(&record);
+	for(sample_index = 0; sample_index < count; sample_index++)
+	{
+		if(!EpochCodecDecode(&codec, &source, end, sample.b))
+			return false;
+		if(!packed)
+			memcpy(&block->epoch_data[sample_index], &sample, sizeof(Epoch_sample_t));
+		else if((written + EPOCH_CODEC_RECORD_MAX) <= EPOCH_NVM_BLOCK_DATA_LEN)
+		{
+			written += EpochCodecRecord(&record, sample.b, ((uint8_t*)block->epoch_data) + written);
+			// Padded to the end of the flash word as the device stores each epoch, short of the word holding the check
+			while(	((offsetof(Epoch_block_t, epoch_data) + written) % sizeof(uint32_t) != 0) &&
+					((offsetof(Epoch_block_t, epoch_data) + written) < (offsetof(Epoch_block_t, check) & ~(sizeof(uint32_t) - 1))) )
+				((uint8_t*)block->epoch_data)[written++] = EPOCH_CODEC_PAD;
+		}
+		else
+			return false;
+	}
+	// All of the frame used
+	return (source == end);
+}
+
+uint16_t FrameDecodeBlockSamples(const Epoch_block_t* block, Epoch_sample_t* samples, uint16_t max)
+{
+	EpochCodec_t codec;
+	const uint8_t *source, *end;
+	uint16_t count, limit;
+	bool packed = ((block->blockFormat & ~BLOCK_FORMAT_FLAG_MASK) == BLOCK_FORMAT_EPOCH_DATAv3);
+	if(block->info.block_number > EPOCH_BLOCK_NUMBER_LAST)
+		return 0;
+	limit = packed ? EPOCH_BLOCK_PACKED_COUNT : EPOCH_BLOCK_DATA_COUNT;
+	if(limit > max)
+		limit = max;
+	count = (block->info.data_length > limit) ? limit : block->info.data_length;
+	if(!packed)
+	{
+		memcpy(samples, block->epoch_data, count * sizeof(Epoch_sample_t));
+		return count;
+	}
+	// Single records from the start of the data
+	EpochCodecInit(&codec);
+	source = (const uint8_t*)block->epoch_data;
+	end = ((const uint8_t*)block) + offsetof(Epoch_block_t, check);
+	for(limit = 0; limit < count; limit++)
+	{
+		if(!EpochCodecDecode(&codec, &source, end, samples[limit].b))
+			break;
+	}
+	return limit;
+}
+//EOF
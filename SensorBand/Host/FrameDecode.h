@@ -0,0 +1,48 @@
+// Central side decoder of the serial link bulk data, text lines and binary frames, and of the epoch block encodings
+#ifndef _FRAME_DECODE_H_
+#define _FRAME_DECODE_H_
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble_nus.h"
+#include "pstorage.h"
+#include "ble_serial.h"
+#include "acc_tasks.h"
+
+// Definitions
+#define FRAME_DECODE_MAX_LEN		1200	// Longest frame payload or text line
+
+// Types
+// Called with each complete text line (without the line end) and each complete frame
+typedef void (*FrameDecodeLine_t)(const char* line, uint16_t length);
+typedef void (*FrameDecodeFrame_t)(uint8_t type, const uint8_t* payload, uint16_t length);
+
+// Stream state
+typedef struct FrameDecoder_tag {
+	FrameDecodeLine_t line;
+	FrameDecodeFrame_t frame;
+	uint8_t header[BLE_FRAME_HEADER_LEN];	// Frame header so far
+	uint8_t headerLength;
+	uint16_t payloadLength;					// Payload expected, once the header is complete
+	uint16_t length;						// Payload or line so far
+	uint32_t errors;						// Lines or frames too long
+	uint8_t buffer[FRAME_DECODE_MAX_LEN + 1];	// Lines are null terminated
+} FrameDecoder_t;
+
+// Functions
+// Start a stream
+void FrameDecodeInit(FrameDecoder_t* decoder, FrameDecodeLine_t line, FrameDecodeFrame_t frame);
+// Add received data, the callbacks are called as lines and frames are completed
+void FrameDecodeAdd(FrameDecoder_t* decoder, const uint8_t* data, uint16_t length);
+// Check a raw block, CRC-16 or additive checksum by the format flag
+bool FrameDecodeBlockCheck(const Epoch_block_t* block);
+// Raw block from a hex "R" line
+bool FrameDecodeHexBlock(const char* line, uint16_t length, Epoch_block_t* block);
+// Raw block from a packed "P" frame payload, the stored records are rebuilt as written (bit exact with the stored block)
+// Returns false if the records do not decode to the header sample count
+bool FrameDecodePackedBlock(const uint8_t* payload, uint16_t length, uint16_t* index, Epoch_block_t* block);
+// Samples of a raw block in any format, returns the count (up to max)
+uint16_t FrameDecodeBlockSamples(const Epoch_block_t* block, Epoch_sample_t* samples, uint16_t max);
+
+#endif
+//EOF
@@ -0,0 +1,160 @@
+// Head search of the epoch ring over random ring states, and the boot time against the linear scan
+// Built at the default ring size and at 64KB, 256KB and 1MB (make rings) for the boot time
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "pstorage.h"
+#include "acc_tasks.h"
+#include "HostBoard.h"
+#include "HostFlash.h"
+
+// Definitions
+#define HEAD_TEST_STATES		20000		// Random ring states
+#define HEAD_TEST_BOOTS			200			// Logger starts timed
+#define HEAD_TEST_NUMBERS		(EPOCH_BLOCK_NUMBER_LAST + 1ul)
+#define HEAD_TEST_PAGE_BLOCKS	(PSTORAGE_FLASH_PAGE_SIZE / EPOCH_NVM_BLOCK_SIZE)	// As EPOCH_NVM_PAGE_BLOCKS
+
+// Globals
+static Epoch_block_t* ring;					// The epoch blocks in the flash model, states are written directly
+static uint32_t failures;
+
+// Prototypes
+bool AccelEpochHeadSearch(uint16_t* head);	// acc_tasks.c
+static uint16_t HeadTestState(uint32_t written, uint16_t number, bool open);
+static uint16_t HeadTestLinear(void);
+static void HeadTestFail(const char* reason, uint32_t state);
+
+// Source
+int main(int argc, char* argv[])
+{
+	uint32_t state, written, reads, linearReads, boot;
+	uint16_t expected, head, number;
+	bool found, open;
+	clock_t start;
+	double seconds, linearSeconds;
+	volatile uint32_t sink = 0;
+
+	// The logger registers the regions on the erased flash
+	HostFlashInit();
+	settings.epochPeriod = 60;
+	if(!AccelEpochLoggerInit())
+		return 1;
+	HostFlashRunAll();
+	ring = (Epoch_block_t*)HostFlashAddress(0);
+
+	// Random states: empty, part of the first pass, many passes, block numbers wrapping, an open block
+	HostRandomSeed(15);
+	for(state = 0; state < HEAD_TEST_STATES; state++)
+	{
+		switch(state % 4)
+		{
+			case 0:		written = HostRandom() % (EPOCH_NVM_BLOCK_COUNT + 1); break;
+			case 1:		written = EPOCH_NVM_BLOCK_COUNT + (HostRandom() % (20 * EPOCH_NVM_BLOCK_COUNT)); break;
+			default:	written = HostRandom() % (3 * EPOCH_NVM_BLOCK_COUNT); break;
+		}
+		number = (state % 4 == 3) ? (uint16_t)(HEAD_TEST_NUMBERS - (HostRandom() % (2 * EPOCH_NVM_BLOCK_COUNT))) : (uint16_t)(HostRandom() % 1000);
+		if(number > EPOCH_BLOCK_NUMBER_LAST)
+			number = 0;
+		open = (HostRandom() & 1) != 0;
+		expected = HeadTestState(written, number, open);
+		found = AccelEpochHeadSearch(&head);
+		if(!found || (head != expected))
+			HeadTestFail("head not found", state);
+		// Without block numbers wrapping, the same as the linear scan for the largest number
+		if(found && ((number + written + 1) < HEAD_TEST_NUMBERS) && (head != HeadTestLinear()))
+			HeadTestFail("head not as the linear scan", state);
+		// A block after the head that is not erased or one pass older is found, the logger falls back to the linear scan
+		if((expected > HEAD_TEST_PAGE_BLOCKS) && ((expected + 1) < EPOCH_NVM_BLOCK_COUNT))
+		{
+			ring[expected + 1].info.block_number = (uint16_t)((ring[expected].info.block_number + 5ul) % HEAD_TEST_NUMBERS);
+			if(AccelEpochHeadSearch(&head))
+				HeadTestFail("out of sequence ring not found", state);
+		}
+	}
+	printf("Head search of %u random ring states: %s\n", HEAD_TEST_STATES, (failures == 0) ? "ok" : "FAILED");
+
+	// Boot time of a full ring, the logger start and the linear scan it replaces
+	HeadTestState(5 * EPOCH_NVM_BLOCK_COUNT + (EPOCH_NVM_BLOCK_COUNT / 3), 100, false);
+	HostFlashCountersClear();
+	start = clock();
+	for(boot = 0; boot < HEAD_TEST_BOOTS; boot++)
+	{
+		// The retained block no longer matches its check, a cold start
+		activeEpochBlock.meta_data[0] ^= 0xFF;
+		HostFlashRestart();
+		if(!AccelEpochLoggerInit())
+			HeadTestFail("logger init", boot);
+		sink += activeIndex;
+	}
+	seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	reads = hostFlashCounters.loads / HEAD_TEST_BOOTS;
+	HostFlashCountersClear();
+	start = clock();
+	for(boot = 0; boot < HEAD_TEST_BOOTS; boot++)
+	{
+		activeIndex = EPOCH_BLOCK_INDEX_INVALID;
+		sink += HeadTestLinear();
+	}
+	linearSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	linearReads = hostFlashCounters.loads / HEAD_TEST_BOOTS;
+	printf("%4uKB ring, %4u blocks: logger start %5u reads %8.0f ns, linear scan %5u reads %8.0f ns (host)\n",
+		(unsigned int)(EPOCH_NVM_SIZE_TOTAL / 1024), (unsigned int)EPOCH_NVM_BLOCK_COUNT,
+		(unsigned int)reads, (seconds * 1e9) / HEAD_TEST_BOOTS, (unsigned int)linearReads, (linearSeconds * 1e9) / HEAD_TEST_BOOTS);
+	return (failures == 0) ? 0 : 1;
+}
+
+// Ring as the logger leaves it after writing blocks from a number, the page ahead erased - returns the head index
+static uint16_t HeadTestState(uint32_t written, uint16_t number, bool open)
+{
+	uint32_t block, index, count = written + (open ? 1 : 0);
+	memset(ring, 0xFF, EPOCH_NVM_SIZE_TOTAL);
+	// Only the last pass is left
+	block = (count > EPOCH_NVM_BLOCK_COUNT) ? (count - EPOCH_NVM_BLOCK_COUNT) : 0;
+	for(; block < count; block++)
+	{
+		index = block % EPOCH_NVM_BLOCK_COUNT;
+		ring[index].info.block_number = (uint16_t)((number + block) % HEAD_TEST_NUMBERS);
+		ring[index].info.data_length = ((block + 1) < count) || !open ? EPOCH_BLOCK_PACKED_COUNT : EPOCH_BLOCK_LENGTH_OPEN;
+		ring[index].info.time_stamp = 1500000000ul + (block * 3600);
+		ring[index].blockFormat = BLOCK_FORMAT_EPOCH_DATAv3 | BLOCK_FORMAT_CHECK_CRC16;
+	}
+	// The rest of the page of the active block was erased when the page was entered
+	index = count % EPOCH_NVM_BLOCK_COUNT;
+	if((count >= EPOCH_NVM_BLOCK_COUNT) && !(open && ((index % HEAD_TEST_PAGE_BLOCKS) == 0)))
+		memset(&ring[index], 0xFF, (HEAD_TEST_PAGE_BLOCKS - (index % HEAD_TEST_PAGE_BLOCKS)) * EPOCH_NVM_BLOCK_SIZE);
+	activeIndex = EPOCH_BLOCK_INDEX_INVALID;
+	if(count == 0)
+		return EPOCH_BLOCK_INDEX_INVALID;
+	return (count - 1) % EPOCH_NVM_BLOCK_COUNT;
+}
+
+// The head search before the binary search, the largest block number of every block header
+static uint16_t HeadTestLinear(void)
+{
+	EpochBlockInfo_t info;
+	uint16_t index, head = EPOCH_BLOCK_INDEX_INVALID;
+	uint32_t largest = 0;
+	for(index = 0; index < EPOCH_NVM_BLOCK_COUNT; index++)
+	{
+		if(!AccelEpochBlockRead((uint8_t*)&info, 0, sizeof(EpochBlockInfo_t), index))
+			break;
+		if(info.block_number > EPOCH_BLOCK_NUMBER_LAST)
+			continue;
+		if((head == EPOCH_BLOCK_INDEX_INVALID) || (info.block_number > largest))
+		{
+			head = index;
+			largest = info.block_number;
+		}
+	}
+	return head;
+}
+
+static void HeadTestFail(const char* reason, uint32_t state)
+{
+	if(failures++ < 10)
+		fprintf(stderr, "Failed: %s (%u)\n", reason, (unsigned int)state);
+}
+//EOF
@@ -0,0 +1,164 @@
+// Host stand-ins for the band hardware and the application globals the firmware modules use
+// The accelerometer, ADC and GPIO are idle, faults end the host tool with the fault code
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <elf.h>
+#include "nrf.h"
+#include "app_scheduler.h"
+#include "nrf_drv_gpiote.h"
+#include "nrf_delay.h"
+#include "Peripherals/LIS3DH.h"
+#include "Analog.h"
+#include "HostBoard.h"
+
+// Globals
+// Application state
+Settings_t settings;
+Status_t status;
+volatile uint32_t rtcEpochTriplicate[3];
+volatile hw_ctrl_t hw_ctrl;
+// Peripherals
+static NRF_GPIO_Type hostGpio;
+static NRF_POWER_Type hostPower;
+static NRF_RTC_Type hostRtc1;
+NRF_GPIO_Type* NRF_GPIO = &hostGpio;
+NRF_POWER_Type* NRF_POWER = &hostPower;
+NRF_RTC_Type* NRF_RTC1 = &hostRtc1;
+// Sensors
+accel_settings_t accel_regs;
+volatile uint16_t battRaw;
+volatile uint8_t battPercent = 100;
+volatile int16_t tempRaw;
+volatile int8_t tempCelcius = 20;
+static uint32_t hostRandomState = 1;
+
+// Source
+bool HostRetainedRamLoss(uint32_t seed)
+{
+	bool found = false;
+	FILE* file;
+	Elf64_Ehdr header;
+	Elf64_Shdr section, names;
+	char name[16];
+	uint16_t index;
+	// Find the section in the executable, the host linker gives no symbols for a section name starting with a dot
+	file = fopen("/proc/self/exe", "rb");
+	if(file == NULL)
+		return false;
+	if(	(fread(&header, sizeof(header), 1, file) == 1) &&
+		(fseek(file, header.e_shoff + (header.e_shstrndx * sizeof(Elf64_Shdr)), SEEK_SET) == 0) &&
+		(fread(&names, sizeof(names), 1, file) == 1) )
+	{
+		for(index = 0; index < header.e_shnum; index++)
+		{
+			if(	(fseek(file, header.e_shoff + (index * sizeof(Elf64_Shdr)), SEEK_SET) != 0) ||
+				(fread(&section, sizeof(section), 1, file) != 1) ||
+				(fseek(file, names.sh_offset + section.sh_name, SEEK_SET) != 0) ||
+				(fread(name, sizeof(name), 1, file) != 1) )
+				break;
+			name[sizeof(name) - 1] = '\0';
+			if(strcmp(name, ".epoch_state") == 0)
+			{
+				uint8_t* ram = (uint8_t*)(uintptr_t)section.sh_addr;
+				uint64_t offset;
+				// Random contents, as at power on
+				HostRandomSeed(seed);
+				for(offset = 0; offset < section.sh_size; offset++)
+					ram[offset] = (uint8_t)HostRandom();
+				found = true;
+				break;
+			}
+		}
+	}
+	fclose(file);
+	return found;
+}
+
+uint32_t HostRandom(void)
+{
+	// 32 bit xorshift
+	hostRandomState ^= hostRandomState << 13;
+	hostRandomState ^= hostRandomState >> 17;
+	hostRandomState ^= hostRandomState << 5;
+	return hostRandomState;
+}
+
+void HostRandomSeed(uint32_t seed)
+{
+	hostRandomState = (seed != 0) ? seed : 1;
+}
+
+void HostEpochSample(uint32_t minute, uint8_t* sample)
+{
+	static uint8_t accel;
+	static int8_t batt;
+	uint32_t hour = (minute / 60) % 24, energy;
+	uint16_t steps = 0;
+	bool awake = (hour >= 7) && (hour < 23);
+	if(minute == 0)
+	{
+		accel = 0x15;
+		batt = 100;
+	}
+	// Activity in bouts while awake, quiet and still at night
+	energy = HostRandom() % 8;
+	if(awake)
+	{
+		energy = 20 + (HostRandom() % 200);
+		if((HostRandom() % 5) == 0)
+		{
+			steps = 20 + (HostRandom() % 120);
+			energy += steps * 30;
+		}
+		if((HostRandom() % 20) == 0)
+			accel = 0x01 << (HostRandom() % 6);
+	}
+	if((minute % 600) == 0)
+		batt = (batt > 5) ? (batt - 1) : 100;
+	// Battery, temperature, orientation with the top step bits, steps, energy (little endian)
+	sample[0] = (uint8_t)batt;
+	sample[1] = awake ? (30 + (HostRandom() % 3)) : 28;
+	sample[2] = (accel & 0x3f) | ((steps >> 2) & 0xC0);
+	sample[3] = (uint8_t)steps;
+	sample[4] = (uint8_t)energy;
+	sample[5] = (uint8_t)(energy >> 8);
+	sample[6] = (uint8_t)(energy >> 16);
+	sample[7] = (uint8_t)(energy >> 24);
+}
+
+// Faults end the tool, the code gives the source line
+void app_error_fault_handler(uint32_t id, uint32_t pc, uint32_t info)
+{
+	fprintf(stderr, "Fault 0x%08X\n", (unsigned int)id);
+	abort();
+}
+
+void app_error_handler(uint32_t error_code, uint32_t line_num, const uint8_t* p_file_name)
+{
+	fprintf(stderr, "Error %u at %s:%u\n", (unsigned int)error_code, (const char*)p_file_name, (unsigned int)line_num);
+	abort();
+}
+
+// Idle peripherals
+uint8_t AccelPresent(void)											{ return 0; }
+uint8_t AccelSetting(accel_settings_t* settings, uint8_t range, uint16_t rate)	{ return 0; }
+uint8_t AccelStartup(accel_settings_t* settings)					{ return 0; }
+uint8_t AccelShutdown(void)											{ return 0; }
+uint8_t AccelReadEvents(void)										{ return 0; }
+uint8_t AccelReadSample(accel_t* value)								{ memset(value, 0, sizeof(accel_t)); return 0; }
+uint8_t AccelReadFifo(accel_t* buffer, uint8_t maxEntries)			{ return 0; }
+uint16_t AdcToMillivolt(uint16_t adcVal)							{ return adcVal; }
+const char* TempFloat(int16_t tempVal)								{ return "20.0"; }
+uint32_t app_sched_event_put(void* p_event_data, uint16_t event_size, app_sched_event_handler_t handler)	{ return 0; }
+bool nrf_drv_gpiote_is_init(void)									{ return true; }
+uint32_t nrf_drv_gpiote_init(void)									{ return 0; }
+void nrf_drv_gpiote_uninit(void)									{ }
+uint32_t nrf_drv_gpiote_in_init(nrf_drv_gpiote_pin_t pin, nrf_drv_gpiote_in_config_t const* p_config, nrf_drv_gpiote_evt_handler_t evt_handler)	{ return 0; }
+void nrf_drv_gpiote_in_event_enable(nrf_drv_gpiote_pin_t pin, bool int_enable)	{ }
+void nrf_drv_gpiote_in_event_disable(nrf_drv_gpiote_pin_t pin)		{ }
+void nrf_delay_ms(uint32_t ms)										{ }
+//EOF
@@ -0,0 +1,25 @@
+// Host stand-ins for the band hardware and the application globals the firmware modules use
+#ifndef _HOST_BOARD_H_
+#define _HOST_BOARD_H_
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+#include "Config.h"
+
+// Globals
+// Application state, in main.c on the band
+extern Settings_t settings;
+extern Status_t status;
+extern volatile uint32_t rtcEpochTriplicate[3];
+
+// Functions
+// Lose the no-init RAM (.epoch_state), as after a power on reset it holds random data - false if not found
+bool HostRetainedRamLoss(uint32_t seed);
+// Small repeatable random numbers for the host tools
+uint32_t HostRandom(void);
+void HostRandomSeed(uint32_t seed);
+// Synthetic minute epoch (Epoch_sample_t bytes) with a daily pattern, call in minute order from zero
+void HostEpochSample(uint32_t minute, uint8_t* sample);
+
+#endif
+//EOF
@@ -0,0 +1,259 @@
+// Host flash model behind the pstorage API, memory mapped pages with queued operations as on the nRF51
+// Stores may only clear bits of erased words, clears erase whole pages and an update costs a swap page erase
+// Operations are whole, a power loss happens between operations. The block identifiers are 32 bit addresses,
+// so the host tools are linked without PIE and the flash array is in the low 4GB
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "HostFlash.h"
+
+// Definitions
+#define HOST_FLASH_WORDS_PER_PAGE	(PSTORAGE_FLASH_PAGE_SIZE / sizeof(uint32_t))
+
+// Types
+typedef struct {
+	uint32_t base;				// Offset of the first block
+	uint32_t size;				// Blocks total
+	pstorage_size_t block_size;
+	pstorage_ntf_cb_t cb;
+} HostFlashModule_t;
+
+typedef struct {
+	uint8_t op_code;
+	uint32_t module_id;
+	uint32_t offset;			// Flash offset of the first byte
+	uint8_t* source;			// Source data, must not change until run
+	uint32_t length;
+} HostFlashOp_t;
+
+// Globals
+HostFlashCounters_t hostFlashCounters;
+static uint8_t hostFlash[HOST_FLASH_SIZE] __attribute__((aligned(PSTORAGE_FLASH_PAGE_SIZE)));
+static HostFlashModule_t hostFlashModules[PSTORAGE_MAX_APPLICATIONS];
+static uint32_t hostFlashModuleCount;
+static HostFlashOp_t hostFlashQueue[PSTORAGE_CMD_QUEUE_SIZE];
+static uint32_t hostFlashQueueHead, hostFlashQueueCount;
+
+// Prototypes
+static void HostFlashFail(const char* reason, uint32_t offset);
+static bool HostFlashRange(const pstorage_handle_t* handle, uint32_t offset, uint32_t length, uint32_t* start);
+static uint32_t HostFlashQueue(uint8_t op_code, const pstorage_handle_t* handle, uint8_t* source, uint32_t offset, uint32_t length);
+
+// Source
+void HostFlashInit(void)
+{
+	// Block identifiers are 32 bit
+	if(((uintptr_t)hostFlash + HOST_FLASH_SIZE) > 0xFFFFFFFFul)
+		HostFlashFail("flash array above 4GB, link with -no-pie", 0);
+	memset(hostFlash, 0xFF, sizeof(hostFlash));
+	HostFlashRestart();
+	HostFlashCountersClear();
+}
+
+void HostFlashRestart(void)
+{
+	hostFlashModuleCount = 0;
+	hostFlashQueueHead = 0;
+	hostFlashQueueCount = 0;
+}
+
+bool HostFlashRun(void)
+{
+	HostFlashOp_t* op;
+	HostFlashModule_t* module;
+	pstorage_handle_t handle;
+	uint32_t index;
+	if(hostFlashQueueCount == 0)
+		return false;
+	op = &hostFlashQueue[hostFlashQueueHead];
+	hostFlashQueueHead = (hostFlashQueueHead + 1) % PSTORAGE_CMD_QUEUE_SIZE;
+	hostFlashQueueCount--;
+	module = &hostFlashModules[op->module_id];
+	switch(op->op_code)
+	{
+		case PSTORAGE_STORE_OP_CODE:
+			// Programming only clears bits
+			for(index = 0; index < op->length; index++)
+			{
+				if((hostFlash[op->offset + index] & op->source[index]) != op->source[index])
+					HostFlashFail("store sets bits of a written word", op->offset + index);
+				hostFlash[op->offset + index] = op->source[index];
+			}
+			hostFlashCounters.wordsWritten += op->length / sizeof(uint32_t);
+			break;
+		case PSTORAGE_UPDATE_OP_CODE:
+			// The pages are copied to the swap page, erased and written back with the new data
+			memcpy(&hostFlash[op->offset], op->source, op->length);
+			index = ((op->offset + op->length - 1) / PSTORAGE_FLASH_PAGE_SIZE) - (op->offset / PSTORAGE_FLASH_PAGE_SIZE) + 1;
+			hostFlashCounters.pageErases += 2 * index;
+			hostFlashCounters.wordsWritten += 2 * index * HOST_FLASH_WORDS_PER_PAGE;
+			break;
+		case PSTORAGE_CLEAR_OP_CODE:
+			memset(&hostFlash[op->offset], 0xFF, op->length);
+			hostFlashCounters.pageErases += op->length / PSTORAGE_FLASH_PAGE_SIZE;
+			break;
+		default:
+			HostFlashFail("unknown operation", op->offset);
+			break;
+	}
+	// Completion event to the module, with the source of the data
+	handle.module_id = op->module_id;
+	handle.block_id = (uint32_t)(uintptr_t)&hostFlash[op->offset];
+	if(module->cb != NULL)
+		module->cb(&handle, op->op_code, NRF_SUCCESS, op->source, op->length);
+	return true;
+}
+
+void HostFlashRunAll(void)
+{
+	while(HostFlashRun());
+}
+
+void HostFlashPowerLoss(uint32_t keep)
+{
+	while((keep-- > 0) && HostFlashRun());
+	hostFlashQueueCount = 0;
+}
+
+uint32_t HostFlashPending(void)
+{
+	return hostFlashQueueCount;
+}
+
+const uint8_t* HostFlashAddress(uint32_t offset)
+{
+	return &hostFlash[offset];
+}
+
+void HostFlashCountersClear(void)
+{
+	memset(&hostFlashCounters, 0, sizeof(hostFlashCounters));
+}
+
+// pstorage API
+uint32_t pstorage_init(void)
+{
+	HostFlashRestart();
+	return NRF_SUCCESS;
+}
+
+uint32_t pstorage_register(pstorage_module_param_t* p_module_param, pstorage_handle_t* p_block_id)
+{
+	HostFlashModule_t* module;
+	uint32_t base = 0;
+	// Regions follow each other in registration order
+	if(hostFlashModuleCount >= PSTORAGE_MAX_APPLICATIONS)
+		return NRF_ERROR_NO_MEM;
+	if(hostFlashModuleCount > 0)
+	{
+		module = &hostFlashModules[hostFlashModuleCount - 1];
+		base = module->base + module->size;
+	}
+	module = &hostFlashModules[hostFlashModuleCount];
+	module->base = base;
+	module->size = p_module_param->block_size * p_module_param->block_count;
+	module->block_size = p_module_param->block_size;
+	module->cb = p_module_param->cb;
+	if((module->base + module->size) > HOST_FLASH_SIZE)
+		return NRF_ERROR_NO_MEM;
+	p_block_id->module_id = hostFlashModuleCount++;
+	p_block_id->block_id = (uint32_t)(uintptr_t)&hostFlash[base];
+	return NRF_SUCCESS;
+}
+
+uint32_t pstorage_block_identifier_get(pstorage_handle_t* p_base_id, pstorage_size_t block_num, pstorage_handle_t* p_block_id)
+{
+	HostFlashModule_t* module;
+	if(p_base_id->module_id >= hostFlashModuleCount)
+		return NRF_ERROR_INVALID_STATE;
+	module = &hostFlashModules[p_base_id->module_id];
+	if(((block_num + 1) * module->block_size) > module->size)
+		return NRF_ERROR_NO_MEM;
+	p_block_id->module_id = p_base_id->module_id;
+	p_block_id->block_id = (uint32_t)(uintptr_t)&hostFlash[module->base + (block_num * module->block_size)];
+	return NRF_SUCCESS;
+}
+
+uint32_t pstorage_store(pstorage_handle_t* p_dest, uint8_t* p_src, pstorage_size_t size, pstorage_size_t offset)
+{
+	// Word aligned source, destination and length
+	if(((offset | size) % sizeof(uint32_t)) || ((uintptr_t)p_src % sizeof(uint32_t)))
+		HostFlashFail("store not word aligned", offset);
+	return HostFlashQueue(PSTORAGE_STORE_OP_CODE, p_dest, p_src, offset, size);
+}
+
+uint32_t pstorage_update(pstorage_handle_t* p_dest, uint8_t* p_src, pstorage_size_t size, pstorage_size_t offset)
+{
+	return HostFlashQueue(PSTORAGE_UPDATE_OP_CODE, p_dest, p_src, offset, size);
+}
+
+uint32_t pstorage_load(uint8_t* p_dest, pstorage_handle_t* p_src, pstorage_size_t size, pstorage_size_t offset)
+{
+	uint32_t start;
+	// Reads are immediate, from the flash as it is now
+	hostFlashCounters.loads++;
+	if(!HostFlashRange(p_src, offset, size, &start))
+		return NRF_ERROR_NO_MEM;
+	memcpy(p_dest, &hostFlash[start], size);
+	return NRF_SUCCESS;
+}
+
+uint32_t pstorage_clear(pstorage_handle_t* p_base_id, pstorage_size_t size)
+{
+	// Whole pages only, the firmware never clears part of a page
+	if(((p_base_id->block_id - (uint32_t)(uintptr_t)hostFlash) | size) % PSTORAGE_FLASH_PAGE_SIZE)
+		HostFlashFail("clear not whole pages", p_base_id->block_id - (uint32_t)(uintptr_t)hostFlash);
+	return HostFlashQueue(PSTORAGE_CLEAR_OP_CODE, p_base_id, NULL, 0, size);
+}
+
+uint32_t pstorage_access_status_get(uint32_t* p_count)
+{
+	*p_count = hostFlashQueueCount;
+	return NRF_SUCCESS;
+}
+
+static void HostFlashFail(const char* reason, uint32_t offset)
+{
+	fprintf(stderr, "Flash model: %s at 0x%05X\n", reason, (unsigned int)offset);
+	abort();
+}
+
+// Flash offset of a range in a module, false if outside it
+static bool HostFlashRange(const pstorage_handle_t* handle, uint32_t offset, uint32_t length, uint32_t* start)
+{
+	HostFlashModule_t* module;
+	if(handle->module_id >= hostFlashModuleCount)
+		return false;
+	module = &hostFlashModules[handle->module_id];
+	*start = handle->block_id - (uint32_t)(uintptr_t)hostFlash + offset;
+	return (*start >= module->base) && ((*start + length) <= (module->base + module->size));
+}
+
+static uint32_t HostFlashQueue(uint8_t op_code, const pstorage_handle_t* handle, uint8_t* source, uint32_t offset, uint32_t length)
+{
+	HostFlashOp_t* op;
+	uint32_t start;
+	if(!HostFlashRange(handle, offset, length, &start))
+		HostFlashFail("operation outside the module", handle->block_id - (uint32_t)(uintptr_t)hostFlash + offset);
+	if(hostFlashQueueCount >= PSTORAGE_CMD_QUEUE_SIZE)
+		return NRF_ERROR_NO_MEM;
+	op = &hostFlashQueue[(hostFlashQueueHead + hostFlashQueueCount) % PSTORAGE_CMD_QUEUE_SIZE];
+	op->op_code = op_code;
+	op->module_id = handle->module_id;
+	op->offset = start;
+	op->source = source;
+	op->length = length;
+	if(++hostFlashQueueCount > hostFlashCounters.queueHighWater)
+		hostFlashCounters.queueHighWater = hostFlashQueueCount;
+	if(op_code == PSTORAGE_STORE_OP_CODE)
+		hostFlashCounters.stores++;
+	else if(op_code == PSTORAGE_UPDATE_OP_CODE)
+		hostFlashCounters.updates++;
+	else
+		hostFlashCounters.clears++;
+	return NRF_SUCCESS;
+}
+//EOF
@@ -0,0 +1,47 @@
+// Host flash model behind the pstorage API, memory mapped pages with queued operations as on the nRF51
+// Operations run in order when pumped, a power loss drops the operations not yet run
+#ifndef _HOST_FLASH_H_
+#define _HOST_FLASH_H_
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+#include "pstorage.h"
+
+// Definitions
+#define HOST_FLASH_SIZE			(PSTORAGE_NUM_OF_PAGES * PSTORAGE_FLASH_PAGE_SIZE)	// Modules are registered from the start
+
+// Types
+// Flash cost counters, cleared by HostFlashCountersClear
+typedef struct HostFlashCounters_tag {
+	uint32_t pageErases;		// Pages erased, including the swap page of an update
+	uint32_t wordsWritten;		// Words programmed
+	uint32_t stores;			// Store operations
+	uint32_t updates;			// Update operations (backup to the swap page, erase, write back)
+	uint32_t clears;			// Clear operations
+	uint32_t loads;				// Load calls
+	uint32_t queueHighWater;	// Most operations waiting
+} HostFlashCounters_t;
+
+// Globals
+extern HostFlashCounters_t hostFlashCounters;
+
+// Functions
+// Erase the whole flash and clear the registrations and counters
+void HostFlashInit(void);
+// Forget the registrations and queued operations, as after a reset (the flash contents are kept)
+void HostFlashRestart(void);
+// Run the next queued operation, false if there are none
+bool HostFlashRun(void);
+// Run all the queued operations
+void HostFlashRunAll(void);
+// Power loss, runs the first few queued operations and drops the rest
+void HostFlashPowerLoss(uint32_t keep);
+// Operations waiting
+uint32_t HostFlashPending(void);
+// Memory mapped flash at an offset from the first registered module
+const uint8_t* HostFlashAddress(uint32_t offset);
+// Clear the cost counters
+void HostFlashCountersClear(void);
+
+#endif
+//EOF
@@ -0,0 +1,139 @@
+// Host model of the Nordic UART service link, in place of the SoftDevice and ble_nus for a host build of ble_serial.c
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "nrf.h"
+#include "nrf_nvic.h"
+#include "nrf_soc.h"
+#include "ble.h"
+#include "ble_nus.h"
+#include "ble_serial.h"
+#include "HostLink.h"
+
+// Globals
+HostLinkCounters_t hostLinkCounters;
+static HostLinkParams_t hostLinkParams;
+static HostLinkReceiver_t hostLinkReceiver;
+static bool hostLinkConnected;
+static ble_nus_data_handler_t hostLinkDataHandler;
+// Radio packet buffers, notifications are copied in
+static uint8_t hostLinkBuffers[HOST_LINK_TX_BUFFERS][BLE_NUS_MAX_DATA_LEN];
+static uint8_t hostLinkLengths[HOST_LINK_TX_BUFFERS];
+static uint8_t hostLinkHead, hostLinkCount;
+// RTC in 1/25 ticks, a whole number per 1.25ms
+static uint64_t hostLinkRtc;
+// Central write waiting for the write event
+static const char* hostLinkWrite;
+
+// Prototypes
+extern void SWI1_IRQHandler(void);
+
+// Source
+void HostLinkConnect(const HostLinkParams_t* params, HostLinkReceiver_t receiver)
+{
+	ble_evt_t evt = {.header.evt_id = BLE_GAP_EVT_CONNECTED, .header.evt_len = 0};
+	memcpy(&hostLinkParams, params, sizeof(HostLinkParams_t));
+	if(hostLinkParams.packetsPerEvent == 0)
+		hostLinkParams.packetsPerEvent = 1;
+	hostLinkReceiver = receiver;
+	hostLinkHead = 0;
+	hostLinkCount = 0;
+	memset(&hostLinkCounters, 0, sizeof(hostLinkCounters));
+	hostLinkConnected = true;
+	ble_serial_event_handler(&m_nus, &evt);
+}
+
+void HostLinkDisconnect(void)
+{
+	ble_evt_t evt = {.header.evt_id = BLE_GAP_EVT_DISCONNECTED, .header.evt_len = 0};
+	hostLinkConnected = false;
+	hostLinkCount = 0;
+	ble_serial_event_handler(&m_nus, &evt);
+}
+
+void HostLinkWrite(const char* data)
+{
+	ble_evt_t evt = {.header.evt_id = BLE_GATTS_EVT_WRITE, .header.evt_len = 0};
+	// The service passes the written value to its data handler
+	hostLinkWrite = data;
+	ble_serial_event_handler(&m_nus, &evt);
+	hostLinkWrite = NULL;
+}
+
+void HostLinkEvent(void)
+{
+	uint8_t sent;
+	if(!hostLinkConnected)
+		return;
+	hostLinkCounters.events++;
+	// Buffered notifications go out in this event, up to the most the central takes
+	for(sent = 0; (sent < hostLinkParams.packetsPerEvent) && (hostLinkCount > 0); sent++)
+	{
+		hostLinkCounters.packets++;
+		hostLinkCounters.payload += hostLinkLengths[hostLinkHead];
+		hostLinkCounters.air += hostLinkLengths[hostLinkHead] + HOST_LINK_OVERHEAD;
+		if(hostLinkReceiver != NULL)
+			hostLinkReceiver(hostLinkBuffers[hostLinkHead], hostLinkLengths[hostLinkHead]);
+		hostLinkHead = (hostLinkHead + 1) % HOST_LINK_TX_BUFFERS;
+		hostLinkCount--;
+	}
+	if(sent > 0)
+		hostLinkCounters.eventsUsed++;
+	// The RTC (32768Hz, 24 bit) runs on over connections, for the burst timing of the firmware
+	hostLinkRtc += hostLinkParams.interval * 1024ul;
+	NRF_RTC1->COUNTER = (uint32_t)(hostLinkRtc / 25) & 0x00FFFFFF;
+	// Radio inactive at the end of the event
+	SWI1_IRQHandler();
+}
+
+uint32_t HostLinkTime(void)
+{
+	return (uint32_t)(((uint64_t)hostLinkCounters.events * hostLinkParams.interval * 5) / 4);
+}
+
+uint8_t HostLinkBuffered(void)
+{
+	return hostLinkCount;
+}
+
+// Nordic UART service
+uint32_t ble_nus_init(ble_nus_t* p_nus, const ble_nus_init_t* p_nus_init)
+{
+	p_nus->data_handler = p_nus_init->data_handler;
+	hostLinkDataHandler = p_nus_init->data_handler;
+	return NRF_SUCCESS;
+}
+
+void ble_nus_on_ble_evt(ble_nus_t* p_nus, ble_evt_t* p_ble_evt)
+{
+	if((p_ble_evt->header.evt_id == BLE_GATTS_EVT_WRITE) && (hostLinkWrite != NULL) && (hostLinkDataHandler != NULL))
+		hostLinkDataHandler(p_nus, (uint8_t*)hostLinkWrite, (uint16_t)strlen(hostLinkWrite));
+}
+
+uint32_t ble_nus_string_send(ble_nus_t* p_nus, uint8_t* p_string, uint16_t length)
+{
+	uint8_t tail;
+	if(!hostLinkConnected)
+		return NRF_ERROR_INVALID_STATE;
+	if(length > BLE_NUS_MAX_DATA_LEN)
+		return NRF_ERROR_INVALID_PARAM;
+	if(hostLinkCount >= HOST_LINK_TX_BUFFERS)
+	{
+		hostLinkCounters.refused++;
+		return BLE_ERROR_NO_TX_PACKETS;
+	}
+	// The data is copied, as by the SoftDevice
+	tail = (hostLinkHead + hostLinkCount) % HOST_LINK_TX_BUFFERS;
+	memcpy(hostLinkBuffers[tail], p_string, length);
+	hostLinkLengths[tail] = (uint8_t)length;
+	hostLinkCount++;
+	return NRF_SUCCESS;
+}
+
+// SoftDevice interrupt and radio notification set up, nothing to do
+uint32_t sd_nvic_ClearPendingIRQ(int irq)								{ return NRF_SUCCESS; }
+uint32_t sd_nvic_SetPriority(int irq, uint32_t priority)				{ return NRF_SUCCESS; }
+uint32_t sd_nvic_EnableIRQ(int irq)										{ return NRF_SUCCESS; }
+uint32_t sd_radio_notification_cfg_set(uint8_t type, uint8_t distance)	{ return NRF_SUCCESS; }
+//EOF
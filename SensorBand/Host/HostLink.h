@@ -0,0 +1,53 @@
+// Host model of the Nordic UART service link, in place of the SoftDevice and ble_nus for a host build of ble_serial.c
+// Notifications are queued in the radio packet buffers and sent at the next connection event, up to a number per
+// event. The radio inactive notification (SWI1) follows each event and refills the buffers from the serial queues
+// The RTC1 counter is set from the link time at each event
+#ifndef _HOST_LINK_H_
+#define _HOST_LINK_H_
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+
+// Definitions
+#define HOST_LINK_TX_BUFFERS		7		// S130 application packet buffers
+#define HOST_LINK_OVERHEAD			(10 + 4 + 3)	// Bytes on air per notification besides the payload: link layer, L2CAP, ATT
+
+// Types
+// Link timing, in connection events and 1.25ms units as the SoftDevice
+typedef struct HostLinkParams_tag {
+	uint16_t interval;			// Connection interval, 1.25ms units
+	uint8_t packetsPerEvent;	// Notifications sent in one connection event (phone dependent)
+} HostLinkParams_t;
+
+// Link counters, cleared when connected
+typedef struct HostLinkCounters_tag {
+	uint32_t events;			// Connection events
+	uint32_t eventsUsed;		// Connection events with notifications sent
+	uint32_t packets;			// Notifications sent
+	uint32_t payload;			// Notification payload bytes sent
+	uint32_t air;				// Bytes on air, payload and per packet overhead
+	uint32_t refused;			// Notifications refused, buffers full
+} HostLinkCounters_t;
+
+// Central side receiver, notification payloads as they arrive
+typedef void (*HostLinkReceiver_t)(const uint8_t* data, uint16_t length);
+
+// Globals
+extern HostLinkCounters_t hostLinkCounters;
+
+// Functions
+// Connect at the link timing, the receiver gets all the notifications
+void HostLinkConnect(const HostLinkParams_t* params, HostLinkReceiver_t receiver);
+// Disconnect, packets not yet sent are lost
+void HostLinkDisconnect(void);
+// Central writes to the RX characteristic, delivered at once as the SoftDevice write event
+void HostLinkWrite(const char* data);
+// Run one connection event: buffered packets are sent, then the radio inactive notification
+void HostLinkEvent(void);
+// Time connected, milliseconds
+uint32_t HostLinkTime(void);
+// Notifications waiting in the radio buffers
+uint8_t HostLinkBuffered(void);
+
+#endif
+//EOF
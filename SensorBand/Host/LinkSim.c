@@ -0,0 +1,316 @@
+// Host simulation of an epoch block download over the serial link, each block is decoded and checked bit exact
+// The logger (acc_tasks.c), serial driver (ble_serial.c, Queue.c), read commands (SerialRead.c), hex, codec and
+// CRC modules are the firmware sources built for the host, with the flash and link models. The client queries the
+// logger ("Q") before each download and checks the reply
+//	LinkSim							Every read mode at 30ms, then the time and events over a range of link timings
+//	LinkSim <interval> <packets>	Every read mode at the given link timing (interval in 1.25ms units)
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ble_nus.h"
+#include "pstorage.h"
+#include "ble_serial.h"
+#include "acc_tasks.h"
+#include "AsciiHex.h"
+#include "SerialRead.h"
+#include "HostBoard.h"
+#include "HostFlash.h"
+#include "HostLink.h"
+#include "FrameDecode.h"
+
+// Definitions
+#define LINK_SIM_DAYS			30						// Logged before the download, the store wraps
+#define LINK_SIM_EVENT_LIMIT	2000000ul				// Give up, the download is stuck
+
+// Types
+typedef struct LinkSimMode_tag {
+	const char* name;
+	const char* setup;		// Command sent once first, or NULL
+	const char* request;	// Command sent for each block, or once for a burst
+	bool burst;				// Blocks are sent while the client gives credits
+} LinkSimMode_t;
+
+// Globals
+static const LinkSimMode_t linkSimModes[] = {
+	{ "R hex",		NULL,	"R",	false },
+	{ "RB raw",		NULL,	"RB",	false },
+	{ "RB packed",	"RE1",	"RB",	false },
+	{ "RM raw",		NULL,	"RM",	true },
+	{ "RM packed",	"RE1",	"RM",	true },
+};
+// Link timings of the sweep, from the shortest interval to a phone saving power
+static const HostLinkParams_t linkSimParams[] = {
+	{ 6, 3 }, { 6, 6 }, { 12, 3 }, { 12, 6 }, { 24, 3 }, { 24, 6 }, { 40, 3 }, { 40, 6 },
+};
+static FrameDecoder_t linkSimDecoder;
+static struct {
+	uint16_t index;			// Next block expected
+	uint16_t blocks;		// Blocks received
+	uint16_t stored;		// Blocks with epochs
+	uint32_t epochs;		// Epochs in the blocks received
+	uint16_t errors;		// Blocks not matching the store
+	uint16_t replies;		// Other text lines
+	bool waiting;			// Request sent, block not yet received
+	uint16_t credits;		// Burst blocks received, not yet given back as credits
+	bool ended;				// Burst end frame received
+	uint8_t query;			// Query reply lines matching the logger
+	uint32_t endTicks;		// Burst timing of the end frame
+	uint32_t endEvents;
+} linkSimClient;
+
+// Prototypes
+static void LinkSimLog(uint32_t days);
+static void LinkSimSerialTasks(void);
+static void LinkSimReceive(const uint8_t* data, uint16_t length);
+static void LinkSimLine(const char* line, uint16_t length);
+static void LinkSimFrame(uint8_t type, const uint8_t* payload, uint16_t length);
+static void LinkSimBlock(uint16_t index, const Epoch_block_t* block);
+static bool LinkSimDownload(const LinkSimMode_t* mode, const HostLinkParams_t* params);
+
+// Source
+int main(int argc, char* argv[])
+{
+	HostLinkParams_t params = {24, 6};	// 30ms interval, 6 packets per event
+	uint8_t mode, timing;
+	bool ok = true;
+	if(argc > 2)
+	{
+		params.interval = (uint16_t)atoi(argv[1]);
+		params.packetsPerEvent = (uint8_t)atoi(argv[2]);
+	}
+	HostFlashInit();
+	LinkSimLog(LINK_SIM_DAYS);
+	ble_serial_service_init();
+	status.authenticated = true;
+
+	// Every mode in detail, the device time is the burst end frame
+	printf("Download of %u blocks, %.2f ms interval, %u packets per event\n", (unsigned int)EPOCH_NVM_BLOCK_COUNT,
+		params.interval * 1.25, (unsigned int)params.packetsPerEvent);
+	printf("%-10s %8s %8s %8s %8s %8s %8s %8s\n", "Mode", "Payload", "Air", "Per blk", "Packets", "Events", "Time s", "Device s");
+	for(mode = 0; mode < (sizeof(linkSimModes) / sizeof(LinkSimMode_t)); mode++)
+	{
+		if(!LinkSimDownload(&linkSimModes[mode], &params))
+			ok = false;
+		printf("%-10s %8lu %8lu %8lu %8lu %8lu %8.1f", linkSimModes[mode].name,
+			(unsigned long)hostLinkCounters.payload, (unsigned long)hostLinkCounters.air,
+			(unsigned long)(hostLinkCounters.air / EPOCH_NVM_BLOCK_COUNT), (unsigned long)hostLinkCounters.packets,
+			(unsigned long)hostLinkCounters.events, HostLinkTime() / 1000.0);
+		if(linkSimModes[mode].burst)
+			printf(" %8.1f\n", linkSimClient.endTicks / 32768.0);
+		else
+			printf(" %8s\n", "-");
+	}
+	printf("%u blocks with %lu epochs, %s\n", linkSimClient.stored, (unsigned long)linkSimClient.epochs, ok ? "all blocks match" : "FAILED");
+	if(argc > 2)
+		return ok ? 0 : 1;
+
+	// Time and connection events of a full download over the link timings
+	printf("Download time s (connection events) by link timing\n");
+	printf("%-14s", "Interval/pkts");
+	for(mode = 0; mode < (sizeof(linkSimModes) / sizeof(LinkSimMode_t)); mode++)
+		printf(" %15s", linkSimModes[mode].name);
+	printf("\n");
+	for(timing = 0; timing < (sizeof(linkSimParams) / sizeof(HostLinkParams_t)); timing++)
+	{
+		printf("%8.2fms/%-3u", linkSimParams[timing].interval * 1.25, (unsigned int)linkSimParams[timing].packetsPerEvent);
+		for(mode = 0; mode < (sizeof(linkSimModes) / sizeof(LinkSimMode_t)); mode++)
+		{
+			if(!LinkSimDownload(&linkSimModes[mode], &linkSimParams[timing]))
+				ok = false;
+			printf(" %6.1f (%6lu)", HostLinkTime() / 1000.0, (unsigned long)hostLinkCounters.events);
+		}
+		printf("\n");
+	}
+	printf("%s\n", ok ? "All downloads match" : "FAILED");
+	return ok ? 0 : 1;
+}
+
+// Log synthetic epochs through the firmware logger
+static void LinkSimLog(uint32_t days)
+{
+	Epoch_sample_t epoch;
+	uint32_t minute, time = 1500000000ul;
+	HostRandomSeed(12345);
+	settings.epochPeriod = 60;
+	if(!AccelEpochLoggerInit())
+		exit(1);
+	HostFlashRunAll();
+	for(minute = 0; minute < (days * 24 * 60); minute++)
+	{
+		HostEpochSample(minute, epoch.b);
+		status.epochCloseTime = time + (minute * 60);
+		rtcEpochTriplicate[0] = status.epochCloseTime;
+		AccelPstorageAddEpoch(&epoch);
+		HostFlashRunAll();
+	}
+}
+
+// The block read and query commands of serial_tasks() in main.c, replies are sent ahead of the bulk data
+static void LinkSimSerialTasks(void)
+{
+	uint8_t buffer[SERIAL_READ_BUFFER_LEN + 1];
+	uint16_t length;
+	length = ble_serial_service_receive(buffer, SERIAL_READ_BUFFER_LEN);
+	if(length == 0)
+		return;
+	if((buffer[0] == 'R') || (buffer[0] == 'r'))
+		length = SerialReadCommand(buffer, length);
+	else if((buffer[0] == 'Q') || (buffer[0] == 'q'))
+		length = SerialReadQuery(buffer);
+	else
+		return;
+	if(length > 0)
+		ble_serial_control_send(buffer, length);
+}
+
+// Central side
+static void LinkSimReceive(const uint8_t* data, uint16_t length)
+{
+	FrameDecodeAdd(&linkSimDecoder, data, length);
+}
+
+static void LinkSimLine(const char* line, uint16_t length)
+{
+	Epoch_block_t block;
+	unsigned long value;
+	// Query reply, the time, newest block number and block count
+	if((length > 2) && (line[1] == ':') && (sscanf(&line[2], "%lu", &value) == 1))
+	{
+		if(	((line[0] == 'T') && (value == rtcEpochTriplicate[0])) ||
+			((line[0] == 'B') && (value == activeEpochBlock.info.block_number)) ||
+			((line[0] == 'C') && (value == EPOCH_NVM_BLOCK_COUNT)) )
+			linkSimClient.query++;
+		linkSimClient.replies++;
+		return;
+	}
+	// Hex blocks are in index order from the read position
+	if(!FrameDecodeHexBlock(line, length, &block))
+	{
+		linkSimClient.replies++;
+		return;
+	}
+	LinkSimBlock(linkSimClient.index, &block);
+}
+
+static void LinkSimFrame(uint8_t type, const uint8_t* payload, uint16_t length)
+{
+	Epoch_block_t block;
+	uint16_t index;
+	switch(type)
+	{
+		case BLE_FRAME_TYPE_EPOCH_BLOCK:
+			if(length != (sizeof(uint16_t) + EPOCH_NVM_BLOCK_SIZE))
+			{
+				linkSimClient.errors++;
+				break;
+			}
+			memcpy(&index, payload, sizeof(uint16_t));
+			memcpy(&block, &payload[sizeof(uint16_t)], EPOCH_NVM_BLOCK_SIZE);
+			LinkSimBlock(index, &block);
+			break;
+		case BLE_FRAME_TYPE_BURST_END:
+			// Next index and none left, the timing is kept for the report
+			if((length != 12) || (payload[0] != 0) || (payload[1] != 0) || (payload[2] != 0) || (payload[3] != 0))
+				linkSimClient.errors++;
+			memcpy(&linkSimClient.endTicks, &payload[4], sizeof(uint32_t));
+			memcpy(&linkSimClient.endEvents, &payload[8], sizeof(uint32_t));
+			linkSimClient.ended = true;
+			break;
+		case BLE_FRAME_TYPE_PACKED_BLOCK:
+			// Rebuilt as stored, the same bytes as a raw frame
+			if(!FrameDecodePackedBlock(payload, length, &index, &block))
+			{
+				linkSimClient.errors++;
+				break;
+			}
+			LinkSimBlock(index, &block);
+			break;
+		default:
+			linkSimClient.replies++;
+			break;
+	}
+}
+
+// Check a received block against the store, as read on the device
+static void LinkSimBlock(uint16_t index, const Epoch_block_t* block)
+{
+	Epoch_block_t stored;
+	Epoch_sample_t samples[EPOCH_BLOCK_PACKED_COUNT];
+	if(	(index != linkSimClient.index) ||
+		!AccelEpochBlockRead((uint8_t*)&stored, 0, EPOCH_NVM_BLOCK_SIZE, index) ||
+		(memcmp(&stored, block, EPOCH_NVM_BLOCK_SIZE) != 0) ||
+		((block->info.block_number <= EPOCH_BLOCK_NUMBER_LAST) && !FrameDecodeBlockCheck(block)) )
+	{
+		fprintf(stderr, "Block %u does not match\n", index);
+		linkSimClient.errors++;
+	}
+	if(block->info.block_number <= EPOCH_BLOCK_NUMBER_LAST)
+	{
+		linkSimClient.stored++;
+		linkSimClient.epochs += FrameDecodeBlockSamples(block, samples, EPOCH_BLOCK_PACKED_COUNT);
+	}
+	linkSimClient.index = (index + 1) % EPOCH_NVM_BLOCK_COUNT;
+	linkSimClient.blocks++;
+	linkSimClient.credits++;
+	linkSimClient.waiting = false;
+}
+
+// Read every block from index zero, one request per block or one burst given a credit back for each block
+static bool LinkSimDownload(const LinkSimMode_t* mode, const HostLinkParams_t* params)
+{
+	char command[SERIAL_READ_BUFFER_LEN];
+	FrameDecodeInit(&linkSimDecoder, LinkSimLine, LinkSimFrame);
+	memset(&linkSimClient, 0, sizeof(linkSimClient));
+	status.epochReadIndex = 0;
+	status.transferEncoding = TRANSFER_ENCODING_RAW;
+	HostLinkConnect(params, LinkSimReceive);
+	HostLinkWrite("Q");
+	LinkSimSerialTasks();
+	if(mode->setup != NULL)
+	{
+		HostLinkWrite(mode->setup);
+		LinkSimSerialTasks();
+	}
+	if(mode->burst)
+	{
+		HostLinkWrite(mode->request);
+		LinkSimSerialTasks();
+		linkSimClient.waiting = true;
+		linkSimClient.credits = 0;
+	}
+	while(((linkSimClient.blocks < EPOCH_NVM_BLOCK_COUNT) || (mode->burst && !linkSimClient.ended)) && (hostLinkCounters.events < LINK_SIM_EVENT_LIMIT))
+	{
+		// One write per event, the input queue does not keep commands apart
+		if(mode->burst && (linkSimClient.credits > 0) && (linkSimClient.blocks < EPOCH_NVM_BLOCK_COUNT))
+		{
+			// Credits for the blocks received, hex little endian
+			sprintf(command, "RG%02X%02X", linkSimClient.credits & 0xFF, linkSimClient.credits >> 8);
+			HostLinkWrite(command);
+			linkSimClient.credits = 0;
+		}
+		// The next request is written in the event after the last block is received
+		else if(!mode->burst && !linkSimClient.waiting)
+		{
+			HostLinkWrite(mode->request);
+			linkSimClient.waiting = true;
+		}
+		HostLinkEvent();
+		// Main loop, commands are handled between connection events, then the burst continues as the queue empties
+		if(serial_in_queue_flag)
+			LinkSimSerialTasks();
+		if(serial_out_queue_flag)
+		{
+			serial_out_queue_flag = false;
+			SerialBurstTasks();
+		}
+	}
+	HostLinkDisconnect();
+	if(linkSimClient.query != 3)
+		fprintf(stderr, "Query reply does not match\n");
+	return (linkSimClient.blocks == EPOCH_NVM_BLOCK_COUNT) && (linkSimClient.query == 3) && (linkSimClient.errors == 0) && (linkSimDecoder.errors == 0);
+}
+//EOF
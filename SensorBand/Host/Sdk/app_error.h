@@ -0,0 +1,12 @@
+// Host build stand-in for the SDK header, the host tools report faults
+#ifndef _HOST_APP_ERROR_H_
+#define _HOST_APP_ERROR_H_
+#include <stdint.h>
+
+void app_error_fault_handler(uint32_t id, uint32_t pc, uint32_t info);
+void app_error_handler(uint32_t error_code, uint32_t line_num, const uint8_t* p_file_name);
+
+#define APP_ERROR_CHECK(_err)		do { if((_err) != 0) app_error_handler((_err), __LINE__, (const uint8_t*)__FILE__); } while(0)
+
+#endif
+//EOF
@@ -0,0 +1,10 @@
+// Host build stand-in for the SDK header, only what the firmware sources use
+#ifndef _HOST_APP_SCHEDULER_H_
+#define _HOST_APP_SCHEDULER_H_
+#include <stdint.h>
+
+typedef void (*app_sched_event_handler_t)(void* p_event_data, uint16_t event_size);
+uint32_t app_sched_event_put(void* p_event_data, uint16_t event_size, app_sched_event_handler_t handler);
+
+#endif
+//EOF
@@ -0,0 +1 @@
+// Host build stand-in for the SDK header, nothing is used
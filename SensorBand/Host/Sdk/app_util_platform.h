@@ -0,0 +1,8 @@
+// Host build stand-in for the SDK header, only what the firmware sources use
+#ifndef _HOST_APP_UTIL_PLATFORM_H_
+#define _HOST_APP_UTIL_PLATFORM_H_
+
+#define APP_IRQ_PRIORITY_LOW		3
+
+#endif
+//EOF
@@ -0,0 +1,22 @@
+// Host build stand-in for the SDK header, only what the firmware sources use
+#ifndef _HOST_BLE_H_
+#define _HOST_BLE_H_
+#include "nordic_common.h"
+
+#define BLE_EVT_TX_COMPLETE			0x01
+#define BLE_GAP_EVT_CONNECTED		0x10
+#define BLE_GAP_EVT_DISCONNECTED	0x11
+#define BLE_GATTS_EVT_WRITE			0x50
+#define BLE_GATTS_EVT_HVC			0x53
+
+typedef struct {
+	uint16_t evt_id;
+	uint16_t evt_len;
+} ble_evt_hdr_t;
+
+typedef struct {
+	ble_evt_hdr_t header;
+} ble_evt_t;
+
+#endif
+//EOF
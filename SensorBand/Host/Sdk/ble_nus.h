@@ -0,0 +1,22 @@
+// Host build stand-in for the SDK header, implemented by the link model in HostLink.c
+#ifndef _HOST_BLE_NUS_H_
+#define _HOST_BLE_NUS_H_
+#include "ble.h"
+
+#define BLE_NUS_MAX_DATA_LEN		20
+
+typedef struct ble_nus_s ble_nus_t;
+typedef void (*ble_nus_data_handler_t)(ble_nus_t* p_nus, uint8_t* p_data, uint16_t length);
+struct ble_nus_s {
+	ble_nus_data_handler_t data_handler;
+};
+typedef struct {
+	ble_nus_data_handler_t data_handler;
+} ble_nus_init_t;
+
+uint32_t ble_nus_init(ble_nus_t* p_nus, const ble_nus_init_t* p_nus_init);
+void ble_nus_on_ble_evt(ble_nus_t* p_nus, ble_evt_t* p_ble_evt);
+uint32_t ble_nus_string_send(ble_nus_t* p_nus, uint8_t* p_string, uint16_t length);
+
+#endif
+//EOF
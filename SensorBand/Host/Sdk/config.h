@@ -0,0 +1,2 @@
+// Host build, the hardware profile includes the configuration in lower case
+#include "Config.h"
@@ -0,0 +1,18 @@
+// Host build stand-in for the SDK header, only what the firmware sources use
+#ifndef _HOST_NORDIC_COMMON_H_
+#define _HOST_NORDIC_COMMON_H_
+#include "nrf.h"
+
+#define NRF_SUCCESS					0
+#define NRF_ERROR_NO_MEM			4
+#define NRF_ERROR_INVALID_PARAM		7
+#define NRF_ERROR_INVALID_STATE		8
+#define BLE_ERROR_NO_TX_PACKETS		0x3004
+#define UNIT_1_25_MS				1250
+
+typedef uint32_t ret_code_t;
+
+#include "app_error.h"
+
+#endif
+//EOF
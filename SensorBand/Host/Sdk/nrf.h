@@ -0,0 +1,19 @@
+// Host build stand-in for the SDK header, only what the firmware sources use
+#ifndef _HOST_NRF_H_
+#define _HOST_NRF_H_
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>		// The firmware sources get sprintf through the SDK headers
+
+// Peripheral registers used in the hardware profile macros
+typedef struct { volatile uint32_t OUT, OUTSET, OUTCLR, IN, DIR, DIRSET, DIRCLR, PIN_CNF[32]; } NRF_GPIO_Type;
+typedef struct { volatile uint32_t DCDCEN; } NRF_POWER_Type;
+typedef struct { volatile uint32_t COUNTER; } NRF_RTC_Type;
+extern NRF_GPIO_Type* NRF_GPIO;
+extern NRF_POWER_Type* NRF_POWER;
+extern NRF_RTC_Type* NRF_RTC1;
+
+#define RADIO_NOTIFICATION_IRQn		1
+
+#endif
+//EOF
@@ -0,0 +1,9 @@
+// Host build stand-in for the SDK header, only what the firmware sources use
+#ifndef _HOST_NRF_DELAY_H_
+#define _HOST_NRF_DELAY_H_
+#include <stdint.h>
+
+void nrf_delay_ms(uint32_t ms);
+
+#endif
+//EOF
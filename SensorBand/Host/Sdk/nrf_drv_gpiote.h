@@ -0,0 +1,24 @@
+// Host build stand-in for the SDK header, only what the firmware sources use
+#ifndef _HOST_NRF_DRV_GPIOTE_H_
+#define _HOST_NRF_DRV_GPIOTE_H_
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef uint32_t nrf_drv_gpiote_pin_t;
+typedef int nrf_gpiote_polarity_t;
+typedef void (*nrf_drv_gpiote_evt_handler_t)(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action);
+typedef struct {
+	bool hi_accuracy;
+} nrf_drv_gpiote_in_config_t;
+
+#define GPIOTE_CONFIG_IN_SENSE_LOTOHI(_hi_accu)	{ .hi_accuracy = (_hi_accu) }
+
+bool nrf_drv_gpiote_is_init(void);
+uint32_t nrf_drv_gpiote_init(void);
+void nrf_drv_gpiote_uninit(void);
+uint32_t nrf_drv_gpiote_in_init(nrf_drv_gpiote_pin_t pin, nrf_drv_gpiote_in_config_t const* p_config, nrf_drv_gpiote_evt_handler_t evt_handler);
+void nrf_drv_gpiote_in_event_enable(nrf_drv_gpiote_pin_t pin, bool int_enable);
+void nrf_drv_gpiote_in_event_disable(nrf_drv_gpiote_pin_t pin);
+
+#endif
+//EOF
@@ -0,0 +1,11 @@
+// Host build stand-in for the SDK header, only what the firmware sources use
+#ifndef _HOST_NRF_GPIO_H_
+#define _HOST_NRF_GPIO_H_
+#include "nrf.h"
+
+#define nrf_gpio_pin_set(_pin)		(NRF_GPIO->OUTSET = (1ul << (_pin)))
+#define nrf_gpio_pin_clear(_pin)	(NRF_GPIO->OUTCLR = (1ul << (_pin)))
+#define nrf_gpio_pin_toggle(_pin)	(NRF_GPIO->OUT ^= (1ul << (_pin)))
+
+#endif
+//EOF
@@ -0,0 +1,11 @@
+// Host build stand-in for the SDK header, only what the firmware sources use
+#ifndef _HOST_NRF_NVIC_H_
+#define _HOST_NRF_NVIC_H_
+#include <stdint.h>
+
+uint32_t sd_nvic_ClearPendingIRQ(int irq);
+uint32_t sd_nvic_SetPriority(int irq, uint32_t priority);
+uint32_t sd_nvic_EnableIRQ(int irq);
+
+#endif
+//EOF
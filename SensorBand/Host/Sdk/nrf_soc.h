@@ -0,0 +1,12 @@
+// Host build stand-in for the SDK header, only what the firmware sources use
+#ifndef _HOST_NRF_SOC_H_
+#define _HOST_NRF_SOC_H_
+#include <stdint.h>
+
+#define NRF_RADIO_NOTIFICATION_TYPE_INT_ON_INACTIVE	2
+#define NRF_RADIO_NOTIFICATION_DISTANCE_NONE		0
+
+uint32_t sd_radio_notification_cfg_set(uint8_t type, uint8_t distance);
+
+#endif
+//EOF
@@ -0,0 +1,2 @@
+// Host build, the firmware includes the Flux utilities folder in lower case
+#include "Utils/Queue.h"
@@ -0,0 +1,152 @@
+// StreamCodec round trip test and the stream bytes per sample, from synthetic or recorded FIFO batches
+//	StreamCodecTest					Round trip of random batches and typical synthetic movement
+//	StreamCodecTest <samples.bin>	Also replay a recording of accel_t samples (int16_t x, y, z little endian)
+// Include
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "StreamCodec.h"
+#include "HostBoard.h"
+
+// Definitions
+#define STREAM_TEST_BATCH		25				// Samples per FIFO batch (ACCEL_FIFO_WATERMARK)
+#define STREAM_TEST_BATCHES		20000			// Random batches for the round trip
+#define STREAM_TEST_SAMPLES		(100ul * 600)	// Ten minutes at 100Hz for each movement
+#define STREAM_TEST_FRAME		(4 + 12)		// Frame header and the batch info, as acc_tasks.c
+#define STREAM_TEST_SHIFT		4				// High resolution (ctrl_reg4 0xA8) samples are left justified 12 bit
+#define STREAM_TEST_1G			250.0			// Counts of 1g at +/-8g, 12 bit
+
+// Globals
+static int16_t samples[STREAM_TEST_SAMPLES * STREAM_CODEC_AXES];
+static int16_t decoded[STREAM_TEST_BATCH * STREAM_CODEC_AXES];
+static uint8_t encoded[STREAM_CODEC_MAX_LEN(STREAM_TEST_BATCH) + 1];
+static uint32_t failures;
+
+// Prototypes
+static void StreamTestMovement(uint32_t count, double amplitude, double frequency);
+static void StreamTestReport(const char* name, uint32_t count);
+static void StreamTestFail(const char* reason, uint32_t batch);
+
+// Source
+int main(int argc, char* argv[])
+{
+	uint32_t batch, index, count, length;
+	uint8_t style;
+	clock_t start;
+	volatile uint32_t sink = 0;
+
+	// Random batches of every size, each must decode to the same samples and fail if cut short
+	HostRandomSeed(8);
+	for(batch = 0; batch < STREAM_TEST_BATCHES; batch++)
+	{
+		count = 1 + (batch % STREAM_TEST_BATCH);
+		style = (batch / STREAM_TEST_BATCH) % 4;
+		for(index = 0; index < (count * STREAM_CODEC_AXES); index++)
+		{
+			if(style == 0)
+				samples[index] = (index < STREAM_CODEC_AXES) ? (int16_t)HostRandom() : samples[index - STREAM_CODEC_AXES];
+			else if(style == 1)
+				samples[index] = (int16_t)(((index < STREAM_CODEC_AXES) ? (int16_t)HostRandom() : samples[index - STREAM_CODEC_AXES]) + (int16_t)(HostRandom() % 33) - 16);
+			else if(style == 2)
+				samples[index] = (HostRandom() & 1) ? INT16_MAX : INT16_MIN;
+			else
+				samples[index] = (int16_t)HostRandom();
+		}
+		length = StreamCodecEncode(encoded, samples, count);
+		if(length > STREAM_CODEC_MAX_LEN(count))
+			StreamTestFail("encoding longer than the limit", batch);
+		if(!StreamCodecDecode(encoded, length, decoded, count) || (memcmp(decoded, samples, count * STREAM_CODEC_AXES * sizeof(int16_t)) != 0))
+			StreamTestFail("round trip", batch);
+		if(StreamCodecDecode(encoded, length - 1, decoded, count))
+			StreamTestFail("short encoding decoded", batch);
+	}
+	printf("Round trip of %u random batches: %s\n", STREAM_TEST_BATCHES, (failures == 0) ? "ok" : "FAILED");
+
+	// Typical movement in FIFO batches, against 6 bytes per sample of the 'I' frames
+	printf("Bytes per sample in %u sample batches, payload and with the frame (raw 'I' frames %.2f):\n",
+		STREAM_TEST_BATCH, (STREAM_CODEC_AXES * sizeof(int16_t)) + (double)STREAM_TEST_FRAME / STREAM_TEST_BATCH);
+	StreamTestMovement(STREAM_TEST_SAMPLES, 0.0, 0.0);
+	StreamTestReport("still", STREAM_TEST_SAMPLES);
+	StreamTestMovement(STREAM_TEST_SAMPLES, 0.3, 1.8);
+	StreamTestReport("walking", STREAM_TEST_SAMPLES);
+	StreamTestMovement(STREAM_TEST_SAMPLES, 1.2, 2.8);
+	StreamTestReport("running", STREAM_TEST_SAMPLES);
+
+	// A recording, whole batches only
+	if(argc > 1)
+	{
+		FILE* file = fopen(argv[1], "rb");
+		if(file == NULL)
+		{
+			fprintf(stderr, "Cannot open %s\n", argv[1]);
+			return 1;
+		}
+		count = fread(samples, STREAM_CODEC_AXES * sizeof(int16_t), STREAM_TEST_SAMPLES, file);
+		fclose(file);
+		StreamTestReport(argv[1], count - (count % STREAM_TEST_BATCH));
+	}
+
+	// Encode cost of a batch, host time for comparing changes (not the M0 cycle count)
+	StreamTestMovement(STREAM_TEST_SAMPLES, 0.3, 1.8);
+	start = clock();
+	for(batch = 0; batch < (STREAM_TEST_SAMPLES / STREAM_TEST_BATCH); batch++)
+		sink += StreamCodecEncode(encoded, &samples[batch * STREAM_TEST_BATCH * STREAM_CODEC_AXES], STREAM_TEST_BATCH);
+	printf("Encode %u samples: %.0f ns per batch on the host\n", STREAM_TEST_BATCH,
+		((double)(clock() - start) / CLOCKS_PER_SEC * 1e9) / (STREAM_TEST_SAMPLES / STREAM_TEST_BATCH));
+	return (failures == 0) ? 0 : 1;
+}
+
+// Gravity turning slowly, a periodic movement on top and sensor noise, 100Hz samples as read from the FIFO
+static void StreamTestMovement(uint32_t count, double amplitude, double frequency)
+{
+	uint32_t index;
+	uint8_t axis;
+	double t, angle, value[STREAM_CODEC_AXES];
+	for(index = 0; index < count; index++)
+	{
+		t = index / 100.0;
+		angle = 0.3 * sin(t / 20.0) + amplitude * 0.2 * sin(2 * M_PI * frequency * t / 2);
+		value[0] = sin(angle) + amplitude * 0.5 * sin(2 * M_PI * frequency * t + 1.0);
+		value[1] = 0.2 * cos(t / 30.0) + amplitude * 0.3 * sin(2 * M_PI * frequency * t / 2);
+		value[2] = cos(angle) + amplitude * sin(2 * M_PI * frequency * t);
+		for(axis = 0; axis < STREAM_CODEC_AXES; axis++)
+		{
+			int32_t counts = (int32_t)lround(value[axis] * STREAM_TEST_1G) + (int32_t)(HostRandom() % 5) - 2;
+			if(counts > 2047)
+				counts = 2047;
+			if(counts < -2048)
+				counts = -2048;
+			samples[(index * STREAM_CODEC_AXES) + axis] = (int16_t)(counts * (1 << STREAM_TEST_SHIFT));
+		}
+	}
+}
+
+// Encode the samples in batches, checking each decodes
+static void StreamTestReport(const char* name, uint32_t count)
+{
+	uint32_t batch, length = 0, batches = count / STREAM_TEST_BATCH, size;
+	const int16_t* source;
+	if(batches == 0)
+		return;
+	for(batch = 0; batch < batches; batch++)
+	{
+		source = &samples[batch * STREAM_TEST_BATCH * STREAM_CODEC_AXES];
+		size = StreamCodecEncode(encoded, source, STREAM_TEST_BATCH);
+		if(!StreamCodecDecode(encoded, size, decoded, STREAM_TEST_BATCH) || (memcmp(decoded, source, sizeof(decoded)) != 0))
+			StreamTestFail(name, batch);
+		length += size;
+	}
+	printf("  %-10s %5.2f %5.2f, %5.0f bytes/s at 200Hz\n", name, (double)length / (batches * STREAM_TEST_BATCH),
+		(double)(length + (batches * STREAM_TEST_FRAME)) / (batches * STREAM_TEST_BATCH),
+		200.0 * (length + (batches * STREAM_TEST_FRAME)) / (batches * STREAM_TEST_BATCH));
+}
+
+static void StreamTestFail(const char* reason, uint32_t batch)
+{
+	if(failures++ < 10)
+		fprintf(stderr, "Failed: %s (%u)\n", reason, (unsigned int)batch);
+}
+//EOF